@@ -0,0 +1,83 @@
+// Contador de reservas de memoria para medir asignaciones por solicitud.
+// Se precarga en el servidor (LD_PRELOAD) y cuenta cada malloc/calloc/realloc;
+// al recibir SIGUSR1 escribe los totales en stderr. La diferencia entre dos
+// lecturas, dividida por las solicitudes enviadas entre ellas, es el costo por
+// solicitud:
+//
+//   LD_PRELOAD=./alloc_count.so ../server/server 50213 &
+//   kill -USR1 <pid>; ./bench -m estado ...; kill -USR1 <pid>
+
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Implementaciones de glibc, para no tener que resolver los símbolos con dlsym
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long allocs;
+static unsigned long frees;
+
+void *malloc(size_t size) {
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (ptr != NULL) {
+        __atomic_fetch_add(&frees, 1, __ATOMIC_RELAXED);
+    }
+    __libc_free(ptr);
+}
+
+// Escribe un número sin usar stdio (el manejador debe ser seguro ante señales)
+static size_t format_ulong(char *out, unsigned long value) {
+    char tmp[24];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+static void report(int sig) {
+    (void)sig;
+    char line[96];
+    size_t len = 0;
+    const char *a = "[alloc] reservas=";
+    const char *f = " liberaciones=";
+
+    while (*a) line[len++] = *a++;
+    len += format_ulong(line + len, __atomic_load_n(&allocs, __ATOMIC_RELAXED));
+    while (*f) line[len++] = *f++;
+    len += format_ulong(line + len, __atomic_load_n(&frees, __ATOMIC_RELAXED));
+    line[len++] = '\n';
+    ssize_t w = write(STDERR_FILENO, line, len);
+    (void)w;
+}
+
+__attribute__((constructor))
+static void install(void) {
+    struct sigaction sa = {0};
+    sa.sa_handler = report;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+}
@@ -0,0 +1,391 @@
+// Generador de carga para el servidor de chat.
+// Abre muchas conexiones desde un solo hilo (epoll), registra a cada cliente
+// y mide el rendimiento de BROADCAST o DM en lazo cerrado: cada emisor mantiene
+// hasta W mensajes en vuelo y envía el siguiente cuando uno llega a su destino.
+// En modo ESTADO cada emisor cambia su estado y espera la respuesta fija del
+// servidor, lo que aísla el costo de atender y confirmar una solicitud.
+// Con -L K cada envío es un LOTE de K operaciones (y la ventana cuenta lotes),
+// como haría un bot o una pasarela que agrupa sus mensajes.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MAX_EVENTS 256
+#define READ_SIZE 65536
+
+typedef enum { MODE_BROADCAST, MODE_DM, MODE_ESTADO } bench_mode_t;
+
+// Estado de un cliente simulado
+typedef struct {
+    int fd;
+    int registered;
+    int depth;          // Profundidad de llaves del documento JSON en curso
+    int in_string;
+    int escape;
+    char *frame;        // Documento en curso (para buscar la etiqueta del mensaje)
+    size_t frame_len;
+    size_t frame_cap;
+    long sent;          // Mensajes enviados (solo emisores)
+    long done;          // Mensajes confirmados (solo emisores)
+    double *sent_at;    // Instante de envío de cada mensaje en vuelo (ventana circular de ventana*lote)
+} bench_client_t;
+
+static bench_client_t *clients;
+static int n_clients = 100;
+static int n_senders = 10;
+static long n_messages = 1000;
+static int msg_size = 32;
+static int window = 1;
+static int batch = 1;
+static char *out_frame;     // Trama que se arma para cada envío
+static size_t out_cap;
+static bench_mode_t mode = MODE_BROADCAST;
+
+static long frames_received;
+static long bytes_received;
+static long bytes_sent;
+static long recv_calls;     // Lecturas con datos: con agrupación, cada una trae varias tramas
+static double *latencies;
+static long n_latencies;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void send_frame(bench_client_t *c, const char *data, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = send(c->fd, data + off, len - off, MSG_NOSIGNAL);
+        if (n > 0) {
+            off += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        } else {
+            perror("send");
+            exit(EXIT_FAILURE);
+        }
+    }
+    bytes_sent += (long)len;
+}
+
+// Escribe en out la operación número seq del emisor i; retorna su longitud
+static int write_op(char *out, size_t cap, int i, long seq) {
+    char payload[4096];
+    int len;
+
+    len = snprintf(payload, sizeof(payload), "bench-%d-%ld-", i, seq);
+    while (len < msg_size && len < (int)sizeof(payload) - 1) {
+        payload[len++] = 'x';
+    }
+    payload[len] = '\0';
+
+    if (mode == MODE_BROADCAST) {
+        return snprintf(out, cap,
+                        "{\"accion\":\"BROADCAST\",\"nombre_emisor\":\"bench%d\",\"mensaje\":\"%s\"}",
+                        i, payload);
+    } else if (mode == MODE_DM) {
+        return snprintf(out, cap,
+                        "{\"accion\":\"DM\",\"nombre_emisor\":\"bench%d\",\"nombre_destinatario\":\"bench%d\",\"mensaje\":\"%s\"}",
+                        i, (i + 1) % n_clients, payload);
+    }
+    return snprintf(out, cap,
+                    "{\"tipo\":\"ESTADO\",\"usuario\":\"bench%d\",\"estado\":\"%s\"}",
+                    i, seq % 2 ? "OCUPADO" : "ACTIVO");
+}
+
+// Envía el siguiente mensaje del emisor i, o el siguiente lote si se usa -L
+static void send_next(int i) {
+    bench_client_t *c = &clients[i];
+    long count = n_messages - c->sent < batch ? n_messages - c->sent : batch;
+    size_t len = 0;
+
+    if (batch > 1) {
+        len += (size_t)snprintf(out_frame, out_cap, "{\"accion\":\"LOTE\",\"operaciones\":[");
+    }
+    for (long k = 0; k < count; k++) {
+        if (k > 0) {
+            out_frame[len++] = ',';
+        }
+        len += (size_t)write_op(out_frame + len, out_cap - len, i, c->sent);
+        c->sent_at[c->sent % ((long)window * batch)] = now_sec();
+        c->sent++;
+    }
+    if (batch > 1) {
+        len += (size_t)snprintf(out_frame + len, out_cap - len, "]}");
+    }
+
+    send_frame(c, out_frame, len);
+}
+
+// Procesa un documento completo recibido por el cliente idx
+static void on_frame(int idx, bench_client_t *c) {
+    frames_received++;
+
+    if (!c->registered) {
+        c->registered = 1;
+        return;
+    }
+
+    // En ESTADO toda trama que llega a un emisor es la respuesta a su solicitud
+    // (con -L, la respuesta agregada de todo su lote)
+    int sender = idx;
+    if (mode != MODE_ESTADO) {
+        // Localizar la etiqueta bench-<emisor>-<secuencia>- del mensaje
+        c->frame[c->frame_len] = '\0';
+        const char *tag = strstr(c->frame, "bench-");
+        if (tag == NULL) {
+            return;
+        }
+        sender = atoi(tag + 6);
+    }
+    if (sender < 0 || sender >= n_senders) {
+        return;
+    }
+    // En BROADCAST el emisor espera su propio eco; en DM, la entrega al destinatario
+    if (mode == MODE_BROADCAST && idx != sender) {
+        return;
+    }
+
+    bench_client_t *s = &clients[sender];
+    long acked = mode == MODE_ESTADO && s->sent - s->done < batch ? s->sent - s->done :
+                 mode == MODE_ESTADO ? batch : 1;
+    double now = now_sec();
+    for (long k = 0; k < acked; k++) {
+        latencies[n_latencies++] = now - s->sent_at[s->done % ((long)window * batch)];
+        s->done++;
+    }
+
+    // Se envía otro lote en cuanto cabe entero en la ventana
+    while (s->sent < n_messages && s->sent - s->done <= (long)(window - 1) * batch) {
+        send_next(sender);
+    }
+}
+
+// Separa los documentos JSON concatenados que llegan por el socket
+static void feed(int idx, const char *data, size_t len) {
+    bench_client_t *c = &clients[idx];
+
+    for (size_t i = 0; i < len; i++) {
+        char ch = data[i];
+
+        if (c->depth > 0) {
+            if (c->frame_len + 2 > c->frame_cap) {
+                c->frame_cap = c->frame_cap ? c->frame_cap * 2 : 1024;
+                c->frame = realloc(c->frame, c->frame_cap);
+            }
+            c->frame[c->frame_len++] = ch;
+        }
+
+        if (c->in_string) {
+            if (c->escape) {
+                c->escape = 0;
+            } else if (ch == '\\') {
+                c->escape = 1;
+            } else if (ch == '"') {
+                c->in_string = 0;
+            }
+        } else if (ch == '"') {
+            c->in_string = 1;
+        } else if (ch == '{') {
+            if (c->depth++ == 0) {
+                if (c->frame_cap < 1024) {
+                    c->frame_cap = 1024;
+                    c->frame = realloc(c->frame, c->frame_cap);
+                }
+                c->frame[0] = ch;
+                c->frame_len = 1;
+            }
+        } else if (ch == '}' && c->depth > 0) {
+            if (--c->depth == 0) {
+                on_frame(idx, c);
+            }
+        }
+    }
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s [-H host] [-p puerto] [-c clientes] [-s emisores] [-n mensajes]\n"
+            "          [-b bytes] [-w ventana] [-L operaciones por lote] [-m broadcast|dm|estado]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = 50213;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:c:s:n:b:w:L:m:")) != -1) {
+        switch (opt) {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'c': n_clients = atoi(optarg); break;
+            case 's': n_senders = atoi(optarg); break;
+            case 'n': n_messages = atol(optarg); break;
+            case 'b': msg_size = atoi(optarg); break;
+            case 'w': window = atoi(optarg); break;
+            case 'L': batch = atoi(optarg); break;
+            case 'm':
+                if (strcmp(optarg, "broadcast") == 0) {
+                    mode = MODE_BROADCAST;
+                } else if (strcmp(optarg, "dm") == 0) {
+                    mode = MODE_DM;
+                } else if (strcmp(optarg, "estado") == 0) {
+                    mode = MODE_ESTADO;
+                } else {
+                    usage(argv[0]);
+                }
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (n_clients < 1 || n_senders < 1 || n_senders > n_clients || n_messages < 1 || window < 1 || batch < 1) {
+        usage(argv[0]);
+    }
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    clients = calloc((size_t)n_clients, sizeof(bench_client_t));
+    latencies = malloc(sizeof(double) * (size_t)n_senders * (size_t)n_messages);
+    if (clients == NULL || latencies == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    for (int i = 0; i < n_senders; i++) {
+        clients[i].sent_at = malloc(sizeof(double) * (size_t)window * (size_t)batch);
+    }
+    out_cap = (size_t)batch * ((size_t)msg_size + 4096) + 64;
+    out_frame = malloc(out_cap);
+    if (out_frame == NULL) {
+        perror("malloc");
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Dirección inválida: %s\n", host);
+        return 1;
+    }
+
+    int ep = epoll_create1(0);
+    char frame[256];
+    for (int i = 0; i < n_clients; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        clients[i].fd = fd;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+
+        int len = snprintf(frame, sizeof(frame),
+                           "{\"tipo\":\"REGISTRO\",\"usuario\":\"bench%d\",\"direccionIP\":\"0.0.0.0\"}", i);
+        send_frame(&clients[i], frame, (size_t)len);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    static char buf[READ_SIZE];
+    long expected = (long)n_senders * n_messages;
+    int registered = 0;
+    int started = 0;
+    double t0 = 0;
+
+    while (n_latencies < expected) {
+        int n = epoll_wait(ep, events, MAX_EVENTS, 5000);
+        if (n == 0) {
+            fprintf(stderr, "Sin progreso en 5 s (%ld/%ld confirmados)\n", n_latencies, expected);
+            return 1;
+        }
+        for (int e = 0; e < n; e++) {
+            int idx = (int)events[e].data.u32;
+            ssize_t r = recv(clients[idx].fd, buf, sizeof(buf), 0);
+            if (r <= 0) {
+                fprintf(stderr, "El servidor cerró la conexión %d\n", idx);
+                return 1;
+            }
+            int was_registered = clients[idx].registered;
+            if (started) {
+                bytes_received += r;
+                recv_calls++;
+            }
+            feed(idx, buf, (size_t)r);
+            if (!was_registered && clients[idx].registered) {
+                registered++;
+            }
+        }
+
+        if (!started && registered == n_clients) {
+            started = 1;
+            frames_received = 0;
+            bytes_sent = 0;
+            recv_calls = 0;
+            t0 = now_sec();
+            for (int i = 0; i < n_senders; i++) {
+                for (int w = 0; w < window && clients[i].sent < n_messages; w++) {
+                    send_next(i);
+                }
+            }
+        }
+    }
+
+    double elapsed = now_sec() - t0;
+    qsort(latencies, (size_t)n_latencies, sizeof(double), cmp_double);
+
+    printf("modo=%s clientes=%d emisores=%d mensajes=%ld bytes=%d ventana=%d lote=%d\n",
+           mode == MODE_BROADCAST ? "broadcast" : mode == MODE_DM ? "dm" : "estado", n_clients, n_senders, expected, msg_size,
+           window, batch);
+    printf("tiempo=%.3f s  mensajes/s=%.0f  entregas/s=%.0f\n",
+           elapsed, expected / elapsed, frames_received / elapsed);
+    printf("bytes_enviados=%ld  bytes_recibidos=%ld  bytes/entrega=%.1f\n",
+           bytes_sent, bytes_received, frames_received ? (double)bytes_received / frames_received : 0.0);
+    printf("lecturas=%ld  tramas/lectura=%.2f\n", recv_calls,
+           recv_calls ? (double)frames_received / recv_calls : 0.0);
+    printf("latencia p50=%.1f us  p99=%.1f us  max=%.1f us\n",
+           latencies[n_latencies / 2] * 1e6,
+           latencies[(long)(n_latencies * 0.99)] * 1e6,
+           latencies[n_latencies - 1] * 1e6);
+
+    for (int i = 0; i < n_clients; i++) {
+        close(clients[i].fd);
+        free(clients[i].frame);
+        free(clients[i].sent_at);
+    }
+    free(clients);
+    free(latencies);
+    free(out_frame);
+    close(ep);
+    return 0;
+}
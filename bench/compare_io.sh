@@ -0,0 +1,20 @@
+#!/bin/sh
+# Compara los motores de E/S del servidor (epoll con writev() no bloqueante frente a
+# io_uring con envíos por lotes) usando el mismo escenario de carga.
+# Uso: ./compare_io.sh [puerto] [argumentos extra para bench]
+
+PORT=${1:-50400}
+[ $# -gt 0 ] && shift
+SERVER=../server/server
+
+for io in epoll uring; do
+    $SERVER $PORT --io $io > /dev/null 2>&1 &
+    pid=$!
+    sleep 0.5
+    echo "== E/S: $io =="
+    ./bench -p $PORT -m broadcast "$@"
+    ./bench -p $PORT -m dm "$@"
+    kill $pid
+    wait $pid 2> /dev/null
+    sleep 0.5
+done
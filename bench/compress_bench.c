@@ -0,0 +1,331 @@
+// Banco de la compresión de las tramas: reproduce una grabación del tráfico de
+// los clientes (documentos JSON y tramas binarias o comprimidas seguidos, como
+// llegan al servidor) y, para cada DM y BROADCAST, arma la trama que reenvía el
+// servidor en cada codificación. Compara los bytes en la red y el tiempo de CPU
+// de tres formas de comprimirla: deflate por trama sin diccionario, deflate por
+// trama con el diccionario del protocolo (lo que negocia el servidor) y un flujo
+// deflate por conexión que arrastra el contexto de una trama a la siguiente.
+// Una trama por trama se comprime una vez por difusión y la comparten todos los
+// receptores; con un flujo por conexión cada receptor paga la suya.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <zlib.h>
+#include "wire.h"
+#include "compress.h"
+
+// Flujo por conexión: nivel de compress.c con la ventana y tablas por omisión de zlib
+#define LEVEL 1
+#define WINDOW_BITS 15
+#define MAX_FRAME_BYTES 65536   // Como MAX_FRAME_SIZE en el servidor
+
+// Trama saliente ya serializada
+typedef struct {
+    char *data;
+    size_t len;
+} out_frame_t;
+
+// Tramas de un tipo de mensaje en una codificación
+typedef struct {
+    out_frame_t *frames;
+    size_t count;
+    size_t cap;
+} group_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Lee el archivo completo
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("Error al abrir la grabación");
+        return NULL;
+    }
+    size_t cap = 65536;
+    char *data = malloc(cap);
+    *len = 0;
+    size_t n;
+    while (data != NULL && (n = fread(data + *len, 1, cap - *len, f)) > 0) {
+        *len += n;
+        if (*len == cap) {
+            cap *= 2;
+            data = realloc(data, cap);
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+// Largo del documento JSON que empieza en p (llaves fuera de cadenas), 0 si está incompleto
+static size_t json_doc_len(const char *p, size_t len) {
+    int depth = 0, in_string = 0, escape = 0;
+    for (size_t i = 0; i < len; i++) {
+        char ch = p[i];
+        if (in_string) {
+            if (escape) {
+                escape = 0;
+            } else if (ch == '\\') {
+                escape = 1;
+            } else if (ch == '"') {
+                in_string = 0;
+            }
+        } else if (ch == '"') {
+            in_string = 1;
+        } else if (ch == '{' || ch == '[') {
+            depth++;
+        } else if ((ch == '}' || ch == ']') && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void group_add(group_t *g, const char *data, size_t len) {
+    if (g->count == g->cap) {
+        g->cap = g->cap ? g->cap * 2 : 256;
+        g->frames = realloc(g->frames, g->cap * sizeof(out_frame_t));
+    }
+    out_frame_t *f = &g->frames[g->count++];
+    f->data = malloc(len);
+    memcpy(f->data, data, len);
+    f->len = len;
+}
+
+// Arma la trama que reenvía el servidor, como write_chat() en server.c
+static void add_chat(group_t groups[2][WIRE_ENCODINGS], wire_writer_t *w, const wire_request_t *req) {
+    const char *accion = req->fields[WIRE_KEY_ACCION];
+    const char *emisor = req->fields[WIRE_KEY_NOMBRE_EMISOR];
+    const char *destinatario = req->fields[WIRE_KEY_NOMBRE_DESTINATARIO];
+    const char *mensaje = req->fields[WIRE_KEY_MENSAJE];
+    if (accion == NULL || emisor == NULL || mensaje == NULL) {
+        return;
+    }
+    int dm = strcmp(accion, "DM") == 0;
+    if (!dm && strcmp(accion, "BROADCAST") != 0) {
+        return;
+    }
+    if (dm && destinatario == NULL) {
+        return;
+    }
+
+    for (int e = 0; e < WIRE_ENCODINGS; e++) {
+        wire_writer_begin(w, e);
+        wire_begin_object(w, WIRE_NO_KEY);
+        wire_add_verb(w, WIRE_KEY_ACCION, dm ? WIRE_VERB_DM : WIRE_VERB_BROADCAST);
+        wire_add_string(w, WIRE_KEY_NOMBRE_EMISOR, emisor);
+        if (dm) {
+            wire_add_string(w, WIRE_KEY_NOMBRE_DESTINATARIO, destinatario);
+        }
+        wire_add_string(w, WIRE_KEY_MENSAJE, mensaje);
+        wire_end_object(w);
+        size_t len;
+        const char *data = wire_writer_end(w, &len);
+        if (data != NULL) {
+            group_add(&groups[dm][e], data, len);
+        }
+    }
+}
+
+// Recorre la grabación y arma las tramas salientes de cada DM y BROADCAST
+static void load_recording(const char *data, size_t len, group_t groups[2][WIRE_ENCODINGS]) {
+    wire_request_t req = {0};
+    wire_writer_t w = {0};
+    unsigned wanted = WIRE_FIELD(WIRE_KEY_ACCION) | WIRE_FIELD(WIRE_KEY_NOMBRE_EMISOR) |
+                      WIRE_FIELD(WIRE_KEY_NOMBRE_DESTINATARIO) | WIRE_FIELD(WIRE_KEY_MENSAJE);
+    size_t i = 0;
+
+    while (i < len) {
+        unsigned char ch = (unsigned char)data[i];
+        size_t n;
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            i++;
+            continue;
+        }
+        if (ch == WIRE_MARK || ch == COMPRESS_MARK) {
+            if (len - i < WIRE_HEADER_SIZE) {
+                break;
+            }
+            n = WIRE_HEADER_SIZE + (wire_payload_len(data + i) & WIRE_MAX_PAYLOAD);
+        } else if (ch == '{') {
+            n = json_doc_len(data + i, len - i);
+        } else {
+            n = 0;
+        }
+        if (n == 0 || n > len - i) {
+            fprintf(stderr, "Grabación inválida en el byte %zu\n", i);
+            break;
+        }
+
+        const char *doc = data + i;
+        size_t doc_len = n;
+        if (ch == COMPRESS_MARK) {
+            doc = decompress_frame(doc, doc_len, WIRE_HEADER_SIZE + WIRE_MAX_PAYLOAD, &doc_len);
+        }
+        if (doc != NULL && wire_extract(&req, doc, doc_len, wanted) == 0) {
+            add_chat(groups, &w, &req);
+        }
+        i += n;
+    }
+
+    wire_request_free(&req);
+    wire_writer_free(&w);
+}
+
+// Bytes de una trama comprimida sin diccionario (o de la original si no ahorra)
+static size_t plain_bytes(z_stream *z, const out_frame_t *f, unsigned char *out, size_t cap) {
+    deflateReset(z);
+    z->next_in = (Bytef *)f->data;
+    z->avail_in = (uInt)f->len;
+    z->next_out = out;
+    z->avail_out = (uInt)cap;
+    if (deflate(z, Z_FINISH) != Z_STREAM_END || COMPRESS_HEADER_SIZE + z->total_out >= f->len) {
+        return f->len;
+    }
+    return COMPRESS_HEADER_SIZE + z->total_out;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = "chat_sample.jsonl";
+    int passes = 20;
+    int receivers = 100;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:r:")) != -1) {
+        switch (opt) {
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                passes = atoi(optarg);
+                break;
+            case 'r':
+                receivers = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Uso: %s [-f grabación] [-n pasadas] [-r receptores por difusión]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (passes < 1 || receivers < 1) {
+        fprintf(stderr, "Uso: %s [-f grabación] [-n pasadas] [-r receptores por difusión]\n", argv[0]);
+        return 1;
+    }
+
+    size_t len;
+    char *data = read_file(path, &len);
+    if (data == NULL) {
+        return 1;
+    }
+    group_t groups[2][WIRE_ENCODINGS] = {{{0}}};
+    load_recording(data, len, groups);
+    free(data);
+
+    // Memoria de deflate e inflate según zlib: la paga cada conexión con un flujo propio
+    size_t stream_kib = ((1u << (WINDOW_BITS + 2)) + (1u << (8 + 9)) + (1u << WINDOW_BITS)) / 1024;
+    printf("Grabación: %s, %zu DM y %zu BROADCAST; %d pasadas; %d receptores por difusión\n",
+           path, groups[1][0].count, groups[0][0].count, passes, receivers);
+    printf("Un flujo por conexión reserva unos %zu KiB de contexto por cliente\n", stream_kib);
+    printf("Bytes comprimidos como %% de la trama original; CPU por trama y por entrega\n\n");
+    printf("%-10s %-7s | %9s %9s %9s %9s | %9s %9s %9s | %10s %10s\n", "mensaje", "cod",
+           "B/trama", "deflate", "+dicc", "flujo", "+dicc cmp", "+dicc des", "flujo cmp",
+           "entrega +d", "entrega fl");
+
+    unsigned char *scratch = malloc(2 * MAX_FRAME_BYTES);
+    for (int dm = 1; dm >= 0; dm--) {
+        for (int e = 0; e < WIRE_ENCODINGS; e++) {
+            group_t *g = &groups[dm][e];
+            if (g->count == 0) {
+                continue;
+            }
+            size_t raw = 0, plain = 0, dict = 0, stream = 0;
+
+            z_stream pz = {0};
+            deflateInit2(&pz, LEVEL, Z_DEFLATED, -WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+            for (size_t i = 0; i < g->count; i++) {
+                raw += g->frames[i].len;
+                plain += plain_bytes(&pz, &g->frames[i], scratch, 2 * MAX_FRAME_BYTES);
+            }
+            deflateEnd(&pz);
+
+            // Con diccionario: lo que envía el servidor. Se guardan las comprimidas para medir la descompresión
+            out_frame_t *packed = calloc(g->count, sizeof(out_frame_t));
+            double t0 = now_sec();
+            for (int p = 0; p < passes; p++) {
+                for (size_t i = 0; i < g->count; i++) {
+                    size_t n;
+                    const char *z = compress_frame(g->frames[i].data, g->frames[i].len, &n);
+                    if (p == 0) {
+                        dict += z != NULL ? n : g->frames[i].len;
+                        if (z != NULL) {
+                            packed[i].data = malloc(n);
+                            memcpy(packed[i].data, z, n);
+                            packed[i].len = n;
+                        }
+                    }
+                }
+            }
+            double t1 = now_sec();
+            size_t n_packed = 0;
+            for (int p = 0; p < passes; p++) {
+                for (size_t i = 0; i < g->count; i++) {
+                    size_t n;
+                    if (packed[i].data != NULL &&
+                        decompress_frame(packed[i].data, packed[i].len, MAX_FRAME_BYTES, &n) == NULL) {
+                        fprintf(stderr, "Error: una trama comprimida no se pudo descomprimir\n");
+                        return 1;
+                    }
+                    n_packed += packed[i].data != NULL;
+                }
+            }
+            double t2 = now_sec();
+
+            // Flujo por conexión: el mismo contexto de una trama a la siguiente
+            double stream_sec = 0;
+            for (int p = 0; p < passes; p++) {
+                z_stream sz = {0};
+                deflateInit2(&sz, LEVEL, Z_DEFLATED, -WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+                double s0 = now_sec();
+                for (size_t i = 0; i < g->count; i++) {
+                    sz.next_in = (Bytef *)g->frames[i].data;
+                    sz.avail_in = (uInt)g->frames[i].len;
+                    sz.next_out = scratch;
+                    sz.avail_out = 2 * MAX_FRAME_BYTES;
+                    deflate(&sz, Z_SYNC_FLUSH);
+                    if (p == 0) {
+                        stream += COMPRESS_HEADER_SIZE + (2 * MAX_FRAME_BYTES - sz.avail_out);
+                    }
+                }
+                stream_sec += now_sec() - s0;
+                deflateEnd(&sz);
+            }
+
+            double frames = (double)g->count * passes;
+            double dict_ns = (t1 - t0) * 1e9 / frames;
+            double inflate_ns = n_packed > 0 ? (t2 - t1) * 1e9 / (double)n_packed : 0;
+            double stream_ns = stream_sec * 1e9 / frames;
+            int per_frame = dm ? 1 : receivers;
+
+            printf("%-10s %-7s | %9.1f %8.1f%% %8.1f%% %8.1f%% | %6.0f ns %6.0f ns %6.0f ns | %7.0f ns %7.0f ns\n",
+                   dm ? "DM" : "BROADCAST", e == WIRE_JSON ? "JSON" : "binario",
+                   (double)raw / (double)g->count,
+                   100.0 * (double)plain / (double)raw, 100.0 * (double)dict / (double)raw,
+                   100.0 * (double)stream / (double)raw,
+                   dict_ns, inflate_ns, stream_ns, dict_ns / per_frame, stream_ns);
+
+            for (size_t i = 0; i < g->count; i++) {
+                free(packed[i].data);
+            }
+            free(packed);
+        }
+    }
+
+    free(scratch);
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Banco de contención del directorio de usuarios por porciones.
+// Varios hilos ejecutan una mezcla de operaciones parecida a la del servidor
+// (búsquedas de DM, cambios de estado, bajas y altas) contra users.c, y se
+// mide el rendimiento para cada número de porciones. Cada configuración corre
+// en un proceso hijo para partir de un directorio limpio.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "users.h"
+
+static int n_threads = 4;
+static int users_per_thread = 1000;
+static long ops_per_thread = 1000000;
+
+typedef struct {
+    int id;
+    user_t **mine;          // Usuarios propios del hilo (pueden darse de baja y alta)
+    pthread_t thread;
+} worker_t;
+
+static pthread_barrier_t start_barrier;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void user_name(char *buf, size_t len, int thread, int j) {
+    snprintf(buf, len, "t%d-u%d", thread, j);
+}
+
+static void *worker_loop(void *arg) {
+    worker_t *w = arg;
+    unsigned seed = (unsigned)w->id * 2654435761u + 1;
+    char name[64];
+
+    for (int j = 0; j < users_per_thread; j++) {
+        user_name(name, sizeof(name), w->id, j);
+        users_add(name, "127.0.0.1", NULL, 0, 0, &w->mine[j]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+
+    for (long op = 0; op < ops_per_thread; op++) {
+        int r = rand_r(&seed) % 10;
+
+        if (r < 6) {
+            // Ruta de un DM: buscar a cualquier usuario en su porción
+            user_name(name, sizeof(name), rand_r(&seed) % n_threads, rand_r(&seed) % users_per_thread);
+            user_shard_t *shard = users_shard_of(name);
+            pthread_mutex_lock(&shard->mutex);
+            users_find(shard, name);
+            pthread_mutex_unlock(&shard->mutex);
+        } else if (r < 9) {
+            // ESTADO o actividad de un usuario propio
+            user_t *user = w->mine[rand_r(&seed) % users_per_thread];
+            user_shard_t *shard = users_shard(user->shard);
+            pthread_mutex_lock(&shard->mutex);
+            user->status = r - 6;
+            users_touch(user);
+            pthread_mutex_unlock(&shard->mutex);
+        } else {
+            // Desconexión y nuevo registro del mismo usuario
+            int j = rand_r(&seed) % users_per_thread;
+            users_remove(w->mine[j]);
+            user_name(name, sizeof(name), w->id, j);
+            users_add(name, "127.0.0.1", NULL, 0, 0, &w->mine[j]);
+        }
+    }
+
+    return NULL;
+}
+
+// Función para medir una configuración en el proceso actual
+static void run_config(int shards) {
+    worker_t *workers = calloc((size_t)n_threads, sizeof(worker_t));
+
+    if (workers == NULL || users_init(shards, n_threads * users_per_thread, DEFAULT_IDLE_MS) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)n_threads + 1);
+
+    for (int i = 0; i < n_threads; i++) {
+        workers[i].id = i;
+        workers[i].mine = calloc((size_t)users_per_thread, sizeof(user_t *));
+        pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    double t0 = now_sec();
+    for (int i = 0; i < n_threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double elapsed = now_sec() - t0;
+
+    double ops = (double)n_threads * (double)ops_per_thread;
+    printf("porciones=%-4d hilos=%d  tiempo=%.3f s  ops/s=%.0f\n", shards, n_threads, elapsed, ops / elapsed);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-t hilos] [-u usuarios_por_hilo] [-n ops_por_hilo] [-S max_porciones]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    int max_shards = 64;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:u:n:S:")) != -1) {
+        switch (opt) {
+            case 't': n_threads = atoi(optarg); break;
+            case 'u': users_per_thread = atoi(optarg); break;
+            case 'n': ops_per_thread = atol(optarg); break;
+            case 'S': max_shards = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (n_threads < 1 || users_per_thread < 1 || ops_per_thread < 1 || max_shards < 1) {
+        usage(argv[0]);
+    }
+
+    // Curva de escalado: 1, 2, 4, ... porciones
+    for (int shards = 1; shards <= max_shards; shards *= 2) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_config(shards);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    return 0;
+}
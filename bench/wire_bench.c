@@ -0,0 +1,117 @@
+// Banco de la codificación de las tramas: compara el JSON legible que envía hoy
+// el servidor con la trama binaria negociada (MessagePack con claves y verbos
+// como enteros) para DM y BROADCAST. Mide bytes por mensaje y el tiempo de CPU de
+// serializar (lo que paga el servidor) y de analizar (lo que paga cada receptor),
+// este último tanto armando el árbol cJSON como extrayendo solo los campos que
+// usa el servidor con wire_extract.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "cJSON.h"
+#include "wire.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Construye el mensaje tal como lo reenvía el servidor
+static cJSON *make_message(int dm, const char *text) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "accion", dm ? "DM" : "BROADCAST");
+    cJSON_AddStringToObject(json, "nombre_emisor", "usuario0042");
+    if (dm) {
+        cJSON_AddStringToObject(json, "nombre_destinatario", "usuario0117");
+    }
+    cJSON_AddStringToObject(json, "mensaje", text);
+    return json;
+}
+
+// Mide una codificación: bytes por trama y ns por serialización, por análisis
+// completo y por extracción de campos
+static void measure(const cJSON *json, wire_encoding_t encoding, long iters,
+                    size_t *bytes, double *encode_ns, double *decode_ns, double *extract_ns) {
+    wire_request_t req = {0};
+    size_t len = 0;
+    char *data = NULL;
+
+    double t0 = now_sec();
+    for (long i = 0; i < iters; i++) {
+        free(data);
+        data = wire_print(json, encoding, &len);
+    }
+    double t1 = now_sec();
+
+    for (long i = 0; i < iters; i++) {
+        cJSON *parsed = encoding == WIRE_JSON ? cJSON_ParseWithLength(data, len) : wire_decode(data, len);
+        if (parsed == NULL) {
+            fprintf(stderr, "Error: la trama no se pudo analizar\n");
+            exit(EXIT_FAILURE);
+        }
+        cJSON_Delete(parsed);
+    }
+    double t2 = now_sec();
+
+    for (long i = 0; i < iters; i++) {
+        if (wire_extract(&req, data, len, ~0u) < 0) {
+            fprintf(stderr, "Error: la trama no se pudo extraer\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    double t3 = now_sec();
+
+    wire_request_free(&req);
+    free(data);
+    *bytes = len;
+    *encode_ns = (t1 - t0) * 1e9 / (double)iters;
+    *decode_ns = (t2 - t1) * 1e9 / (double)iters;
+    *extract_ns = (t3 - t2) * 1e9 / (double)iters;
+}
+
+int main(int argc, char *argv[]) {
+    long iters = 200000;
+    int sizes[] = {16, 64, 256, 1024};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iters = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Uso: %s [-n iteraciones]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("%-10s %6s | %8s %8s %7s | %9s %9s | %9s %9s | %9s %9s\n", "mensaje", "texto",
+           "JSON B", "bin B", "ahorro", "JSON ser", "bin ser", "JSON an", "bin an", "JSON ext", "bin ext");
+
+    for (int dm = 0; dm <= 1; dm++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            char *text = malloc((size_t)sizes[s] + 1);
+            memset(text, 'a', (size_t)sizes[s]);
+            text[sizes[s]] = '\0';
+            cJSON *json = make_message(dm, text);
+
+            size_t json_bytes, bin_bytes;
+            double json_enc, json_dec, json_ext, bin_enc, bin_dec, bin_ext;
+            measure(json, WIRE_JSON, iters, &json_bytes, &json_enc, &json_dec, &json_ext);
+            measure(json, WIRE_MSGPACK, iters, &bin_bytes, &bin_enc, &bin_dec, &bin_ext);
+
+            printf("%-10s %6d | %8zu %8zu %6.1f%% | %6.0f ns %6.0f ns | %6.0f ns %6.0f ns | %6.0f ns %6.0f ns\n",
+                   dm ? "DM" : "BROADCAST", sizes[s], json_bytes, bin_bytes,
+                   100.0 * (double)(json_bytes - bin_bytes) / (double)json_bytes,
+                   json_enc, bin_enc, json_dec, bin_dec, json_ext, bin_ext);
+
+            cJSON_Delete(json);
+            free(text);
+        }
+    }
+
+    return 0;
+}
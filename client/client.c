@@ -27,6 +27,8 @@
 #include <string.h>
 #include <signal.h>
 #include "cJSON.h"
+#include "wire.h"
+#include "compress.h"
 
 
 #define RESET   "\033[0m"
@@ -46,19 +48,32 @@ int g_socket = 0;
 char g_username[50];
 int g_connected = 0;
 int g_status = 0; // 0: ACTIVO, 1: OCUPADO, 2: INACTIVO
+int g_offer_binary = 1;         // Pedir la codificación binaria en el REGISTRO
+int g_encoding = WIRE_JSON;     // Codificación de envío aceptada por el servidor
+int g_offer_compression = 0;    // Pedir la compresión en el REGISTRO
+int g_compressed = 0;           // El servidor aceptó la compresión: los envíos se comprimen
+wire_writer_t g_writer;         // Buffer de envío reutilizado por todos los mensajes
+int g_batching = 0;             // Hay un LOTE abierto: los mensajes se acumulan en g_writer
+int g_batch_count = 0;          // Operaciones agregadas al LOTE abierto
 
 // Prototipos de funciones
 void *receive_messages(void *arg);
+void process_server_message(cJSON *json);
 void send_registration();
 void send_broadcast(const char *message);
 void send_direct_message(const char *recipient, const char *message);
 void request_user_list();
 void request_user_info(const char *username);
+void request_history(const char *before);
 void change_status(int status);
 void disconnect_client();
 void display_help();
 void handle_command(const char *input);
 void sigint_handler(int sig);
+void begin_frame();
+void send_frame(const char *error_msg);
+void begin_batch();
+void send_batch();
 
 int main(int argc, char *argv[]) {
 #ifdef _WIN32
@@ -76,8 +91,20 @@ int main(int argc, char *argv[]) {
 
     signal(SIGINT, sigint_handler);
 
-    if (argc != 4) {
-        printf(YELLOW "Uso: %s <nombredeusuario> <IPdelservidor> <puertodelservidor>\n" RESET, argv[0]);
+    // Por defecto se ofrece la codificación binaria; un servidor que no la conoce sigue
+    // en JSON. La compresión se pide solo con "deflate", y rige igual: si se confirma
+    int bad_option = argc < 4 || argc > 6;
+    for (int i = 4; i < argc && !bad_option; i++) {
+        if (strcmp(argv[i], "json") == 0) {
+            g_offer_binary = 0;
+        } else if (strcmp(argv[i], COMPRESS_NAME) == 0) {
+            g_offer_compression = 1;
+        } else if (strcmp(argv[i], WIRE_MSGPACK_NAME) != 0) {
+            bad_option = 1;
+        }
+    }
+    if (bad_option) {
+        printf(YELLOW "Uso: %s <nombredeusuario> <IPdelservidor> <puertodelservidor> [json|msgpack] [deflate]\n" RESET, argv[0]);
 #ifdef _WIN32
         WSACleanup();
 #endif
@@ -149,9 +176,10 @@ int main(int argc, char *argv[]) {
         handle_command(buffer);
     }
     
-    // Desconexión limpia
+    // Desconexión limpia (un lote abierto se envía antes)
     disconnect_client();
     close(g_socket);
+    wire_writer_free(&g_writer);
 
 #ifdef _WIN32
     WSACleanup();
@@ -172,13 +200,55 @@ void sigint_handler(int sig) {
     exit(0);
 }
 
-// Hilo encargado de recibir mensajes del servidor
+// Agrega n bytes al documento o trama en curso; retorna -1 sin memoria
+static int append_pending(char **pending, size_t *len, size_t *cap, const char *data, size_t n) {
+    if (*len + n > *cap) {
+        size_t new_cap = *cap ? *cap : BUFFER_SIZE;
+        while (new_cap < *len + n) {
+            new_cap *= 2;
+        }
+        char *tmp = realloc(*pending, new_cap);
+        if (tmp == NULL) {
+            return -1;
+        }
+        *pending = tmp;
+        *cap = new_cap;
+    }
+    memcpy(*pending + *len, data, n);
+    *len += n;
+    return 0;
+}
+
+// Convierte una trama binaria o comprimida completa en un objeto cJSON; una trama
+// comprimida contiene un documento JSON o una trama binaria. NULL si es inválida
+static cJSON *decode_frame(const char *frame, size_t len) {
+    if ((unsigned char)frame[0] == COMPRESS_MARK) {
+        frame = decompress_frame(frame, len, WIRE_HEADER_SIZE + WIRE_MAX_PAYLOAD, &len);
+        if (frame == NULL) {
+            return NULL;
+        }
+        if (frame[0] != WIRE_MARK) {
+            return cJSON_ParseWithLength(frame, len);
+        }
+    }
+    return wire_decode(frame, len);
+}
+
+// Hilo encargado de recibir mensajes del servidor.
+// El servidor puede agrupar varias respuestas en un mismo envío (o partir una),
+// por lo que los documentos JSON se separan siguiendo la anidación de llaves y
+// las tramas binarias y comprimidas según la longitud de su cabecera.
 void *receive_messages(void *arg) {
     (void)arg;
     char buffer[BUFFER_SIZE];
+    char *pending = NULL;       // Documento o trama incompleta acumulada
+    size_t pending_len = 0;
+    size_t pending_cap = 0;
+    int depth = 0, in_string = 0, escape = 0;
+    size_t binary_need = 0;     // Bytes que faltan de la trama binaria o comprimida en curso
+    int binary_header = 0;      // La cabecera de la trama en curso ya está completa
     
     while (g_connected) {
-        memset(buffer, 0, BUFFER_SIZE);
         int bytes_received = recv(g_socket, buffer, BUFFER_SIZE, 0);
         
         if (bytes_received <= 0) {
@@ -187,94 +257,316 @@ void *receive_messages(void *arg) {
             break;
         }
         
-        // Parsear el mensaje recibido en formato JSON
-        cJSON *json = cJSON_Parse(buffer);
-        if (json == NULL) {
-            // Si el mensaje no es JSON, se ignora
-            continue;
-        }
-        
-        // Se verifica si se trata de una respuesta (OK o ERROR), de una acción o de un tipo específico
-        cJSON *respuesta = cJSON_GetObjectItemCaseSensitive(json, "respuesta");
-        cJSON *accion = cJSON_GetObjectItemCaseSensitive(json, "accion");
-        cJSON *tipo = cJSON_GetObjectItemCaseSensitive(json, "tipo");
-        
-        if (respuesta && cJSON_IsString(respuesta)) {
-            if (strcmp(respuesta->valuestring, "OK") == 0) {
-                printf(GREEN "\nOperacion completada con exito.\n" RESET);
-            } else if (strcmp(respuesta->valuestring, "ERROR") == 0) {
-                cJSON *razon = cJSON_GetObjectItemCaseSensitive(json, "razon");
-                if (razon && cJSON_IsString(razon)) {
-                    printf(RED "\nError: %s\n" RESET, razon->valuestring);
-                }
+        for (int i = 0; i < bytes_received; i++) {
+            char ch = buffer[i];
+            
+            // Inicio de una trama binaria o comprimida: primero su cabecera de longitud
+            if (depth == 0 && binary_need == 0 && (ch == WIRE_MARK || ch == COMPRESS_MARK)) {
+                binary_need = WIRE_HEADER_SIZE;
+                binary_header = 0;
             }
-        } else if (accion && cJSON_IsString(accion)) {
-            // Procesar acciones según el tipo de mensaje recibido
-            if (strcmp(accion->valuestring, "BROADCAST") == 0) {
-                cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
-                cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
-                if (emisor && mensaje && cJSON_IsString(emisor) && cJSON_IsString(mensaje)) {
-                    printf(YELLOW "\n[BROADCAST] %s: %s\n" RESET, emisor->valuestring, mensaje->valuestring);
+            
+            if (binary_need > 0) {
+                // Copiar de una vez lo que falte de la cabecera o de la carga
+                size_t n = (size_t)(bytes_received - i);
+                if (n > binary_need) {
+                    n = binary_need;
+                }
+                if (append_pending(&pending, &pending_len, &pending_cap, buffer + i, n) < 0) {
+                    free(pending);
+                    g_connected = 0;
+                    return NULL;
                 }
-            } else if (strcmp(accion->valuestring, "DM") == 0) {
-                cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
-                cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
-                if (emisor && mensaje && cJSON_IsString(emisor) && cJSON_IsString(mensaje)) {
-                    printf(MAGENTA "\n[DM de %s]: %s\n" RESET, emisor->valuestring, mensaje->valuestring);
+                i += (int)n - 1;
+                binary_need -= n;
+                
+                if (binary_need == 0 && !binary_header) {
+                    binary_header = 1;
+                    binary_need = wire_payload_len(pending) & WIRE_MAX_PAYLOAD;
                 }
-            } else if (strcmp(accion->valuestring, "LISTA") == 0) {
-                cJSON *usuarios = cJSON_GetObjectItemCaseSensitive(json, "usuarios");
-                if (usuarios && cJSON_IsArray(usuarios)) {
-                    printf(CYAN "\nUsuarios conectados:\n" RESET);
-                    cJSON *usuario = NULL;
-                    cJSON_ArrayForEach(usuario, usuarios) {
-                        if (cJSON_IsString(usuario))
-                            printf(WHITE "- %s\n" RESET, usuario->valuestring);
+                if (binary_need == 0) {
+                    // Trama completa
+                    cJSON *json = decode_frame(pending, pending_len);
+                    pending_len = 0;
+                    if (json != NULL) {
+                        process_server_message(json);
+                        cJSON_Delete(json);
                     }
                 }
+                continue;
             }
-        } else if (tipo && cJSON_IsString(tipo)) {
-            // Procesar tipos específicos de mensajes
-            if (strcmp(tipo->valuestring, "MOSTRAR") == 0) {
-                // Procesar información de usuario
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                cJSON *direccionIP = cJSON_GetObjectItemCaseSensitive(json, "direccionIP");
-                cJSON *estado = cJSON_GetObjectItemCaseSensitive(json, "estado");
-                
-                if (usuario && direccionIP && estado && 
-                    cJSON_IsString(usuario) && cJSON_IsString(direccionIP) && cJSON_IsString(estado)) {
-                    printf(BLUE "\nInformacion de usuario:\n" RESET);
-                    printf("  " WHITE "Usuario:" RESET " %s\n", usuario->valuestring);
-                    printf("  " WHITE "IP:" RESET " %s\n", direccionIP->valuestring);
-                    printf("  " WHITE "Estado:" RESET " %s\n", estado->valuestring);
-                }
-            } else if (strcmp(tipo->valuestring, "ESTADO") == 0) {
-                // Procesar cambio de estado
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                cJSON *estado = cJSON_GetObjectItemCaseSensitive(json, "estado");
-                
-                if (usuario && estado && cJSON_IsString(usuario) && cJSON_IsString(estado)) {
-                    printf(CYAN "\nUsuario %s cambió su estado a: %s\n" RESET, 
-                           usuario->valuestring, estado->valuestring);
+            
+            // Fuera de un documento solo se esperan espacios o el inicio de un objeto
+            if (depth == 0 && ch != '{') {
+                continue;
+            }
+            
+            if (append_pending(&pending, &pending_len, &pending_cap, &ch, 1) < 0) {
+                free(pending);
+                g_connected = 0;
+                return NULL;
+            }
+            
+            if (in_string) {
+                if (escape) {
+                    escape = 0;
+                } else if (ch == '\\') {
+                    escape = 1;
+                } else if (ch == '"') {
+                    in_string = 0;
                 }
-            } else if (strcmp(tipo->valuestring, "SERVER_SHUTDOWN") == 0) {
-                // Procesar cierre del servidor
-                cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
-                if (mensaje && cJSON_IsString(mensaje)) {
-                    printf(RED "\n[SERVIDOR]: %s\n" RESET, mensaje->valuestring);
-                    g_connected = 0; // Marcar como desconectado
+            } else if (ch == '"') {
+                in_string = 1;
+            } else if (ch == '{' || ch == '[') {
+                depth++;
+            } else if ((ch == '}' || ch == ']') && --depth == 0) {
+                // Documento completo
+                cJSON *json = cJSON_ParseWithLength(pending, pending_len);
+                pending_len = 0;
+                if (json != NULL) {
+                    process_server_message(json);
+                    cJSON_Delete(json);
                 }
             }
         }
         
-        cJSON_Delete(json);
         printf(CYAN "> " RESET);
         fflush(stdout);
     }
     
+    free(pending);
     return NULL;
 }
 
+// Procesa un documento JSON recibido del servidor
+void process_server_message(cJSON *json) {
+    // Se verifica si se trata de una respuesta (OK o ERROR), de una acción o de un tipo específico
+    cJSON *respuesta = cJSON_GetObjectItemCaseSensitive(json, "respuesta");
+    cJSON *accion = cJSON_GetObjectItemCaseSensitive(json, "accion");
+    cJSON *tipo = cJSON_GetObjectItemCaseSensitive(json, "tipo");
+    
+    if (respuesta && cJSON_IsString(respuesta)) {
+        // El servidor aceptó la codificación binaria: los envíos siguientes la usan
+        cJSON *codificacion = cJSON_GetObjectItemCaseSensitive(json, "codificacion");
+        if (codificacion && cJSON_IsString(codificacion) &&
+            strcmp(codificacion->valuestring, WIRE_MSGPACK_NAME) == 0) {
+            g_encoding = WIRE_MSGPACK;
+        }
+        
+        // Igual con la compresión
+        cJSON *compresion = cJSON_GetObjectItemCaseSensitive(json, "compresion");
+        if (compresion && cJSON_IsString(compresion) &&
+            strcmp(compresion->valuestring, COMPRESS_NAME) == 0) {
+            g_compressed = 1;
+        }
+        
+        // Respuesta agregada de un LOTE: cuántas operaciones se atendieron
+        cJSON *procesadas = cJSON_GetObjectItemCaseSensitive(json, "procesadas");
+        cJSON *rechazadas = cJSON_GetObjectItemCaseSensitive(json, "rechazadas");
+        // Fin del historial: las difusiones ya llegaron antes que esta respuesta
+        cJSON *desde = cJSON_GetObjectItemCaseSensitive(json, "desde");
+        cJSON *hasta = cJSON_GetObjectItemCaseSensitive(json, "hasta");
+        if (accion && cJSON_IsString(accion) && strcmp(accion->valuestring, "LOTE") == 0 &&
+            cJSON_IsNumber(procesadas) && cJSON_IsNumber(rechazadas)) {
+            printf("%s\nLote atendido: %d operaciones procesadas, %d rechazadas.\n" RESET,
+                   rechazadas->valueint == 0 ? GREEN : YELLOW, procesadas->valueint, rechazadas->valueint);
+        } else if (accion && cJSON_IsString(accion) && strcmp(accion->valuestring, "HISTORIA") == 0 &&
+                   cJSON_IsNumber(desde) && cJSON_IsNumber(hasta)) {
+            if (desde->valuedouble < hasta->valuedouble) {
+                printf(CYAN "\nHistorial: posiciones %.0f a %.0f. Use /historial %.0f para ver los anteriores.\n" RESET,
+                       desde->valuedouble, hasta->valuedouble, desde->valuedouble);
+            } else {
+                printf(CYAN "\nNo hay difusiones anteriores guardadas.\n" RESET);
+            }
+        } else if (strcmp(respuesta->valuestring, "OK") == 0) {
+            printf(GREEN "\nOperacion completada con exito.\n" RESET);
+        } else if (strcmp(respuesta->valuestring, "ERROR") == 0) {
+            cJSON *razon = cJSON_GetObjectItemCaseSensitive(json, "razon");
+            if (razon && cJSON_IsString(razon)) {
+                printf(RED "\nError: %s\n" RESET, razon->valuestring);
+            }
+        }
+    } else if (accion && cJSON_IsString(accion)) {
+        // Procesar acciones según el tipo de mensaje recibido
+        if (strcmp(accion->valuestring, "BROADCAST") == 0) {
+            cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
+            cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
+            if (emisor && mensaje && cJSON_IsString(emisor) && cJSON_IsString(mensaje)) {
+                printf(YELLOW "\n[BROADCAST] %s: %s\n" RESET, emisor->valuestring, mensaje->valuestring);
+            }
+        } else if (strcmp(accion->valuestring, "DM") == 0) {
+            cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
+            cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
+            if (emisor && mensaje && cJSON_IsString(emisor) && cJSON_IsString(mensaje)) {
+                printf(MAGENTA "\n[DM de %s]: %s\n" RESET, emisor->valuestring, mensaje->valuestring);
+            }
+        } else if (strcmp(accion->valuestring, "LISTA") == 0) {
+            cJSON *usuarios = cJSON_GetObjectItemCaseSensitive(json, "usuarios");
+            if (usuarios && cJSON_IsArray(usuarios)) {
+                printf(CYAN "\nUsuarios conectados:\n" RESET);
+                cJSON *usuario = NULL;
+                cJSON_ArrayForEach(usuario, usuarios) {
+                    if (cJSON_IsString(usuario))
+                        printf(WHITE "- %s\n" RESET, usuario->valuestring);
+                }
+            }
+        }
+    } else if (tipo && cJSON_IsString(tipo)) {
+        // Procesar tipos específicos de mensajes
+        if (strcmp(tipo->valuestring, "MOSTRAR") == 0) {
+            // Procesar información de usuario
+            cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
+            cJSON *direccionIP = cJSON_GetObjectItemCaseSensitive(json, "direccionIP");
+            cJSON *estado = cJSON_GetObjectItemCaseSensitive(json, "estado");
+            
+            if (usuario && direccionIP && estado && 
+                cJSON_IsString(usuario) && cJSON_IsString(direccionIP) && cJSON_IsString(estado)) {
+                printf(BLUE "\nInformacion de usuario:\n" RESET);
+                printf("  " WHITE "Usuario:" RESET " %s\n", usuario->valuestring);
+                printf("  " WHITE "IP:" RESET " %s\n", direccionIP->valuestring);
+                printf("  " WHITE "Estado:" RESET " %s\n", estado->valuestring);
+            }
+        } else if (strcmp(tipo->valuestring, "ESTADO") == 0) {
+            // Procesar cambio de estado
+            cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
+            cJSON *estado = cJSON_GetObjectItemCaseSensitive(json, "estado");
+            
+            if (usuario && estado && cJSON_IsString(usuario) && cJSON_IsString(estado)) {
+                printf(CYAN "\nUsuario %s cambió su estado a: %s\n" RESET, 
+                       usuario->valuestring, estado->valuestring);
+            }
+        } else if (strcmp(tipo->valuestring, "SERVER_SHUTDOWN") == 0) {
+            // Procesar cierre del servidor
+            cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
+            if (mensaje && cJSON_IsString(mensaje)) {
+                printf(RED "\n[SERVIDOR]: %s\n" RESET, mensaje->valuestring);
+                g_connected = 0; // Marcar como desconectado
+            }
+        }
+    }
+}
+
+/*
+    Descripción:
+  Empieza un mensaje nuevo en g_writer con la codificación aceptada por el servidor.
+  
+    Entrada:
+    - No recibe parámetros.
+    
+    Salida/Efectos:
+    - Descarta lo escrito antes y abre el objeto raíz; los campos se agregan con
+      wire_add_string()/wire_add_verb() directamente sobre el buffer, sin cJSON.
+    - Mientras el servidor no confirme la codificación binaria se escribe JSON;
+      después, una trama binaria (cabecera de longitud y mapa MessagePack).
+    - Con un LOTE abierto, abre en cambio una operación más dentro de su arreglo.
+    - No devuelve valor.
+*/
+void begin_frame() {
+    if (g_batching) {
+        wire_begin_object(&g_writer, WIRE_NO_KEY);
+        return;
+    }
+    wire_writer_begin(&g_writer, (wire_encoding_t)g_encoding);
+    wire_begin_object(&g_writer, WIRE_NO_KEY);
+}
+
+/*
+    Descripción:
+  Cierra el mensaje escrito en g_writer y lo envía al servidor.
+  
+    Entrada:
+    - error_msg: Texto que se muestra con perror() si falla el envío.
+    
+    Salida/Efectos:
+    - El buffer de g_writer se conserva para el siguiente mensaje.
+    - Si el servidor aceptó la compresión, el mensaje sale comprimido cuando así
+      ocupa menos bytes.
+    - Con un LOTE abierto solo cierra la operación: se envía con send_batch().
+    - No devuelve valor.
+*/
+void send_frame(const char *error_msg) {
+    size_t len;
+    wire_end_object(&g_writer);
+    if (g_batching) {
+        g_batch_count++;
+        return;
+    }
+    const char *data = wire_writer_end(&g_writer, &len);
+    if (data == NULL) {
+        return;
+    }
+    if (g_compressed) {
+        size_t packed_len;
+        const char *packed = compress_frame(data, len, &packed_len);
+        if (packed != NULL) {
+            data = packed;
+            len = packed_len;
+        }
+    }
+    
+    if (send(g_socket, data, len, 0) < 0) {
+        perror(error_msg);
+    }
+}
+
+/*
+    Descripción:
+  Abre un LOTE: los mensajes directos, difusiones y cambios de estado siguientes se
+  acumulan en un solo mensaje en lugar de enviarse uno por uno.
+  
+    Entrada:
+    - No recibe parámetros.
+    
+    Salida/Efectos:
+    - Escribe en g_writer el inicio de:
+        "accion": "LOTE"
+        "operaciones": [ ... ]
+    - Las operaciones se agregan con begin_frame()/send_frame() hasta send_batch().
+    - No devuelve valor.
+*/
+void begin_batch() {
+    if (g_batching) {
+        printf(YELLOW "Ya hay un lote abierto (%d operaciones). Use /enviar para mandarlo.\n" RESET, g_batch_count);
+        return;
+    }
+    
+    wire_writer_begin(&g_writer, (wire_encoding_t)g_encoding);
+    wire_begin_object(&g_writer, WIRE_NO_KEY);
+    wire_add_verb(&g_writer, WIRE_KEY_ACCION, WIRE_VERB_LOTE);
+    wire_begin_array(&g_writer, WIRE_KEY_OPERACIONES);
+    g_batching = 1;
+    g_batch_count = 0;
+    printf(CYAN "Lote abierto: /dm, /broadcast y /status se acumulan hasta /enviar.\n" RESET);
+}
+
+/*
+    Descripción:
+  Cierra el LOTE abierto y lo envía al servidor en un solo mensaje.
+  
+    Entrada:
+    - No recibe parámetros.
+    
+    Salida/Efectos:
+    - El servidor atiende cada operación como si llegara sola, en orden, y responde
+      una sola vez con cuántas procesó ("procesadas") y cuántas rechazó ("rechazadas").
+    - No envía nada si no hay un lote abierto o si está vacío.
+    - No devuelve valor.
+*/
+void send_batch() {
+    if (!g_batching) {
+        printf(YELLOW "No hay un lote abierto. Use /lote para empezar uno.\n" RESET);
+        return;
+    }
+    
+    g_batching = 0;
+    if (g_batch_count == 0) {
+        printf(YELLOW "El lote esta vacio; no se envio nada.\n" RESET);
+        return;
+    }
+    wire_end_array(&g_writer);
+    send_frame(RED "Error al enviar lote" RESET);
+}
+
 /*
     Descripción:
   Envía al servidor un mensaje JSON para registrar al usuario.
@@ -283,29 +575,32 @@ void *receive_messages(void *arg) {
     - No recibe parámetros externos.
     
     Salida/Efectos:
-    - Construye un objeto JSON con:
+    - Escribe un mensaje con:
         "tipo": "REGISTRO"
         "usuario": valor de la variable global g_username
         "direccionIP": "0.0.0.0" (para que el servidor detecte la IP real)
+        "codificacion": "msgpack" (salvo que se haya pedido JSON al iniciar)
+        "compresion": "deflate" (solo si se pidió al iniciar)
     - Envía este objeto a través del socket global g_socket.
     - En caso de error en el envío, se muestra un mensaje de error.
     - No devuelve valor.
 
 */
 void send_registration() {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "tipo", "REGISTRO");
-    cJSON_AddStringToObject(json, "usuario", g_username);
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_TIPO, WIRE_VERB_REGISTRO);
+    wire_add_string(&g_writer, WIRE_KEY_USUARIO, g_username);
     // Se envía "0.0.0.0" ya que el servidor detectará la IP real del cliente.
-    cJSON_AddStringToObject(json, "direccionIP", "0.0.0.0");
-    
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al enviar registro" RESET);
+    wire_add_string(&g_writer, WIRE_KEY_DIRECCION_IP, "0.0.0.0");
+    // Ofrecer la codificación binaria; se usa solo si el servidor la confirma
+    if (g_offer_binary) {
+        wire_add_string(&g_writer, WIRE_KEY_CODIFICACION, WIRE_MSGPACK_NAME);
+    }
+    if (g_offer_compression) {
+        wire_add_string(&g_writer, WIRE_KEY_COMPRESION, COMPRESS_NAME);
     }
     
-    free(json_str);
-    cJSON_Delete(json);
+    send_frame(RED "Error al enviar registro" RESET);
 }
 
 /*
@@ -316,28 +611,22 @@ void send_registration() {
     - message: Cadena de texto con el mensaje a enviar.
     
     Salida/Efectos:
-    - Construye un objeto JSON con:
+    - Escribe un mensaje con:
         "accion": "BROADCAST"
         "nombre_emisor": valor de la variable global g_username
         "mensaje": contenido de message
-    - Envía el objeto JSON a través de g_socket.
+    - Envía el mensaje a través de g_socket.
     - Reporta error con perror() si falla el envío.
     - No devuelve valor. 
 
 */
 void send_broadcast(const char *message) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "accion", "BROADCAST");
-    cJSON_AddStringToObject(json, "nombre_emisor", g_username);
-    cJSON_AddStringToObject(json, "mensaje", message);
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_ACCION, WIRE_VERB_BROADCAST);
+    wire_add_string(&g_writer, WIRE_KEY_NOMBRE_EMISOR, g_username);
+    wire_add_string(&g_writer, WIRE_KEY_MENSAJE, message);
     
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al enviar broadcast" RESET);
-    }
-    
-    free(json_str);
-    cJSON_Delete(json);
+    send_frame(RED "Error al enviar broadcast" RESET);
 }
 
 /*
@@ -349,29 +638,23 @@ void send_broadcast(const char *message) {
     - message: Texto del mensaje.
     
     Salida/Efectos:
-    - Crea un objeto JSON con:
+    - Escribe un mensaje con:
         "accion": "DM"
         "nombre_emisor": valor de g_username
         "nombre_destinatario": valor de recipient
         "mensaje": contenido de message
-    - Envía el objeto JSON mediante g_socket.
+    - Envía el mensaje mediante g_socket.
     - Si ocurre error, se muestra un mensaje usando perror().
     - No retorna valor.
 */
 void send_direct_message(const char *recipient, const char *message) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "accion", "DM");
-    cJSON_AddStringToObject(json, "nombre_emisor", g_username);
-    cJSON_AddStringToObject(json, "nombre_destinatario", recipient);
-    cJSON_AddStringToObject(json, "mensaje", message);
-    
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al enviar mensaje directo" RESET);
-    }
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_ACCION, WIRE_VERB_DM);
+    wire_add_string(&g_writer, WIRE_KEY_NOMBRE_EMISOR, g_username);
+    wire_add_string(&g_writer, WIRE_KEY_NOMBRE_DESTINATARIO, recipient);
+    wire_add_string(&g_writer, WIRE_KEY_MENSAJE, message);
     
-    free(json_str);
-    cJSON_Delete(json);
+    send_frame(RED "Error al enviar mensaje directo" RESET);
 }
 
 /*
@@ -382,7 +665,7 @@ void send_direct_message(const char *recipient, const char *message) {
     - No recibe parámetros; utiliza g_username para indicar el solicitante.
     
     Salida/Efectos:
-    - Construye un objeto JSON con:
+    - Escribe un mensaje con:
         "accion": "LISTA"
         "nombre_usuario": valor de g_username
     - Envía este objeto a través de g_socket.
@@ -391,17 +674,11 @@ void send_direct_message(const char *recipient, const char *message) {
 */
 
 void request_user_list() {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "accion", "LISTA");
-    cJSON_AddStringToObject(json, "nombre_usuario", g_username);
-    
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al solicitar lista de usuarios" RESET);
-    }
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_ACCION, WIRE_VERB_LISTA);
+    wire_add_string(&g_writer, WIRE_KEY_NOMBRE_USUARIO, g_username);
     
-    free(json_str);
-    cJSON_Delete(json);
+    send_frame(RED "Error al solicitar lista de usuarios" RESET);
 }
 
 /*
@@ -412,26 +689,47 @@ void request_user_list() {
     - username: Nombre del usuario del que se solicita información.
     
     Salida/Efectos:
-    - Crea un objeto JSON con:
+    - Escribe un mensaje con:
         "tipo": "MOSTRAR"
         "usuario": valor de username
-    - Envía el objeto JSON por g_socket.
+    - Envía el mensaje por g_socket.
     - Reporta error si ocurre fallo en el envío.
     - No retorna valor.
 */
 
 void request_user_info(const char *username) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "tipo", "MOSTRAR");
-    cJSON_AddStringToObject(json, "usuario", username);
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_TIPO, WIRE_VERB_MOSTRAR);
+    wire_add_string(&g_writer, WIRE_KEY_USUARIO, username);
+    
+    send_frame(RED "Error al solicitar informacion de usuario" RESET);
+}
+
+/*
+    Descripción:
+  Solicita al servidor las últimas difusiones guardadas en su registro.
+  
+    Entrada:
+    - before: Posición (como texto) antes de la cual deben terminar, o NULL para
+      pedir las más recientes.
     
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al solicitar informacion de usuario" RESET);
+    Salida/Efectos:
+    - Escribe un mensaje con:
+        "accion": "HISTORIA"
+        "antes": valor de before (solo si no es NULL)
+    - Envía el mensaje por g_socket. Las difusiones llegan como cualquier otra y
+      luego la respuesta con el rango ("desde", "hasta") para pedir las anteriores.
+    - No retorna valor.
+*/
+
+void request_history(const char *before) {
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_ACCION, WIRE_VERB_HISTORIA);
+    if (before != NULL) {
+        wire_add_string(&g_writer, WIRE_KEY_ANTES, before);
     }
     
-    free(json_str);
-    cJSON_Delete(json);
+    send_frame(RED "Error al solicitar el historial" RESET);
 }
 
 /*
@@ -442,11 +740,11 @@ void request_user_info(const char *username) {
     - status: Valor entero (0 para ACTIVO, 1 para OCUPADO, 2 para INACTIVO).
     
     Salida/Efectos:
-    - Convierte el entero a una cadena (por ejemplo, "ACTIVO") y construye un JSON con:
+    - Convierte el entero a una cadena (por ejemplo, "ACTIVO") y escribe un mensaje con:
         "tipo": "ESTADO"
         "usuario": g_username
         "estado": cadena correspondiente al estado
-    - Envía el JSON mediante g_socket.
+    - Envía el mensaje mediante g_socket.
     - Actualiza la variable global g_status.
     - En caso de valor inválido, imprime un mensaje y no envía nada.
     - No devuelve valor.
@@ -469,20 +767,14 @@ void change_status(int status) {
             return;
     }
     
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "tipo", "ESTADO");
-    cJSON_AddStringToObject(json, "usuario", g_username);
-    cJSON_AddStringToObject(json, "estado", status_str);
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_TIPO, WIRE_VERB_ESTADO);
+    wire_add_string(&g_writer, WIRE_KEY_USUARIO, g_username);
+    wire_add_string(&g_writer, WIRE_KEY_ESTADO, status_str);
     
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al cambiar estado" RESET);
-    }
+    send_frame(RED "Error al cambiar estado" RESET);
     
     g_status = status;
-    
-    free(json_str);
-    cJSON_Delete(json);
 }
 
 /*
@@ -492,17 +784,15 @@ void change_status(int status) {
 void disconnect_client() {
     if (!g_connected) return;
     
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "tipo", "EXIT");
-    cJSON_AddStringToObject(json, "usuario", g_username);
-    
-    char *json_str = cJSON_Print(json);
-    if (send(g_socket, json_str, strlen(json_str), 0) < 0) {
-        perror(RED "Error al enviar solicitud de desconexion" RESET);
+    if (g_batching) {
+        send_batch();
     }
     
-    free(json_str);
-    cJSON_Delete(json);
+    begin_frame();
+    wire_add_verb(&g_writer, WIRE_KEY_TIPO, WIRE_VERB_EXIT);
+    wire_add_string(&g_writer, WIRE_KEY_USUARIO, g_username);
+    
+    send_frame(RED "Error al enviar solicitud de desconexion" RESET);
     
     g_connected = 0;
     printf(RED "Desconectado del chat.\n" RESET);
@@ -516,7 +806,7 @@ void disconnect_client() {
     - No recibe parámetros.
     
     Salida/Efectos:
-    - Imprime en la consola una lista detallada de comandos (broadcast, dm, list, info, status, help, exit).
+    - Imprime en la consola una lista detallada de comandos (broadcast, dm, list, info, status, historial, lote, enviar, help, exit).
     - No retorna valor.  
 */
 
@@ -531,6 +821,9 @@ void display_help() {
     printf(GREEN "/list" RESET "                   - Mostrar lista de usuarios conectados\n");
     printf(GREEN "/info <usuario>" RESET "         - Mostrar informacion de un usuario\n");
     printf(GREEN "/status <0|1|2>" RESET "         - Cambiar estado (0: ACTIVO, 1: OCUPADO, 2: INACTIVO)\n");
+    printf(GREEN "/historial [posicion]" RESET "   - Mostrar las difusiones guardadas (anteriores a la posicion)\n");
+    printf(GREEN "/lote" RESET "                   - Acumular /dm, /broadcast y /status en un solo envio\n");
+    printf(GREEN "/enviar" RESET "                 - Enviar el lote acumulado\n");
     printf(GREEN "/help" RESET "                   - Mostrar esta ayuda\n");
     printf(GREEN "/exit" RESET "                   - Salir del chat\n");
     
@@ -554,6 +847,9 @@ void display_help() {
         * "/dm <usuario> <mensaje>" → send_direct_message()
         * "/info <usuario>" → request_user_info()
         * "/status <0|1|2>" → change_status()
+        * "/historial [posicion]" → request_history()
+        * "/lote" → begin_batch(); "/enviar" → send_batch()
+    - Con un lote abierto, /list, /info e /historial no se pueden agrupar y se rechazan.
     - Si no coincide con ningún comando, envía el contenido como mensaje broadcast.
     - No devuelve valor. 
 */
@@ -569,6 +865,23 @@ void handle_command(const char *input) {
         return;
     }
     
+    if (strcmp(input, "/lote") == 0) {
+        begin_batch();
+        return;
+    }
+    
+    if (strcmp(input, "/enviar") == 0) {
+        send_batch();
+        return;
+    }
+    
+    // Las consultas esperan su propia respuesta: no viajan dentro de un lote
+    if (g_batching && (strcmp(input, "/list") == 0 || strncmp(input, "/info ", 6) == 0 ||
+                       strncmp(input, "/historial", 10) == 0)) {
+        printf(YELLOW "Las consultas no se pueden agrupar. Use /enviar antes.\n" RESET);
+        return;
+    }
+    
     if (strcmp(input, "/list") == 0) {
         request_user_list();
         return;
@@ -602,6 +915,16 @@ void handle_command(const char *input) {
         return;
     }
     
+    if (strcmp(input, "/historial") == 0) {
+        request_history(NULL);
+        return;
+    }
+    
+    if (strncmp(input, "/historial ", 11) == 0) {
+        request_history(input + 11);
+        return;
+    }
+    
     if (strncmp(input, "/status ", 8) == 0) {
         int status = atoi(input + 8);
         change_status(status);
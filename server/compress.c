@@ -0,0 +1,196 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include "compress.h"
+
+// Las tramas son cortas y cada una reinicia el compresor: una ventana de 4 KiB
+// (cabe el diccionario) y tablas chicas hacen barato el reinicio y comprimen igual
+// que las de 32 KiB. Más nivel casi no ahorra bytes y cuesta CPU
+#define COMPRESS_LEVEL 1
+#define COMPRESS_WINDOW_BITS 12
+#define COMPRESS_MEM_LEVEL 4
+#define INFLATE_WINDOW_BITS 15  // El descompresor acepta cualquier ventana
+
+// Diccionario fijo compartido por ambos extremos: cambiarlo rompe la compatibilidad.
+// deflate encuentra antes las coincidencias cercanas al final, así que lo más
+// frecuente (los mensajes de chat) va al último
+static const char dictionary[] =
+    // Palabras frecuentes en los mensajes
+    " que de la el en los se del las un por con no una su para es al lo como más pero"
+    " ya este sí porque esta cuando muy sin también me hay donde todo nos uno les eso"
+    " esto yo otro mucho nada algo hola gracias bien buenos días tardes noches mañana"
+    " hoy ahora luego vale dale genial perfecto claro jaja ok "
+    // Tramas binarias: claves y verbos como enteros pequeños tras la cabecera
+    "\x82\x08\xa2OK\x0b\xa7msgpack" "\x81\x08\xa2OK"
+    "\x83\x01\x04\x05" "\x07" "\x84\x01\x05\x05" "\x06" "\x07"
+    // Solicitudes que envían los clientes
+    "{\"tipo\":\"REGISTRO\",\"usuario\":\"\",\"direccionIP\":\"127.0.0.1\",\"codificacion\":\"msgpack\",\"compresion\":\"deflate\"}"
+    "{\"tipo\":\"MOSTRAR\",\"usuario\":\"\"}{\"accion\":\"LISTA\"}{\"tipo\":\"EXIT\",\"usuario\":\"\",\"estado\":\"\"}"
+    "{\"accion\":\"LOTE\",\"operaciones\":[{\"tipo\":\"ESTADO\",\"usuario\":\"\",\"estado\":\"OCUPADO\"},"
+    // Respuestas y avisos del servidor
+    "{\"respuesta\":\"ERROR\",\"razon\":\"Nombre o dirección duplicado\"}"
+    "{\"respuesta\":\"ERROR\",\"razon\":\"USUARIO_NO_ENCONTRADO\"}"
+    "{\"respuesta\":\"ERROR\",\"razon\":\"ESTADO_INVALIDO\"}"
+    "{\"tipo\":\"MOSTRAR\",\"usuario\":\"\",\"direccionIP\":\"\",\"estado\":\"ACTIVO\"}"
+    "{\"tipo\":\"ESTADO\",\"usuario\":\"\",\"estado\":\"INACTIVO\"}"
+    "{\"accion\":\"LOTE\",\"respuesta\":\"OK\",\"procesadas\":,\"rechazadas\":0}"
+    "{\"accion\":\"LISTA\",\"usuarios\":[\"\",\""
+    "{\"respuesta\":\"OK\",\"codificacion\":\"msgpack\",\"compresion\":\"deflate\"}"
+    "{\"respuesta\":\"OK\"}"
+    // Mensajes de chat: lo más frecuente
+    "{\"accion\":\"BROADCAST\",\"nombre_emisor\":\"\",\"mensaje\":\""
+    "{\"accion\":\"DM\",\"nombre_emisor\":\"\",\"nombre_destinatario\":\"\",\"mensaje\":\"";
+
+// Buffer de salida de cada hilo; se reutiliza de una trama a otra
+typedef struct {
+    unsigned char *data;
+    size_t cap;
+} zbuf_t;
+
+// Cada hilo comprime y descomprime con sus propios contextos, reiniciados en cada
+// trama: así ninguna trama depende de las anteriores
+static __thread z_stream deflater;
+static __thread int deflater_ready;
+static __thread z_stream inflater;
+static __thread int inflater_ready;
+
+// Buffers separados: una solicitud descomprimida sigue en uso mientras se comprimen
+// sus respuestas
+static __thread zbuf_t compressed;
+static __thread zbuf_t expanded;
+
+// Función para asegurar al menos n bytes en un buffer
+static int zbuf_reserve(zbuf_t *buf, size_t n) {
+    if (n <= buf->cap) {
+        return 0;
+    }
+    size_t cap = buf->cap > 0 ? buf->cap : 256;
+    while (cap < n) {
+        cap *= 2;
+    }
+    unsigned char *data = realloc(buf->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+// Función para dejar listo el compresor del hilo con el diccionario cargado
+static z_stream *deflater_start(void) {
+    if (!deflater_ready) {
+        if (deflateInit2(&deflater, COMPRESS_LEVEL, Z_DEFLATED, -COMPRESS_WINDOW_BITS, COMPRESS_MEM_LEVEL,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            return NULL;
+        }
+        deflater_ready = 1;
+    } else if (deflateReset(&deflater) != Z_OK) {
+        return NULL;
+    }
+    if (deflateSetDictionary(&deflater, (const Bytef *)dictionary, sizeof(dictionary) - 1) != Z_OK) {
+        return NULL;
+    }
+    return &deflater;
+}
+
+// Función para dejar listo el descompresor del hilo con el diccionario cargado
+static z_stream *inflater_start(void) {
+    if (!inflater_ready) {
+        if (inflateInit2(&inflater, -INFLATE_WINDOW_BITS) != Z_OK) {
+            return NULL;
+        }
+        inflater_ready = 1;
+    } else if (inflateReset(&inflater) != Z_OK) {
+        return NULL;
+    }
+    // Sin cabecera zlib, el diccionario se carga antes de leer nada
+    if (inflateSetDictionary(&inflater, (const Bytef *)dictionary, sizeof(dictionary) - 1) != Z_OK) {
+        return NULL;
+    }
+    return &inflater;
+}
+
+const char *compress_frame(const char *data, size_t len, size_t *out_len) {
+    // Solo sirve si ahorra algo: la salida, con su cabecera, debe ser menor que la trama
+    if (len <= COMPRESS_HEADER_SIZE + 1 || len > COMPRESS_MAX_PAYLOAD) {
+        return NULL;
+    }
+    size_t limit = len - 1;
+    z_stream *z = deflater_start();
+    if (z == NULL || zbuf_reserve(&compressed, limit) < 0) {
+        return NULL;
+    }
+
+    z->next_in = (Bytef *)(uintptr_t)data;
+    z->avail_in = (uInt)len;
+    z->next_out = compressed.data + COMPRESS_HEADER_SIZE;
+    z->avail_out = (uInt)(limit - COMPRESS_HEADER_SIZE);
+
+    // Si no cabe en el límite, deflate no termina: la trama no se comprime
+    if (deflate(z, Z_FINISH) != Z_STREAM_END) {
+        return NULL;
+    }
+
+    size_t payload = z->total_out;
+    compressed.data[0] = COMPRESS_MARK;
+    compressed.data[1] = (unsigned char)(payload >> 16);
+    compressed.data[2] = (unsigned char)(payload >> 8);
+    compressed.data[3] = (unsigned char)payload;
+    *out_len = COMPRESS_HEADER_SIZE + payload;
+    return (const char *)compressed.data;
+}
+
+const char *decompress_frame(const char *frame, size_t len, size_t max, size_t *out_len) {
+    const unsigned char *h = (const unsigned char *)frame;
+    if (len < COMPRESS_HEADER_SIZE || h[0] != COMPRESS_MARK ||
+        (((size_t)h[1] << 16) | ((size_t)h[2] << 8) | (size_t)h[3]) != len - COMPRESS_HEADER_SIZE) {
+        return NULL;
+    }
+
+    z_stream *z = inflater_start();
+    if (z == NULL) {
+        return NULL;
+    }
+    z->next_in = (Bytef *)(uintptr_t)(frame + COMPRESS_HEADER_SIZE);
+    z->avail_in = (uInt)(len - COMPRESS_HEADER_SIZE);
+
+    // El buffer crece a medida que hace falta, sin pasar de max
+    size_t used = 0;
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        if (used == expanded.cap) {
+            if (used >= max) {
+                return NULL;
+            }
+            size_t want = used * 2 > max ? max : used * 2;
+            if (zbuf_reserve(&expanded, want > 256 ? want : 256) < 0) {
+                return NULL;
+            }
+        }
+        size_t room = expanded.cap - used;
+        if (room > max - used) {
+            room = max - used;
+        }
+        if (room == 0) {
+            return NULL;
+        }
+        z->next_out = expanded.data + used;
+        z->avail_out = (uInt)room;
+        rc = inflate(z, Z_NO_FLUSH);
+        used += room - z->avail_out;
+        if (rc != Z_OK && rc != Z_STREAM_END) {
+            return NULL;
+        }
+        if (rc == Z_OK && z->avail_in == 0 && z->avail_out > 0) {
+            return NULL;    // Carga truncada
+        }
+    }
+
+    // La carga debe ser exactamente un flujo deflate, sin bytes de sobra
+    if (z->avail_in != 0 || used == 0) {
+        return NULL;
+    }
+    *out_len = used;
+    return (const char *)expanded.data;
+}
@@ -0,0 +1,28 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+
+// Compresión negociada en el REGISTRO con "compresion": "deflate". Cada trama
+// (JSON o binaria) se comprime por separado con deflate sin cabecera y un
+// diccionario fijo armado con los fragmentos del protocolo, así que no hay estado
+// por conexión y una misma trama comprimida sirve a todos los receptores. La
+// trama comprimida es COMPRESS_MARK seguida de la longitud de la carga en 3 bytes
+// (big-endian); su contenido descomprimido es una trama completa. El primer byte
+// no se confunde con el '{' de un documento JSON ni con WIRE_MARK
+#define COMPRESS_HEADER_SIZE 4
+#define COMPRESS_MAX_PAYLOAD 0xffffff
+#define COMPRESS_MARK 0x01
+#define COMPRESS_NAME "deflate"
+
+// Comprime una trama completa. El resultado (con cabecera) vive en un buffer del
+// hilo hasta la siguiente llamada. Retorna NULL si falló o si no ahorra bytes:
+// entonces conviene enviar la trama original
+const char *compress_frame(const char *data, size_t len, size_t *out_len);
+
+// Descomprime una trama comprimida completa (con cabecera) que no pase de max
+// bytes una vez expandida. El resultado vive en un buffer del hilo hasta la
+// siguiente llamada. Retorna NULL si la trama es inválida o excede max
+const char *decompress_frame(const char *frame, size_t len, size_t max, size_t *out_len);
+
+#endif
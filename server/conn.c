@@ -0,0 +1,676 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "conn.h"
+#include "reactor.h"
+#include "slab.h"
+#include "wire.h"
+#include "compress.h"
+
+// Conexiones con salida encolada por este hilo, pendientes de vaciar
+static __thread conn_t **flush_list;
+static __thread size_t flush_len;
+static __thread size_t flush_cap;
+
+// Límites de las colas de salida y política con los clientes lentos
+static size_t outq_max = OUTQ_MAX_BYTES;
+static size_t outq_global_max = OUTQ_GLOBAL_MAX_BYTES;
+static slow_policy_t slow_policy = SLOW_DROP;
+
+// Ventana de agrupación de la salida (0: cada lote se escribe al terminar)
+static uint64_t coalesce_ns;
+static unsigned coalesce_frames = COALESCE_FRAMES;
+
+// Contabilidad global de la salida (atómicos)
+static size_t queued_total;             // Bytes encolados en todas las conexiones
+static unsigned long dropped_frames;
+static unsigned long dropped_bytes;
+static unsigned long paused_total;
+static unsigned long evicted_total;
+static unsigned long reported[4];       // Contadores del informe anterior
+static unsigned long write_calls;       // Escrituras (writev o envíos del anillo) preparadas
+static unsigned long frames_written;    // Tramas completas entregadas al socket
+static unsigned long reported_writes[2];
+
+// Aviso de expulsión compartido por todos los clientes expulsados
+static frame_t *evict_notice;
+static pthread_once_t evict_notice_once = PTHREAD_ONCE_INIT;
+
+void conn_set_limits(size_t per_conn, size_t global, slow_policy_t policy) {
+    outq_max = per_conn;
+    outq_global_max = global;
+    slow_policy = policy;
+}
+
+void conn_set_coalesce(unsigned window_us, unsigned frames) {
+    coalesce_ns = (uint64_t)window_us * 1000;
+    coalesce_frames = frames;
+}
+
+int conn_coalescing(void) {
+    return coalesce_ns > 0;
+}
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Función para inicializar el estado de una conexión aceptada
+void conn_init(conn_t *conn, int fd, const struct sockaddr_in *addr, int reactor) {
+    conn->fd = fd;
+    conn->reactor = reactor;
+    conn->user = NULL;
+    conn->refs = 1;
+    if (addr != NULL) {
+        conn->port = ntohs(addr->sin_port);
+        inet_ntop(AF_INET, &addr->sin_addr, conn->ip, INET_ADDRSTRLEN);
+    }
+    pthread_mutex_init(&conn->out_mutex, NULL);
+    pthread_mutex_init(&conn->task_mutex, NULL);
+}
+
+// Función para acumular bytes de un documento incompleto
+static int append_partial(conn_t *conn, const char *data, size_t len) {
+    if (conn->in_len + len > MAX_FRAME_SIZE) {
+        fprintf(stderr, "Documento JSON demasiado grande (%s:%d)\n", conn->ip, conn->port);
+        return -1;
+    }
+
+    if (conn->in_len + len > conn->in_cap) {
+        size_t cap = conn->in_cap ? conn->in_cap : BUFFER_SIZE;
+        while (cap < conn->in_len + len) {
+            cap *= 2;
+        }
+        char *tmp = realloc(conn->in_buf, cap);
+        if (tmp == NULL) {
+            return -1;
+        }
+        conn->in_buf = tmp;
+        conn->in_cap = cap;
+    }
+
+    memcpy(conn->in_buf + conn->in_len, data, len);
+    conn->in_len += len;
+    return 0;
+}
+
+// Función para calcular el tamaño de una trama binaria o comprimida según su
+// cabecera: ambas llevan la longitud de la carga en los bytes que siguen a la marca
+static size_t frame_total(const char *header) {
+    return WIRE_HEADER_SIZE + (wire_payload_len(header) & WIRE_MAX_PAYLOAD);
+}
+
+// Función para consumir bytes de una trama binaria o comprimida (cabecera de
+// longitud y carga). Retorna los bytes usados de data o -1 si la conexión debe cerrarse
+static long feed_binary(conn_t *conn, const char *data, size_t len) {
+    size_t used = 0;
+    size_t total;
+
+    // Caso común: la trama entera está en el buffer recibido, sin copias
+    if (conn->in_len == 0 && len >= WIRE_HEADER_SIZE) {
+        total = frame_total(data);
+        if (total <= len && total <= MAX_FRAME_SIZE) {
+            return on_client_message(conn, data, total) < 0 ? -1 : (long)total;
+        }
+    }
+
+    // Completar primero la cabecera para conocer la longitud
+    if (conn->in_len < WIRE_HEADER_SIZE) {
+        used = WIRE_HEADER_SIZE - conn->in_len;
+        if (used > len) {
+            used = len;
+        }
+        if (append_partial(conn, data, used) < 0) {
+            return -1;
+        }
+        if (conn->in_len < WIRE_HEADER_SIZE) {
+            conn->in_binary = 1;
+            return (long)used;
+        }
+    }
+
+    total = frame_total(conn->in_buf);
+    if (total > MAX_FRAME_SIZE) {
+        fprintf(stderr, "Trama binaria demasiado grande (%s:%d)\n", conn->ip, conn->port);
+        return -1;
+    }
+
+    size_t n = total - conn->in_len;
+    if (n > len - used) {
+        n = len - used;
+    }
+    if (append_partial(conn, data + used, n) < 0) {
+        return -1;
+    }
+    used += n;
+    if (conn->in_len < total) {
+        conn->in_binary = 1;
+        return (long)used;
+    }
+
+    conn->in_binary = 0;
+    int rc = on_client_message(conn, conn->in_buf, conn->in_len);
+    conn->in_len = 0;
+    return rc < 0 ? -1 : (long)used;
+}
+
+// Función para separar documentos JSON y tramas binarias consecutivos del flujo TCP
+int conn_feed(conn_t *conn, const char *data, size_t len) {
+    size_t start = 0;   // Inicio del documento en curso dentro de data
+    size_t i = 0;
+
+    // Continuar una trama binaria empezada en una lectura anterior
+    if (conn->in_binary) {
+        long used = feed_binary(conn, data, len);
+        if (used < 0) {
+            return -1;
+        }
+        i = start = (size_t)used;
+    }
+
+    for (; i < len; i++) {
+        char ch = data[i];
+
+        if (conn->depth == 0 && conn->in_len == 0) {
+            // Entre documentos: se ignoran espacios; todo documento es un objeto
+            if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+                start = i + 1;
+                continue;
+            }
+            // Trama binaria o comprimida: su cabecera dice dónde termina
+            if (ch == WIRE_MARK || ch == COMPRESS_MARK) {
+                long used = feed_binary(conn, data + i, len - i);
+                if (used < 0) {
+                    return -1;
+                }
+                i += (size_t)used - 1;
+                start = i + 1;
+                continue;
+            }
+            if (ch != '{') {
+                fprintf(stderr, "Error en JSON\n");
+                return -1;
+            }
+            start = i;
+        }
+
+        if (conn->in_string) {
+            if (conn->escape) {
+                conn->escape = 0;
+            } else if (ch == '\\') {
+                conn->escape = 1;
+            } else if (ch == '"') {
+                conn->in_string = 0;
+            }
+            continue;
+        }
+
+        if (ch == '"') {
+            conn->in_string = 1;
+        } else if (ch == '{' || ch == '[') {
+            conn->depth++;
+        } else if (ch == '}' || ch == ']') {
+            if (--conn->depth > 0) {
+                continue;
+            }
+
+            // Documento completo: [start, i] en data, precedido por lo acumulado
+            int rc;
+            if (conn->in_len == 0) {
+                // Caso común: el documento entero está en el buffer recibido, sin copias
+                rc = on_client_message(conn, data + start, i + 1 - start);
+            } else {
+                if (append_partial(conn, data + start, i + 1 - start) < 0) {
+                    return -1;
+                }
+                rc = on_client_message(conn, conn->in_buf, conn->in_len);
+                conn->in_len = 0;
+            }
+            if (rc < 0) {
+                return -1;
+            }
+            start = i + 1;
+        }
+    }
+
+    // Guardar el documento incompleto para la siguiente lectura
+    if (conn->depth > 0 && start < len) {
+        if (append_partial(conn, data + start, len - start) < 0) {
+            return -1;
+        }
+    }
+
+    // Devolver el buffer una vez vaciado: una conexión inactiva no retiene memoria de entrada
+    if (conn->in_len == 0 && conn->in_buf != NULL) {
+        free(conn->in_buf);
+        conn->in_buf = NULL;
+        conn->in_cap = 0;
+    }
+
+    return 0;
+}
+
+// Función para anotar la conexión en la lista de vaciado del hilo actual
+static void schedule_flush(conn_t *conn) {
+    if (__atomic_exchange_n(&conn->flush_queued, 1, __ATOMIC_ACQ_REL)) {
+        return;     // Otro hilo ya la vaciará
+    }
+
+    if (flush_len == flush_cap) {
+        size_t cap = flush_cap ? flush_cap * 2 : 64;
+        conn_t **tmp = realloc(flush_list, cap * sizeof(conn_t *));
+        if (tmp == NULL) {
+            // Sin memoria para diferir: vaciar ahora
+            __atomic_store_n(&conn->flush_queued, 0, __ATOMIC_RELEASE);
+            reactor_flush(conn);
+            return;
+        }
+        flush_list = tmp;
+        flush_cap = cap;
+    }
+
+    conn_get(conn);
+    flush_list[flush_len++] = conn;
+}
+
+// Función para crear el aviso de expulsión una sola vez
+static void create_evict_notice(void) {
+    static const char notice[] =
+        "{\"tipo\":\"SERVER_SHUTDOWN\",\"mensaje\":\"Desconectado: no estás leyendo los mensajes a tiempo\"}";
+    evict_notice = frame_create(notice, sizeof(notice) - 1);
+}
+
+// Función para saber si una trama más rebasa el límite propio o el global.
+// Una conexión con la cola vacía va al día: la presión global no la frena
+static int over_limit(conn_t *conn, size_t len) {
+    if (conn->out_bytes + len > outq_max) {
+        return 1;
+    }
+    return conn->out_bytes > 0 &&
+           __atomic_load_n(&queued_total, __ATOMIC_RELAXED) + len > outq_global_max;
+}
+
+// Función para contar una trama descartada
+static void count_drop(conn_t *conn, size_t len) {
+    __atomic_add_fetch(&dropped_frames, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&dropped_bytes, len, __ATOMIC_RELAXED);
+    if (conn->out_dropped++ == 0) {
+        fprintf(stderr, "Cola de salida llena (%s:%d): se descartan tramas\n", conn->ip, conn->port);
+    }
+}
+
+// Función para retirar tramas de la cola sin enviarlas; la trama a medio enviar
+// o en vuelo se conserva siempre. Con all=0 solo quita BROADCAST antiguos hasta que quepa need
+static void discard_frames(conn_t *conn, size_t need, int all) {
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < conn->out_count; i++) {
+        frame_t *f = conn->out_q[(conn->out_head + i) % conn->out_cap];
+        int sending = i < conn->out_inflight || (i == 0 && conn->out_off > 0);
+
+        if (!sending && (all || (f->droppable && over_limit(conn, need)))) {
+            conn->out_bytes -= f->len;
+            __atomic_sub_fetch(&queued_total, f->len, __ATOMIC_RELAXED);
+            count_drop(conn, f->len);
+            frame_put(f);
+            continue;
+        }
+        // Compactar en el sitio: kept <= i, así que no se pisa nada pendiente de leer
+        conn->out_q[(conn->out_head + kept) % conn->out_cap] = f;
+        kept++;
+    }
+    conn->out_count = kept;
+}
+
+// Función para cerrar una conexión expulsada y dejar que el reactor dueño vea el EOF
+static void finish_eviction(conn_t *conn) {
+    conn->closed = 1;
+    shutdown(conn->fd, SHUT_RDWR);
+    __atomic_store_n(&conn->in_paused, 0, __ATOMIC_RELEASE);
+    reactor_resume(conn);
+}
+
+// Función para expulsar a un cliente lento: solo le queda por recibir el aviso
+static void evict(conn_t *conn) {
+    int timeout = EVICT_GRACE_MS;
+
+    discard_frames(conn, 0, 1);
+    conn->evicted = 1;
+    __atomic_store_n(&conn->in_paused, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&evicted_total, 1, __ATOMIC_RELAXED);
+    // Un cliente que no lee nunca acusa el aviso: el kernel corta tras el plazo
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+    fprintf(stderr, "Cliente lento expulsado (%s:%d)\n", conn->ip, conn->port);
+}
+
+// Función para encolar la trama al final de la cola (out_mutex tomado)
+static int push_frame(conn_t *conn, frame_t *frame) {
+    if (conn->out_count == conn->out_cap) {
+        unsigned cap = conn->out_cap ? conn->out_cap * 2 : 8;
+        frame_t **q = malloc(cap * sizeof(frame_t *));
+        if (q == NULL) {
+            return -1;
+        }
+        // Desenrollar la cola circular al copiarla
+        for (unsigned i = 0; i < conn->out_count; i++) {
+            q[i] = conn->out_q[(conn->out_head + i) % conn->out_cap];
+        }
+        free(conn->out_q);
+        conn->out_q = q;
+        conn->out_head = 0;
+        conn->out_cap = cap;
+    }
+
+    // La ventana de agrupación se cuenta desde la primera trama que no está ya en un
+    // envío: con la cola vacía o con todo lo encolado en vuelo (io_uring)
+    if (conn->out_count == conn->out_inflight && coalesce_ns > 0) {
+        conn->out_since = clock_ns();
+    }
+
+    frame_get(frame);
+    conn->out_q[(conn->out_head + conn->out_count) % conn->out_cap] = frame;
+    conn->out_count++;
+    conn->out_bytes += frame->len;
+    __atomic_add_fetch(&queued_total, frame->len, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Función para encolar una trama saliente sin hacer E/S ni copiarla
+int conn_send_frame(conn_t *conn, frame_t *frame) {
+    pthread_mutex_lock(&conn->out_mutex);
+
+    if (conn->closed || conn->evicted) {
+        pthread_mutex_unlock(&conn->out_mutex);
+        return -1;
+    }
+
+    // Colas acotadas: un cliente que no lee no puede hacer crecer la memoria del servidor
+    if (over_limit(conn, frame->len)) {
+        switch (slow_policy) {
+            case SLOW_DROP:
+                discard_frames(conn, frame->len, 0);
+                if (!over_limit(conn, frame->len)) {
+                    break;
+                }
+                count_drop(conn, frame->len);
+                pthread_mutex_unlock(&conn->out_mutex);
+                return -1;
+            case SLOW_PAUSE:
+                if (!__atomic_exchange_n(&conn->in_paused, 1, __ATOMIC_ACQ_REL)) {
+                    __atomic_add_fetch(&paused_total, 1, __ATOMIC_RELAXED);
+                }
+                count_drop(conn, frame->len);
+                pthread_mutex_unlock(&conn->out_mutex);
+                return -1;
+            case SLOW_DISCONNECT:
+                pthread_once(&evict_notice_once, create_evict_notice);
+                evict(conn);
+                count_drop(conn, frame->len);
+                if (evict_notice == NULL || push_frame(conn, evict_notice) < 0) {
+                    finish_eviction(conn);
+                }
+                pthread_mutex_unlock(&conn->out_mutex);
+                schedule_flush(conn);
+                return -1;
+        }
+    }
+
+    if (push_frame(conn, frame) < 0) {
+        pthread_mutex_unlock(&conn->out_mutex);
+        return -1;
+    }
+
+    pthread_mutex_unlock(&conn->out_mutex);
+
+    schedule_flush(conn);
+    return 0;
+}
+
+// Función para encolar una respuesta propia de un solo destinatario
+int conn_send(conn_t *conn, const char *data, size_t len) {
+    frame_t *frame = frame_create(data, len);
+    if (frame == NULL) {
+        return -1;
+    }
+    int rc = conn_send_frame(conn, frame);
+    frame_put(frame);
+    return rc;
+}
+
+// Función para saber hasta cuándo puede esperar una conexión a juntar más tramas;
+// retorna 0 si debe escribirse ya
+static uint64_t coalesce_deadline(conn_t *conn, uint64_t now) {
+    pthread_mutex_lock(&conn->out_mutex);
+    uint64_t due = conn->out_since + coalesce_ns;
+    int wait = conn->out_count > 0 && conn->out_count < coalesce_frames &&
+               !conn->closed && !conn->evicted && due > now;
+    pthread_mutex_unlock(&conn->out_mutex);
+    return wait ? due : 0;
+}
+
+// Función para vaciar lo encolado por el hilo actual (una vez por lote de eventos).
+// Con defer, las conexiones que aún pueden esperar se quedan en la lista, todavía
+// marcadas: quien encole para ellas mientras tanto no las vuelve a anotar
+static long long flush_list_run(int defer) {
+    uint64_t now = defer && coalesce_ns > 0 ? clock_ns() : 0;
+    uint64_t next = 0;
+    size_t kept = 0;
+
+    for (size_t i = 0; i < flush_len; i++) {
+        conn_t *conn = flush_list[i];
+        if (now != 0) {
+            uint64_t due = coalesce_deadline(conn, now);
+            if (due != 0) {
+                flush_list[kept++] = conn;
+                if (next == 0 || due < next) {
+                    next = due;
+                }
+                continue;
+            }
+        }
+        // Desmarcar antes de escribir: lo encolado a partir de aquí lo vaciará quien lo encole
+        __atomic_store_n(&conn->flush_queued, 0, __ATOMIC_RELEASE);
+        reactor_flush(conn);
+        conn_put(conn);
+    }
+    flush_len = kept;
+    return next != 0 ? (long long)(next - now) : -1;
+}
+
+void conn_flush_later(conn_t *conn) {
+    schedule_flush(conn);
+}
+
+void conn_flush_pending(void) {
+    flush_list_run(0);
+}
+
+long long conn_flush_window(void) {
+    return flush_list_run(1);
+}
+
+// Función para preparar los iovec de las primeras tramas de la cola
+int conn_out_iov(conn_t *conn, struct iovec *iov, int max) {
+    int n = 0;
+
+    for (unsigned i = 0; i < conn->out_count && n < max; i++) {
+        frame_t *f = conn->out_q[(conn->out_head + i) % conn->out_cap];
+        size_t skip = i == 0 ? conn->out_off : 0;
+        iov[n].iov_base = (char *)frame_bytes(f) + skip;
+        iov[n].iov_len = f->len - skip;
+        n++;
+    }
+
+    if (n > 0) {
+        __atomic_add_fetch(&write_calls, 1, __ATOMIC_RELAXED);
+    }
+    return n;
+}
+
+// Función para retirar de la cola los bytes enviados
+void conn_out_consume(conn_t *conn, size_t n) {
+    unsigned long done = 0;
+
+    conn->out_bytes -= n;
+    __atomic_sub_fetch(&queued_total, n, __ATOMIC_RELAXED);
+    n += conn->out_off;
+
+    while (conn->out_count > 0) {
+        frame_t *f = conn->out_q[conn->out_head];
+        if (n < f->len) {
+            break;
+        }
+        n -= f->len;
+        frame_put(f);
+        conn->out_head = (conn->out_head + 1) % conn->out_cap;
+        conn->out_count--;
+        done++;
+    }
+    conn->out_off = n;
+    __atomic_add_fetch(&frames_written, done, __ATOMIC_RELAXED);
+
+    if (conn->evicted) {
+        if (conn->out_count == 0 && !conn->closed) {
+            finish_eviction(conn);     // Aviso entregado
+        }
+    } else if (__atomic_load_n(&conn->in_paused, __ATOMIC_ACQUIRE) && conn->out_bytes <= outq_max / 2) {
+        // Histéresis: reanudar la lectura al vaciar la mitad de la cola
+        __atomic_store_n(&conn->in_paused, 0, __ATOMIC_RELEASE);
+        reactor_resume(conn);
+    }
+}
+
+// Función para informar del uso de las colas de salida y de los descartes
+void conn_report(void) {
+    size_t queued = __atomic_load_n(&queued_total, __ATOMIC_RELAXED);
+    unsigned long now[4] = {
+        __atomic_load_n(&dropped_frames, __ATOMIC_RELAXED),
+        __atomic_load_n(&dropped_bytes, __ATOMIC_RELAXED),
+        __atomic_load_n(&paused_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&evicted_total, __ATOMIC_RELAXED)
+    };
+    unsigned long writes[2] = {
+        __atomic_load_n(&write_calls, __ATOMIC_RELAXED),
+        __atomic_load_n(&frames_written, __ATOMIC_RELAXED)
+    };
+
+    // Tramas por escritura desde el informe anterior: lo que junta cada writev()
+    if (writes[0] != reported_writes[0]) {
+        printf("Escrituras: %lu en el periodo, %.1f tramas por escritura\n", writes[0] - reported_writes[0],
+               (double)(writes[1] - reported_writes[1]) / (double)(writes[0] - reported_writes[0]));
+        memcpy(reported_writes, writes, sizeof(writes));
+    }
+
+    if (queued == 0 && memcmp(now, reported, sizeof(now)) == 0) {
+        return;     // Sin presión ni cambios desde el informe anterior
+    }
+    memcpy(reported, now, sizeof(now));
+
+    printf("Colas de salida: %zu KiB encolados (límite %zu KiB) | %lu tramas descartadas (%lu KiB) | "
+           "%lu pausas | %lu expulsiones\n",
+           queued / 1024, outq_global_max / 1024, now[0], now[1] / 1024, now[2], now[3]);
+}
+
+size_t conn_out_room(conn_t *conn) {
+    size_t room = 0;
+
+    pthread_mutex_lock(&conn->out_mutex);
+    if (!conn->closed && !conn->evicted && conn->out_bytes < outq_max / 2) {
+        room = outq_max / 2 - conn->out_bytes;
+    }
+    pthread_mutex_unlock(&conn->out_mutex);
+    return room;
+}
+
+// Función para escribir la cola en el socket no bloqueante agrupando tramas
+int conn_write(conn_t *conn) {
+    struct iovec iov[OUTQ_IOV_MAX];
+    int rc = 0;
+
+    pthread_mutex_lock(&conn->out_mutex);
+
+    while (conn->out_count > 0 && !conn->closed) {
+        frame_t *head = conn->out_q[conn->out_head];
+        ssize_t n;
+        if (head->file != NULL) {
+            // Tramo de archivo (historial): del caché de páginas al socket sin pasar por aquí
+            off_t off = (off_t)(head->file->off + (long long)conn->out_off);
+            n = sendfile(conn->fd, head->file->fd, &off, head->len - conn->out_off);
+            __atomic_add_fetch(&write_calls, 1, __ATOMIC_RELAXED);
+        } else {
+            int n_iov = conn_out_iov(conn, iov, OUTQ_IOV_MAX);
+            n = writev(conn->fd, iov, n_iov);
+        }
+        if (n > 0) {
+            conn_out_consume(conn, (size_t)n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Socket lleno: el reactor dueño seguirá al recibir EPOLLOUT
+            break;
+        } else {
+            rc = -1;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&conn->out_mutex);
+    return rc;
+}
+
+// Función para impedir nuevos envíos; la cola se libera con la última referencia
+void conn_shutdown(conn_t *conn) {
+    pthread_mutex_lock(&conn->out_mutex);
+    conn->closed = 1;
+    pthread_mutex_unlock(&conn->out_mutex);
+}
+
+// Función para cortar una conexión desde otro hilo sin cerrar su descriptor
+void conn_abort(conn_t *conn) {
+    pthread_mutex_lock(&conn->out_mutex);
+    // Mientras no esté cerrada, el reactor dueño aún no ha hecho close(): el descriptor es suyo
+    if (!conn->closed) {
+        conn->closed = 1;
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&conn->out_mutex);
+}
+
+void conn_get(conn_t *conn) {
+    __atomic_add_fetch(&conn->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Función para liberar el estado de reensamblado
+static void conn_release(conn_t *conn) {
+    free(conn->in_buf);
+    conn->in_buf = NULL;
+    conn->in_len = conn->in_cap = 0;
+}
+
+// Función para soltar una referencia y liberar la conexión con la última
+void conn_put(conn_t *conn) {
+    if (__atomic_sub_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    conn_release(conn);
+    __atomic_sub_fetch(&queued_total, conn->out_bytes, __ATOMIC_RELAXED);
+    while (conn->out_count > 0) {
+        frame_put(conn->out_q[conn->out_head]);
+        conn->out_head = (conn->out_head + 1) % conn->out_cap;
+        conn->out_count--;
+    }
+    free(conn->out_q);
+    pthread_mutex_destroy(&conn->out_mutex);
+    pthread_mutex_destroy(&conn->task_mutex);
+    slab_free(conn);
+}
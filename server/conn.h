@@ -0,0 +1,153 @@
+#ifndef CONN_H
+#define CONN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include "frame.h"
+#include "wire.h"
+
+#define MAX_FRAME_SIZE 65536            // Tamaño máximo de un documento JSON o trama binaria entrante (también descomprimida)
+#define OUTQ_MAX_BYTES (1024 * 1024)    // Límite por defecto de la cola de salida de una conexión
+#define OUTQ_GLOBAL_MAX_BYTES (256 * 1024 * 1024)  // Límite por defecto de todas las colas juntas
+#define OUTQ_IOV_MAX 64                 // Tramas agrupadas por llamada a writev()
+#define EVICT_GRACE_MS 5000             // Plazo para que un cliente expulsado reciba el aviso
+#define COALESCE_FRAMES OUTQ_IOV_MAX    // Tramas que adelantan el vaciado si hay ventana de agrupación
+
+// Formato de salida de una conexión: su codificación y si la comprime. Las tramas
+// compartidas (respuestas fijas, difusiones, LISTA) se preparan por formato
+#define CONN_FORMATS (WIRE_ENCODINGS * 2)
+#define CONN_FORMAT(conn) ((conn)->encoding * 2 + (conn)->compressed)
+
+// Qué hacer con un cliente cuya cola de salida supera su límite
+typedef enum {
+    SLOW_DROP = 0,      // Descartar los BROADCAST más antiguos de su cola
+    SLOW_PAUSE,         // Dejar de leerle hasta que vacíe la mitad de su cola
+    SLOW_DISCONNECT     // Avisarle con SERVER_SHUTDOWN y cerrar
+} slow_policy_t;
+
+// Estado de una conexión de cliente: identidad, reensamblado de la entrada y cola de salida
+typedef struct conn {
+    int fd;
+    char ip[INET_ADDRSTRLEN];
+    uint16_t port;
+    int reactor;            // Reactor dueño del socket
+    struct user *user;      // Usuario de la sesión (NULL: sin registrar)
+    int encoding;           // Codificación de salida negociada en el REGISTRO (wire_encoding_t)
+    int compressed;         // Salida comprimida, negociada en el REGISTRO
+
+    // Buzón de DM (server.c, bajo el candado de la porción del usuario): mientras se
+    // vacía, los DM nuevos pasan por el buzón para no adelantarse a los pendientes
+    int inbox_pending;      // Vaciado sin terminar (atómico)
+    int inbox_queued;       // DM desviados al hilo del buzón que aún no guardó (atómico)
+
+    // Documento parcial pendiente de completar (ya escaneado)
+    char *in_buf;
+    size_t in_len;
+    size_t in_cap;
+
+    // Estado del escáner de fronteras entre documentos
+    int depth;
+    int in_string;
+    int escape;
+    int in_binary;          // in_buf guarda una trama binaria incompleta
+
+    // Referencias: el reactor dueño y cada hilo con un vaciado pendiente
+    int refs;
+    int flush_queued;       // Ya figura en la lista de vaciado de algún hilo
+
+    // Cola circular de referencias a tramas salientes, protegida por out_mutex
+    pthread_mutex_t out_mutex;
+    frame_t **out_q;
+    unsigned out_head;
+    unsigned out_count;
+    unsigned out_cap;
+    size_t out_off;         // Bytes ya enviados de la primera trama
+    size_t out_bytes;       // Bytes pendientes en total
+    unsigned out_inflight;  // Tramas del inicio en un envío asíncrono: no se descartan
+    unsigned long out_dropped;
+    uint64_t out_since;     // Instante (ns) en que la cola dejó de estar vacía (ventana de agrupación)
+    int closed;             // Cerrada: no se encola ni se escribe más
+    int evicted;            // Expulsada por lenta: solo sale el aviso y se cierra
+    int in_paused;          // Lectura detenida hasta que baje su cola (atómico)
+
+    // Solicitudes pendientes del pool de trabajadores, protegidas por task_mutex
+    pthread_mutex_t task_mutex;
+    struct dispatch_req *task_head;
+    struct dispatch_req *task_tail;
+    int task_scheduled;     // En alguna cola del pool o en manos de un trabajador
+    int task_closing;       // El reactor la cerró: liberar la sesión tras lo pendiente
+    int task_failed;        // Documento inválido: se descarta lo que quede pendiente
+} conn_t;
+
+// Fija los límites de las colas de salida y la política con los clientes lentos
+void conn_set_limits(size_t per_conn, size_t global, slow_policy_t policy);
+
+// Fija la ventana de agrupación de la salida: una conexión con tramas nuevas espera
+// hasta window_us o hasta juntar frames tramas antes de escribirse (0: sin espera)
+void conn_set_coalesce(unsigned window_us, unsigned frames);
+
+// Indica si hay ventana de agrupación
+int conn_coalescing(void);
+
+// Inicializa una conexión recién aceptada con una referencia (la del reactor dueño)
+void conn_init(conn_t *conn, int fd, const struct sockaddr_in *addr, int reactor);
+
+// Separa los documentos JSON y las tramas binarias contenidos en los bytes recibidos
+// y los entrega uno a uno a on_client_message(); retorna -1 si la conexión debe cerrarse
+int conn_feed(conn_t *conn, const char *data, size_t len);
+
+// Encola una referencia a la trama y programa su envío al final del lote del
+// hilo actual; nunca bloquea. Por encima de los límites aplica la política de
+// clientes lentos. Retorna -1 si la trama no se encoló
+int conn_send_frame(conn_t *conn, frame_t *frame);
+
+// Igual que conn_send_frame() para una respuesta dirigida a un solo cliente
+int conn_send(conn_t *conn, const char *data, size_t len);
+
+// Bytes que aún caben en la cola sin pasar de la mitad del límite (0 si la conexión
+// se cerró): un envío largo que se reparte así no activa la política de clientes lentos
+size_t conn_out_room(conn_t *conn);
+
+// Anota la conexión en la lista de vaciado del hilo actual, como al encolar una
+// trama: sale con conn_flush_window() cuando vence su ventana de agrupación
+void conn_flush_later(conn_t *conn);
+
+// Vacía las conexiones con salida encolada por el hilo actual
+void conn_flush_pending(void);
+
+// Como conn_flush_pending(), pero las conexiones cuya ventana de agrupación no
+// ha vencido siguen pendientes. Retorna los ns hasta el primer vencimiento (-1
+// si no queda ninguna): el hilo debe volver a llamarla a más tardar entonces
+long long conn_flush_window(void);
+
+// Escribe la cola con writev() no bloqueante (sendfile() para los tramos de
+// archivo) hasta vaciarla o llenar el socket; retorna -1 ante un error de escritura
+int conn_write(conn_t *conn);
+
+// Prepara hasta max iovec con el inicio de la cola (out_mutex tomado)
+int conn_out_iov(conn_t *conn, struct iovec *iov, int max);
+
+// Descarta de la cola los bytes ya enviados y reanuda la lectura o termina la
+// expulsión según corresponda (out_mutex tomado)
+void conn_out_consume(conn_t *conn, size_t n);
+
+// Imprime bytes encolados, contadores de descartes, pausas y expulsiones y tramas
+// por escritura si cambiaron
+void conn_report(void);
+
+// Marca la conexión como cerrada para que nadie más encole ni escriba en ella
+void conn_shutdown(conn_t *conn);
+
+// Cierra la conexión desde un hilo ajeno al reactor dueño: corta el socket y el
+// reactor la limpiará al ver el fin de flujo
+void conn_abort(conn_t *conn);
+
+void conn_get(conn_t *conn);
+
+// Suelta una referencia; la última libera la conexión
+void conn_put(conn_t *conn);
+
+#endif
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include "deque.h"
+
+int deque_init(deque_t *deque, size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    deque->items = calloc(cap, sizeof(void *));
+    if (deque->items == NULL) {
+        return -1;
+    }
+    deque->mask = (long)cap - 1;
+    deque->top = 0;
+    deque->bottom = 0;
+    return 0;
+}
+
+int deque_push(deque_t *deque, void *item) {
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    if (b - t > deque->mask) {
+        return -1;
+    }
+    __atomic_store_n(&deque->items[b & deque->mask], item, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void *deque_take(deque_t *deque) {
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // Vacío: deshacer la reserva
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    void *item = __atomic_load_n(&deque->items[b & deque->mask], __ATOMIC_RELAXED);
+    if (t == b) {
+        // Último elemento: competir con los ladrones por él
+        if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            item = NULL;
+        }
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return item;
+}
+
+void *deque_steal(deque_t *deque) {
+    long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    void *item = __atomic_load_n(&deque->items[t & deque->mask], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;    // Otro hilo se lo llevó antes
+    }
+    return item;
+}
+
+size_t deque_size(const deque_t *deque) {
+    long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    return b > t ? (size_t)(b - t) : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stddef.h>
+
+// Deque de Chase-Lev de capacidad fija: el dueño apila y desapila por abajo, los demás roban por arriba
+typedef struct {
+    void **items;
+    long mask;                                  // Capacidad - 1 (potencia de dos)
+    long top __attribute__((aligned(64)));      // Siguiente a robar
+    long bottom __attribute__((aligned(64)));   // Siguiente posición libre del dueño
+} deque_t;
+
+int deque_init(deque_t *deque, size_t capacity);
+
+// Apila un elemento (solo el dueño); -1 si está lleno
+int deque_push(deque_t *deque, void *item);
+
+// Desapila el elemento más reciente (solo el dueño); NULL si está vacío
+void *deque_take(deque_t *deque);
+
+// Roba el elemento más antiguo desde otro hilo; NULL si está vacío o se perdió la carrera
+void *deque_steal(deque_t *deque);
+
+// Elementos apilados (aproximado)
+size_t deque_size(const deque_t *deque);
+
+#endif
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "directory.h"
+
+// Época anunciada por un lector (0: fuera de una sección de lectura)
+typedef struct {
+    unsigned long epoch;
+    char pad[64 - sizeof(unsigned long)];   // Una línea de caché por lector
+} reader_slot_t;
+
+// Instantánea retirada a la espera de que terminen sus lectores
+typedef struct retired {
+    dir_snapshot_t *snapshot;
+    unsigned long epoch;
+    struct retired *next;
+} retired_t;
+
+static dir_snapshot_t *current;
+static unsigned long data_version;
+static unsigned long global_epoch = 1;
+
+static reader_slot_t readers[DIR_MAX_READERS];
+static int n_readers;
+static __thread int reader_id = -1;
+
+// Protege la lista de retiradas y a los lectores sin ranura propia
+static pthread_mutex_t reclaim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static retired_t *retired_head;
+
+dir_snapshot_t *directory_alloc(size_t count) {
+    dir_snapshot_t *snapshot = calloc(1, sizeof(dir_snapshot_t) + count * sizeof(dir_entry_t));
+    if (snapshot != NULL) {
+        snapshot->count = count;
+    }
+    return snapshot;
+}
+
+static void snapshot_free(dir_snapshot_t *snapshot) {
+    for (int i = 0; i < CONN_FORMATS; i++) {
+        if (snapshot->lista[i] != NULL) {
+            frame_put(snapshot->lista[i]);
+        }
+    }
+    free(snapshot);
+}
+
+static int cmp_entry(const void *a, const void *b) {
+    return strcmp(((const dir_entry_t *)a)->username, ((const dir_entry_t *)b)->username);
+}
+
+// Función para liberar las instantáneas que ya ningún lector puede estar usando
+static void reclaim(void) {
+    unsigned long oldest = 0;
+    int n = __atomic_load_n(&n_readers, __ATOMIC_ACQUIRE);
+
+    if (n > DIR_MAX_READERS) {
+        n = DIR_MAX_READERS;
+    }
+    for (int i = 0; i < n; i++) {
+        unsigned long e = __atomic_load_n(&readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && (oldest == 0 || e < oldest)) {
+            oldest = e;
+        }
+    }
+
+    // Un lector con época e pudo ver todo lo retirado en una época >= e
+    retired_t **link = &retired_head;
+    while (*link != NULL) {
+        retired_t *r = *link;
+        if (oldest == 0 || r->epoch < oldest) {
+            *link = r->next;
+            snapshot_free(r->snapshot);
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+// Función para publicar una instantánea nueva y retirar la anterior
+void directory_publish(dir_snapshot_t *snapshot) {
+    qsort(snapshot->entries, snapshot->count, sizeof(dir_entry_t), cmp_entry);
+
+    pthread_mutex_lock(&reclaim_mutex);
+
+    dir_snapshot_t *old = __atomic_exchange_n(&current, snapshot, __ATOMIC_SEQ_CST);
+    if (old != NULL) {
+        retired_t *r = malloc(sizeof(retired_t));
+        if (r == NULL) {
+            // Sin memoria para diferir: se conserva (fuga acotada) antes que arriesgar un lector
+            fprintf(stderr, "No se pudo retirar una instantánea del directorio\n");
+        } else {
+            r->snapshot = old;
+            r->epoch = __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST);
+            r->next = retired_head;
+            retired_head = r;
+        }
+    }
+    reclaim();
+
+    pthread_mutex_unlock(&reclaim_mutex);
+}
+
+void directory_touch(void) {
+    __atomic_add_fetch(&data_version, 1, __ATOMIC_RELEASE);
+}
+
+unsigned long directory_version(void) {
+    return __atomic_load_n(&data_version, __ATOMIC_ACQUIRE);
+}
+
+// Función para entrar en una sección de lectura anunciando la época actual
+const dir_snapshot_t *directory_read_begin(void) {
+    if (reader_id < 0) {
+        int id = __atomic_fetch_add(&n_readers, 1, __ATOMIC_ACQ_REL);
+        reader_id = id < DIR_MAX_READERS ? id : DIR_MAX_READERS;
+    }
+
+    if (reader_id == DIR_MAX_READERS) {
+        // Sin ranura propia: leer con el candado que impide liberar instantáneas
+        pthread_mutex_lock(&reclaim_mutex);
+    } else {
+        __atomic_store_n(&readers[reader_id].epoch, __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST),
+                         __ATOMIC_SEQ_CST);
+    }
+    return __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+}
+
+void directory_read_end(void) {
+    if (reader_id == DIR_MAX_READERS) {
+        pthread_mutex_unlock(&reclaim_mutex);
+    } else {
+        __atomic_store_n(&readers[reader_id].epoch, 0, __ATOMIC_RELEASE);
+    }
+}
+
+const dir_entry_t *directory_find(const dir_snapshot_t *snapshot, const char *username) {
+    size_t lo = 0;
+    size_t hi = snapshot->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = strcmp(snapshot->entries[mid].username, username);
+        if (c == 0) {
+            return &snapshot->entries[mid];
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+#include "frame.h"
+#include "conn.h"
+#include "users.h"
+
+#define DIR_MAX_READERS 256     // Hilos lectores con ranura de época propia
+
+// Datos públicos de un usuario tal como los ven LISTA y MOSTRAR
+typedef struct {
+    char username[USERS_NAME_SIZE];
+    char ip[INET_ADDRSTRLEN];
+    int status;
+} dir_entry_t;
+
+// Versión inmutable del directorio; los lectores la recorren sin candados
+typedef struct dir_snapshot {
+    unsigned long version;      // Versión de los datos con que se construyó
+    frame_t *lista[CONN_FORMATS];       // Respuesta LISTA ya serializada en cada formato (NULL si no se usa)
+    size_t count;
+    dir_entry_t entries[];      // Ordenadas por nombre para búsqueda binaria
+} dir_snapshot_t;
+
+// Reserva una instantánea vacía con espacio para count entradas
+dir_snapshot_t *directory_alloc(size_t count);
+
+// Ordena las entradas y publica la instantánea; la anterior se libera
+// cuando ningún lector que pudiera verla siga dentro de su sección de lectura
+void directory_publish(dir_snapshot_t *snapshot);
+
+// Anota un cambio en los datos: las instantáneas anteriores quedan obsoletas
+void directory_touch(void);
+
+// Versión actual de los datos del directorio
+unsigned long directory_version(void);
+
+// Abre una sección de lectura y retorna la instantánea publicada (o NULL);
+// debe cerrarse con directory_read_end() en el mismo hilo
+const dir_snapshot_t *directory_read_begin(void);
+
+void directory_read_end(void);
+
+// Busca un usuario en la instantánea; NULL si no está
+const dir_entry_t *directory_find(const dir_snapshot_t *snapshot, const char *username);
+
+#endif
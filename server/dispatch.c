@@ -0,0 +1,448 @@
+#define _GNU_SOURCE   // ppoll()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "dispatch.h"
+#include "mpsc.h"
+#include "deque.h"
+#include "slab.h"
+
+// Trabajador del pool: las conexiones con trabajo llegan por su cola de entrada y
+// pasan a su deque, del que los trabajadores ociosos pueden robar
+typedef struct {
+    int id;
+    mpsc_t inbox;           // Conexiones programadas por los reactores
+    deque_t deque;          // Conexiones listas (robables)
+    int wake_fd;            // eventfd para despertarlo cuando duerme
+    int sleeping;
+    pthread_t thread;
+
+    // Estadísticas acumuladas (escritas solo por el trabajador, salvo stalls)
+    unsigned long handled;
+    unsigned long steals;
+    uint64_t wait_ns;
+    uint64_t parse_ns;
+    uint64_t service_ns;
+    uint64_t flush_ns;      // Escritura de las colas de salida tras cada lote
+    uint64_t wait_max_ns;   // Se reinicia en cada informe
+    size_t depth_max;       // Se reinicia en cada informe
+    unsigned long stalls;   // Veces que un reactor encontró llenas todas las colas
+
+    // Totales del informe anterior (solo el hilo que informa)
+    unsigned long prev_handled;
+    unsigned long prev_steals;
+    uint64_t prev_wait_ns;
+    uint64_t prev_parse_ns;
+    uint64_t prev_service_ns;
+    uint64_t prev_flush_ns;
+    unsigned long prev_stalls;
+} worker_t;
+
+static worker_t *workers;
+static int n_workers;
+
+// Clases de tamaño (solicitud completa) servidas por el asignador de bloques, como
+// las de las tramas: las solicitudes habituales no pasan por malloc. Las mayores sí
+static const struct {
+    const char *name;
+    size_t size;
+} req_classes[] = {
+    {"solicitudes256", 256},
+    {"solicitudes1k", 1024},
+    {"solicitudes4k", 4096},
+};
+
+#define N_REQ_CLASSES (sizeof(req_classes) / sizeof(req_classes[0]))
+
+static slab_cache_t *req_caches[N_REQ_CLASSES];
+
+// Reparto circular de las conexiones que programa cada reactor
+static __thread unsigned next_worker;
+
+uint64_t dispatch_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void stat_add(uint64_t *field, uint64_t value) {
+    __atomic_store_n(field, *field + value, __ATOMIC_RELAXED);
+}
+
+// Función para despertar a un trabajador si anunció que dormía
+static void wake(worker_t *w) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&w->sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&w->sleeping, 0, __ATOMIC_ACQ_REL)) {
+        uint64_t one = 1;
+        if (write(w->wake_fd, &one, sizeof(one)) < 0) {
+            perror("Error al despertar al trabajador");
+        }
+    }
+}
+
+// Función para despertar a un trabajador dormido que pueda robar trabajo
+static void wake_thief(worker_t *self) {
+    for (int i = 1; i < n_workers; i++) {
+        worker_t *w = &workers[(self->id + i) % n_workers];
+        if (__atomic_load_n(&w->sleeping, __ATOMIC_RELAXED)) {
+            wake(w);
+            return;
+        }
+    }
+}
+
+// Función para entregar una conexión recién programada a algún trabajador
+static void schedule(conn_t *conn) {
+    unsigned start = next_worker++;
+
+    while (1) {
+        for (int i = 0; i < n_workers; i++) {
+            worker_t *w = &workers[(start + (unsigned)i) % (unsigned)n_workers];
+            if (mpsc_push(&w->inbox, conn) == 0) {
+                wake(w);
+                return;
+            }
+        }
+        // Todas las colas llenas: el pool está saturado
+        __atomic_add_fetch(&workers[start % (unsigned)n_workers].stalls, 1, __ATOMIC_RELAXED);
+        sched_yield();
+    }
+}
+
+// Función para devolver una solicitud a la reserva de la que salió
+static void free_req(dispatch_req_t *req) {
+    if (req->pooled) {
+        slab_free(req);
+    } else {
+        free(req);
+    }
+}
+
+// Función para analizar y atender un documento midiendo cada etapa
+static void handle_req(worker_t *w, conn_t *conn, dispatch_req_t *req) {
+    if (conn->task_failed) {
+        free_req(req);
+        return;
+    }
+
+    uint64_t start = dispatch_clock_ns();
+    uint64_t wait = start - req->queued_at;
+    void *request = on_dispatch_parse(conn, req->data, req->len);
+    uint64_t parsed = dispatch_clock_ns();
+
+    if (request == NULL) {
+        // Documento inválido: cerrar como lo haría el reactor y descartar lo que siga
+        conn->task_failed = 1;
+        conn_abort(conn);
+    } else {
+        on_dispatch_request(conn, request);
+    }
+
+    __atomic_store_n(&w->handled, w->handled + 1, __ATOMIC_RELAXED);
+    stat_add(&w->wait_ns, wait);
+    stat_add(&w->parse_ns, parsed - start);
+    stat_add(&w->service_ns, dispatch_clock_ns() - parsed);
+    if (wait > __atomic_load_n(&w->wait_max_ns, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&w->wait_max_ns, wait, __ATOMIC_RELAXED);
+    }
+    free_req(req);
+}
+
+// Función para atender turnos de una conexión; solo un trabajador la tiene a la vez
+static int run_conn(worker_t *w, conn_t *conn) {
+    int n = 0;
+
+    while (1) {
+        for (int slice = 0; slice < DISPATCH_SLICE; slice++) {
+            pthread_mutex_lock(&conn->task_mutex);
+            dispatch_req_t *req = conn->task_head;
+            int closing = 0;
+            if (req != NULL) {
+                conn->task_head = req->next;
+                if (conn->task_head == NULL) {
+                    conn->task_tail = NULL;
+                }
+            } else if (conn->task_closing) {
+                conn->task_closing = 0;
+                closing = 1;
+            } else {
+                // Sin pendientes: la conexión deja el pool hasta su próximo documento
+                conn->task_scheduled = 0;
+                pthread_mutex_unlock(&conn->task_mutex);
+                conn_put(conn);
+                return n;
+            }
+            pthread_mutex_unlock(&conn->task_mutex);
+
+            if (closing) {
+                on_dispatch_close(conn);
+            } else {
+                handle_req(w, conn, req);
+            }
+            n++;
+        }
+
+        // Turno agotado: al final de la propia cola para no acaparar al trabajador;
+        // si está llena, la conexión sigue con otro turno
+        if (mpsc_push(&w->inbox, conn) == 0) {
+            return n;
+        }
+    }
+}
+
+// Función para robar una conexión lista a otro trabajador
+static conn_t *steal(worker_t *self, unsigned *seed) {
+    unsigned start = (unsigned)rand_r(seed);
+
+    for (int i = 0; i < n_workers; i++) {
+        worker_t *victim = &workers[(start + (unsigned)i) % (unsigned)n_workers];
+        if (victim == self) {
+            continue;
+        }
+        conn_t *conn = deque_steal(&victim->deque);
+        if (conn != NULL) {
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+// Función para saber si queda trabajo visible para este trabajador
+static int has_work(worker_t *self) {
+    if (mpsc_depth(&self->inbox) > 0) {
+        return 1;
+    }
+    for (int i = 0; i < n_workers; i++) {
+        if (deque_size(&workers[i].deque) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Función del bucle de un trabajador: deque propio, cola de entrada y, si no hay nada, robo
+static void *worker_loop(void *arg) {
+    worker_t *w = arg;
+    unsigned seed = (unsigned)w->id * 2654435761u + 1;
+    int pending = 0;    // Solicitudes atendidas desde el último vaciado
+    long long wait_ns = -1;     // Vencimiento de la salida diferida más próxima (-1: ninguna)
+
+    while (1) {
+        conn_t *conn = deque_take(&w->deque);
+
+        if (conn == NULL) {
+            // Pasar lo recibido al deque, donde los trabajadores ociosos pueden robarlo
+            int moved = 0;
+            conn_t *c;
+            while (deque_size(&w->deque) < DISPATCH_QUEUE_SIZE && (c = mpsc_pop(&w->inbox)) != NULL) {
+                deque_push(&w->deque, c);
+                moved++;
+            }
+            if (moved > 1) {
+                wake_thief(w);
+            }
+
+            size_t depth = deque_size(&w->deque) + mpsc_depth(&w->inbox);
+            if (depth > __atomic_load_n(&w->depth_max, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&w->depth_max, depth, __ATOMIC_RELAXED);
+            }
+            conn = deque_take(&w->deque);
+        }
+
+        if (conn == NULL && (conn = steal(w, &seed)) != NULL) {
+            __atomic_store_n(&w->steals, w->steals + 1, __ATOMIC_RELAXED);
+        }
+
+        if (conn != NULL) {
+            pending += run_conn(w, conn);
+            if (pending < DISPATCH_BATCH) {
+                continue;
+            }
+        }
+
+        if (pending > 0) {
+            // Las respuestas del lote salen juntas, como en los reactores
+            uint64_t start = dispatch_clock_ns();
+            wait_ns = conn_flush_window();
+            stat_add(&w->flush_ns, dispatch_clock_ns() - start);
+            pending = 0;
+            continue;
+        }
+
+        // Sin trabajo: anunciar que se duerme y comprobar otra vez antes de bloquearse
+        __atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (has_work(w)) {
+            __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        // Con salida diferida por la ventana de agrupación se duerme solo hasta que venza
+        if (wait_ns >= 0) {
+            struct pollfd pfd = {w->wake_fd, POLLIN, 0};
+            struct timespec timeout = {(time_t)(wait_ns / 1000000000), (long)(wait_ns % 1000000000)};
+            if (ppoll(&pfd, 1, &timeout, NULL) <= 0) {
+                // Nadie lo despertó: un aviso tardío solo adelantaría la próxima vuelta
+                __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+                wait_ns = conn_flush_window();
+                continue;
+            }
+        }
+
+        uint64_t value;
+        if (read(w->wake_fd, &value, sizeof(value)) < 0 && errno != EINTR) {
+            perror("Error al leer eventfd del trabajador");
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+int dispatch_init(int count) {
+    if (count <= 0) {
+        return 0;   // Sin pool: los hilos de E/S atienden en línea
+    }
+
+    workers = calloc((size_t)count, sizeof(worker_t));
+    if (workers == NULL) {
+        perror("Error al reservar trabajadores");
+        return -1;
+    }
+    n_workers = count;
+
+    for (size_t i = 0; i < N_REQ_CLASSES; i++) {
+        req_caches[i] = slab_cache_create(req_classes[i].name, req_classes[i].size);
+        if (req_caches[i] == NULL) {
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        worker_t *w = &workers[i];
+        w->id = i;
+        if (mpsc_init(&w->inbox, DISPATCH_QUEUE_SIZE) < 0 ||
+            deque_init(&w->deque, DISPATCH_QUEUE_SIZE) < 0) {
+            perror("Error al crear las colas del trabajador");
+            return -1;
+        }
+        if ((w->wake_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+            perror("Error en eventfd");
+            return -1;
+        }
+    }
+
+    // Lanzar los hilos cuando todas las colas existen: cualquiera puede robar a cualquiera
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]) != 0) {
+            perror("Error al crear hilo trabajador");
+            return -1;
+        }
+        pthread_detach(workers[i].thread);
+    }
+    return 0;
+}
+
+int dispatch_count(void) {
+    return n_workers;
+}
+
+int dispatch_submit(conn_t *conn, const char *data, size_t len) {
+    dispatch_req_t *req = NULL;
+    int pooled = 0;
+
+    for (size_t i = 0; i < N_REQ_CLASSES; i++) {
+        if (sizeof(dispatch_req_t) + len <= req_classes[i].size) {
+            req = slab_alloc(req_caches[i]);
+            pooled = req != NULL;
+            break;
+        }
+    }
+    if (req == NULL && (req = malloc(sizeof(dispatch_req_t) + len)) == NULL) {
+        perror("Error al encolar solicitud");
+        return -1;
+    }
+    req->pooled = pooled;
+    memcpy(req->data, data, len);
+    req->len = len;
+    req->next = NULL;
+    req->queued_at = dispatch_clock_ns();
+
+    pthread_mutex_lock(&conn->task_mutex);
+    if (conn->task_tail != NULL) {
+        conn->task_tail->next = req;
+    } else {
+        conn->task_head = req;
+    }
+    conn->task_tail = req;
+    int start = !conn->task_scheduled;
+    conn->task_scheduled = 1;
+    pthread_mutex_unlock(&conn->task_mutex);
+
+    // La conexión entra al pool con una referencia que suelta el trabajador al vaciarla
+    if (start) {
+        conn_get(conn);
+        schedule(conn);
+    }
+    return 0;
+}
+
+void dispatch_close(conn_t *conn) {
+    pthread_mutex_lock(&conn->task_mutex);
+    conn->task_closing = 1;
+    int start = !conn->task_scheduled;
+    conn->task_scheduled = 1;
+    pthread_mutex_unlock(&conn->task_mutex);
+
+    if (start) {
+        conn_get(conn);
+        schedule(conn);
+    }
+}
+
+void dispatch_report(void) {
+    for (int i = 0; i < n_workers; i++) {
+        worker_t *w = &workers[i];
+
+        unsigned long handled = __atomic_load_n(&w->handled, __ATOMIC_RELAXED);
+        unsigned long steals = __atomic_load_n(&w->steals, __ATOMIC_RELAXED);
+        uint64_t wait = __atomic_load_n(&w->wait_ns, __ATOMIC_RELAXED);
+        uint64_t parse = __atomic_load_n(&w->parse_ns, __ATOMIC_RELAXED);
+        uint64_t service = __atomic_load_n(&w->service_ns, __ATOMIC_RELAXED);
+        uint64_t flush = __atomic_load_n(&w->flush_ns, __ATOMIC_RELAXED);
+        unsigned long stalls = __atomic_load_n(&w->stalls, __ATOMIC_RELAXED);
+        uint64_t wait_max = __atomic_exchange_n(&w->wait_max_ns, 0, __ATOMIC_RELAXED);
+        size_t depth_max = __atomic_exchange_n(&w->depth_max, 0, __ATOMIC_RELAXED);
+
+        unsigned long count = handled - w->prev_handled;
+        if (count == 0) {
+            continue;
+        }
+
+        printf("Trabajador %d: %lu solicitudes, cola %zu (máx. %zu, llena %lu veces), %lu robos | "
+               "espera %.1f us (máx. %.1f), análisis %.1f us, despacho %.1f us, escritura %.1f us\n",
+               w->id, count, mpsc_depth(&w->inbox) + deque_size(&w->deque), depth_max,
+               stalls - w->prev_stalls, steals - w->prev_steals,
+               (double)(wait - w->prev_wait_ns) / count / 1000.0, (double)wait_max / 1000.0,
+               (double)(parse - w->prev_parse_ns) / count / 1000.0,
+               (double)(service - w->prev_service_ns) / count / 1000.0,
+               (double)(flush - w->prev_flush_ns) / count / 1000.0);
+
+        w->prev_handled = handled;
+        w->prev_steals = steals;
+        w->prev_wait_ns = wait;
+        w->prev_parse_ns = parse;
+        w->prev_service_ns = service;
+        w->prev_flush_ns = flush;
+        w->prev_stalls = stalls;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "conn.h"
+
+#define DISPATCH_QUEUE_SIZE 65536   // Conexiones en la cola de entrada y en el deque de cada trabajador
+#define DISPATCH_SLICE 64           // Solicitudes de una conexión antes de ceder el turno
+#define DISPATCH_BATCH 256          // Solicitudes atendidas antes de vaciar las colas de salida
+
+// Documento ya enmarcado por el reactor, pendiente de analizar
+typedef struct dispatch_req {
+    struct dispatch_req *next;
+    uint64_t queued_at;
+    int pooled;         // Salió de una reserva de bloques y no de malloc
+    size_t len;
+    char data[];
+} dispatch_req_t;
+
+// Lanza el pool de trabajadores, cada uno con su cola de entrada y su deque robable
+int dispatch_init(int workers);
+
+int dispatch_count(void);
+
+// Reloj monótono en nanosegundos para medir las etapas
+uint64_t dispatch_clock_ns(void);
+
+// Copia un documento a las pendientes de la conexión y la programa si estaba parada;
+// retorna -1 sin memoria
+int dispatch_submit(conn_t *conn, const char *data, size_t len);
+
+// Anota el cierre de la conexión para atenderlo detrás de sus solicitudes pendientes
+void dispatch_close(conn_t *conn);
+
+// Imprime profundidad de cola, robos y latencia por etapa desde el informe anterior
+void dispatch_report(void);
+
+// Callbacks implementados por el servidor; nunca hay dos trabajadores con la misma conexión
+void *on_dispatch_parse(conn_t *conn, const char *data, size_t len);   // NULL: documento inválido
+void on_dispatch_request(conn_t *conn, void *request);
+void on_dispatch_close(conn_t *conn);
+
+#endif
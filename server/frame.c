@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+#include "slab.h"
+
+// Clases de tamaño (trama completa) servidas por el asignador de bloques: las
+// respuestas y mensajes habituales no pasan por malloc. Las mayores sí
+static const struct {
+    const char *name;
+    size_t size;
+} frame_classes[] = {
+    {"tramas256", 256},
+    {"tramas1k", 1024},
+    {"tramas4k", 4096},
+};
+
+#define N_CLASSES (sizeof(frame_classes) / sizeof(frame_classes[0]))
+
+static slab_cache_t *frame_caches[N_CLASSES];
+
+int frame_init(void) {
+    for (size_t i = 0; i < N_CLASSES; i++) {
+        frame_caches[i] = slab_cache_create(frame_classes[i].name, frame_classes[i].size);
+        if (frame_caches[i] == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Función para crear una trama compartible a partir de un mensaje serializado
+frame_t *frame_create(const char *data, size_t len) {
+    frame_t *frame = NULL;
+    int pooled = 0;
+
+    for (size_t i = 0; i < N_CLASSES && frame_caches[i] != NULL; i++) {
+        if (sizeof(frame_t) + len <= frame_classes[i].size) {
+            frame = slab_alloc(frame_caches[i]);
+            pooled = frame != NULL;
+            break;
+        }
+    }
+    if (frame == NULL) {
+        frame = malloc(sizeof(frame_t) + len);
+        if (frame == NULL) {
+            return NULL;
+        }
+    }
+    frame->refs = 1;
+    frame->droppable = 0;
+    frame->pooled = pooled;
+    frame->len = len;
+    frame->file = NULL;
+    memcpy(frame->data, data, len);
+    return frame;
+}
+
+// Función para crear una trama sobre un tramo de archivo mapeado; la descripción
+// del tramo ocupa el lugar de los datos
+frame_t *frame_create_file(const char *base, size_t len, int fd, long long off,
+                           void (*release)(void *owner), void *owner) {
+    frame_t *frame = malloc(sizeof(frame_t) + sizeof(frame_file_t));
+    if (frame == NULL) {
+        return NULL;
+    }
+    frame->refs = 1;
+    frame->droppable = 0;
+    frame->pooled = 0;
+    frame->len = len;
+    frame->file = (frame_file_t *)(void *)frame->data;
+    frame->file->base = base;
+    frame->file->fd = fd;
+    frame->file->off = off;
+    frame->file->release = release;
+    frame->file->owner = owner;
+    return frame;
+}
+
+void frame_get(frame_t *frame) {
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Función para soltar una referencia; la libera el último escritor que la termine
+void frame_put(frame_t *frame) {
+    if (__atomic_sub_fetch(&frame->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (frame->file != NULL) {
+            frame->file->release(frame->file->owner);
+        }
+        if (frame->pooled) {
+            slab_free(frame);
+        } else {
+            free(frame);
+        }
+    }
+}
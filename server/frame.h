@@ -0,0 +1,47 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+
+// Tramo de un archivo ya mapeado en memoria (el historial del registro de
+// mensajes): se envía sin copiarlo, con sendfile() o desde el mapa
+typedef struct frame_file {
+    const char *base;               // Los bytes del tramo dentro del mapa
+    int fd;                         // El mismo tramo para sendfile()
+    long long off;
+    void (*release)(void *owner);   // Se llama con la última referencia a la trama
+    void *owner;
+} frame_file_t;
+
+// Trama saliente inmutable compartida por las colas de todos sus destinatarios
+typedef struct frame {
+    int refs;
+    int droppable;      // BROADCAST: se puede descartar de la cola de un cliente lento
+    int pooled;         // Salió de una reserva de bloques y no de malloc
+    size_t len;
+    frame_file_t *file; // NULL: los bytes están en data
+    char data[];
+} frame_t;
+
+// Prepara las reservas de tramas pequeñas; sin ellas todas las tramas usan malloc
+int frame_init(void);
+
+// Crea una trama con una copia de los bytes y una referencia para quien la crea
+frame_t *frame_create(const char *data, size_t len);
+
+// Crea una trama que apunta a len bytes de un archivo mapeado, sin copiarlos; el
+// dueño del mapa se suelta con release(owner) al liberar la trama
+frame_t *frame_create_file(const char *base, size_t len, int fd, long long off,
+                           void (*release)(void *owner), void *owner);
+
+// Bytes de la trama, estén en ella o en un archivo mapeado
+static inline const char *frame_bytes(const frame_t *frame) {
+    return frame->file != NULL ? frame->file->base : frame->data;
+}
+
+void frame_get(frame_t *frame);
+
+// Suelta una referencia; la última libera la trama
+void frame_put(frame_t *frame);
+
+#endif
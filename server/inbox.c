@@ -0,0 +1,760 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "inbox.h"
+#include "mpsc.h"
+#include "user_index.h"
+#include "users.h"
+
+#define PATH_SIZE 4096
+#define BOX_SUFFIX ".jsonl"
+#define REWRITE_SUFFIX ".jsonl.tmp"
+#define KNOWN_FILE "conocidos"
+
+// Operación para el hilo del buzón: guardar un DM o vaciar un buzón
+typedef struct {
+    int drain;
+    uint64_t queued_at;
+    frame_t *frame;             // DM por guardar (NULL al vaciar)
+    conn_t *conn;               // DM desviado durante el vaciado de esta conexión (con referencia)
+    char username[USERS_NAME_SIZE];
+} inbox_op_t;
+
+// Buzón de un usuario con DM pendientes (solo el hilo del buzón). El archivo es
+// siempre la fuente: el vaciado lo lee por tramos y los DM que llegan mientras
+// tanto se le agregan detrás
+typedef struct {
+    char username[USERS_NAME_SIZE];
+    int slot;                   // Posición en boxes
+    int count;                  // DM pendientes (sin contar los ya entregados del vaciado)
+    size_t bytes;               // Bytes en disco
+    int fd;                     // Abierto para agregar en la tanda actual; -1 si no
+    time_t last_store;          // Último DM guardado (caducidad)
+
+    // Vaciado en curso
+    int draining;
+    int rfd;                    // Abierto para leer; -1 si no
+    size_t off;                 // Bytes del archivo ya entregados
+    int sent;
+    uint64_t since;             // Instante del REGISTRO que lo pidió
+} box_t;
+
+static char inbox_dir[PATH_SIZE - 128];
+static inbox_config_t config;
+static mpsc_t ops;
+static char *chunk;             // Tramo leído del archivo durante un vaciado
+
+// Buzones con DM pendientes, compactados como las porciones del directorio
+static box_t **boxes;
+static int box_count;
+static int box_cap;
+static user_index_t box_index;
+static long long box_bytes;     // Bytes de todos los buzones
+
+// Buzones con escrituras sin sincronizar en la tanda actual
+static box_t **dirty;
+static int dirty_count;
+
+// Nombres que alguna vez se registraron: los únicos que reciben buzón
+static user_index_t known_index;
+static int known_fd = -1;
+static int known_dirty;
+
+// Estadísticas acumuladas (escritas solo por el hilo del buzón, salvo dropped y unknown)
+static unsigned long pending_total;     // DM pendientes en todos los buzones
+static unsigned long stored_total;
+static unsigned long rejected_total;    // Buzón lleno, techo global, DM demasiado grande o error de disco
+static unsigned long unknown_total;     // Destinatario que nunca se registró
+static unsigned long dropped_total;     // Cola del hilo llena
+static unsigned long expired_total;     // DM de buzones caducados
+static unsigned long delivered_total;   // DM entregados por el buzón
+static unsigned long drains_total;
+static uint64_t drain_ns_total;
+static uint64_t drain_max_ns;           // Se reinicia en cada informe
+
+// Totales del informe anterior (solo el hilo que informa)
+static unsigned long reported[8];
+static uint64_t reported_drain_ns;
+
+static const char newline[] = "\n";
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Función para pasar un nombre a hexadecimal: así cualquier nombre de usuario es
+// un nombre de archivo válido y una línea sin ambigüedad
+static void hex_name(const char *username, char *name) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)username; *p != '\0'; p++) {
+        name[n++] = hex[*p >> 4];
+        name[n++] = hex[*p & 0x0f];
+    }
+    name[n] = '\0';
+}
+
+// Función para armar la ruta del buzón de un usuario
+static void box_path(const char *username, const char *suffix, char *path) {
+    char name[2 * USERS_NAME_SIZE + 1];
+    hex_name(username, name);
+    snprintf(path, PATH_SIZE, "%s/%s%s", inbox_dir, name, suffix);
+}
+
+// Función para recuperar un nombre de usuario de su forma hexadecimal
+static int parse_hex_name(const char *file, size_t len, char *username, size_t size) {
+    if (len == 0 || len % 2 != 0 || len / 2 >= size) {
+        return -1;
+    }
+    for (size_t i = 0; i < len; i += 2) {
+        char byte[3] = {file[i], file[i + 1], '\0'};
+        char *end;
+        unsigned long v = strtoul(byte, &end, 16);
+        if (*end != '\0' || v == 0) {
+            return -1;
+        }
+        username[i / 2] = (char)v;
+    }
+    username[len / 2] = '\0';
+    return 0;
+}
+
+static int is_known(const char *username) {
+    return user_index_find(&known_index, username) >= 0;
+}
+
+// Función para recordar un nombre registrado; con persist se agrega al archivo
+static void add_known(const char *username, int persist) {
+    if (is_known(username)) {
+        return;
+    }
+    char *name = strdup(username);
+    if (name == NULL || user_index_insert(&known_index, name, 0) < 0) {
+        free(name);
+        return;
+    }
+    if (persist && known_fd >= 0) {
+        char line[2 * USERS_NAME_SIZE + 2];
+        hex_name(username, line);
+        size_t len = strlen(line);
+        line[len++] = '\n';
+        if (write(known_fd, line, len) != (ssize_t)len) {
+            perror("Error al guardar un nombre conocido");
+        }
+        known_dirty = 1;
+    }
+}
+
+static box_t *find_box(const char *username) {
+    int i = user_index_find(&box_index, username);
+    return i >= 0 ? boxes[i] : NULL;
+}
+
+// Función para crear el buzón vacío de un usuario
+static box_t *add_box(const char *username) {
+    if (box_count == box_cap) {
+        int cap = box_cap > 0 ? box_cap * 2 : 64;
+        box_t **tmp = realloc(boxes, (size_t)cap * sizeof(box_t *));
+        if (tmp == NULL) {
+            return NULL;
+        }
+        boxes = tmp;
+        box_cap = cap;
+    }
+
+    box_t *box = calloc(1, sizeof(box_t));
+    if (box == NULL) {
+        return NULL;
+    }
+    snprintf(box->username, sizeof(box->username), "%s", username);
+    box->fd = -1;
+    box->rfd = -1;
+    box->last_store = time(NULL);
+    box->slot = box_count;
+    if (user_index_insert(&box_index, box->username, box->slot) < 0) {
+        free(box);
+        return NULL;
+    }
+    boxes[box_count++] = box;
+    return box;
+}
+
+// Función para quitar un buzón junto con su archivo
+static void remove_box(box_t *box) {
+    char path[PATH_SIZE];
+    box_path(box->username, BOX_SUFFIX, path);
+    unlink(path);
+
+    int i = box->slot;
+    user_index_remove(&box_index, box->username);
+
+    // Mover el último buzón a esta posición
+    if (i < box_count - 1) {
+        box_t *last = boxes[box_count - 1];
+        boxes[i] = last;
+        last->slot = i;
+        user_index_move(&box_index, last->username, i);
+    }
+    box_count--;
+
+    box_bytes -= (long long)box->bytes;
+    pending_total -= (unsigned long)box->count;
+    if (box->fd >= 0) {
+        close(box->fd);
+    }
+    if (box->rfd >= 0) {
+        close(box->rfd);
+    }
+    free(box);
+}
+
+// Función para escribir un DM y su fin de línea aunque writev() los tome por partes
+static int write_doc(int fd, const char *data, size_t len) {
+    struct iovec iov[2] = {{(void *)data, len}, {(void *)newline, 1}};
+    struct iovec *v = iov;
+    int n_iov = 2;
+    while (n_iov > 0) {
+        ssize_t n = writev(fd, v, n_iov);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (n_iov > 0 && (size_t)n >= v->iov_len) {
+            n -= (ssize_t)v->iov_len;
+            v++;
+            n_iov--;
+        }
+        if (n_iov > 0) {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// Función para agregar un DM al archivo de un buzón; se sincroniza al final de la tanda
+static void append_message(box_t *box, frame_t *frame) {
+    if (box->fd < 0) {
+        char path[PATH_SIZE];
+        box_path(box->username, BOX_SUFFIX, path);
+        box->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (box->fd < 0) {
+            perror("Error al abrir un buzón");
+            rejected_total++;
+            if (box->count == 0 && !box->draining) {
+                remove_box(box);
+            }
+            return;
+        }
+        dirty[dirty_count++] = box;
+    }
+
+    if (write_doc(box->fd, frame->data, frame->len) < 0) {
+        // Sin documentos a medias: el DM se descarta
+        perror("Error al escribir en un buzón");
+        if (ftruncate(box->fd, (off_t)box->bytes) < 0) {
+            perror("Error al truncar un buzón");
+        }
+        rejected_total++;
+        return;
+    }
+    box->count++;
+    box->bytes += frame->len + 1;
+    box->last_store = time(NULL);
+    box_bytes += (long long)frame->len + 1;
+    pending_total++;
+    stored_total++;
+}
+
+// Función para guardar un DM en el buzón de su destinatario. Mientras el vaciado
+// del destinatario no termina, el DM va detrás de los pendientes aunque esté
+// conectado; si ya terminó, se le entrega directo
+static void store_message(const char *username, frame_t *frame, conn_t *diverted) {
+    box_t *box = find_box(username);
+    int behind = diverted != NULL;
+
+    if (!behind) {
+        conn_t *conn = on_inbox_find(username);
+        if (conn != NULL) {
+            behind = __atomic_load_n(&conn->inbox_pending, __ATOMIC_ACQUIRE);
+            if (!behind) {
+                // El destinatario se registró después de que se encoló
+                conn_send_frame(conn, frame);
+                delivered_total++;
+            }
+            conn_put(conn);
+            if (!behind) {
+                return;
+            }
+        } else if (!is_known(username)) {
+            __atomic_add_fetch(&unknown_total, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    if (frame->len + 1 > config.chunk_bytes || box_bytes + (long long)frame->len + 1 > config.max_bytes ||
+        (box == NULL && box_count >= config.max_boxes) ||
+        (box != NULL && (box->count >= config.max_messages || box->bytes + frame->len + 1 > INBOX_MAX_BYTES))) {
+        rejected_total++;
+        return;
+    }
+    if (box == NULL && (box = add_box(username)) == NULL) {
+        rejected_total++;
+        return;
+    }
+    append_message(box, frame);
+}
+
+// Función para empezar el vaciado del buzón de un usuario recién registrado. Sin
+// buzón se crea uno vacío: así el vaciado termina por el mismo camino y los DM
+// desviados mientras tanto no se adelantan
+static void start_drain(const char *username, uint64_t since) {
+    add_known(username, 1);
+
+    box_t *box = find_box(username);
+    if (box == NULL && (box = add_box(username)) == NULL) {
+        return;
+    }
+    if (box->draining) {
+        return;
+    }
+    box->draining = 1;
+    box->off = 0;
+    box->sent = 0;
+    box->since = since;
+}
+
+// Función para devolver al disco lo que falta del vaciado de un usuario que se
+// desconectó a mitad: se copia aparte y reemplaza al archivo
+static void save_rest(box_t *box) {
+    box->draining = 0;
+    if (box->off == box->bytes) {
+        remove_box(box);
+        return;
+    }
+    if (box->off > 0) {
+        char tmp[PATH_SIZE];
+        char path[PATH_SIZE];
+        box_path(box->username, REWRITE_SUFFIX, tmp);
+        box_path(box->username, BOX_SUFFIX, path);
+
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        size_t pos = box->off;
+        while (fd >= 0 && pos < box->bytes) {
+            size_t want = box->bytes - pos < config.chunk_bytes ? box->bytes - pos : config.chunk_bytes;
+            ssize_t n = pread(box->rfd, chunk, want, (off_t)pos);
+            if (n <= 0 || write(fd, chunk, (size_t)n) != n) {
+                break;
+            }
+            pos += (size_t)n;
+        }
+        if (pos != box->bytes || fdatasync(fd) < 0 || rename(tmp, path) < 0) {
+            // El archivo original sigue completo: se repetirán los ya entregados
+            perror("Error al reescribir un buzón");
+            unlink(tmp);
+            box->count += box->sent;
+            pending_total += (unsigned long)box->sent;
+        } else {
+            box_bytes -= (long long)box->off;
+            box->bytes -= box->off;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    if (box->rfd >= 0) {
+        close(box->rfd);
+        box->rfd = -1;
+    }
+    box->off = 0;
+    box->sent = 0;
+}
+
+// Función para avanzar un vaciado: tramas con tantos DM completos como quepan en
+// la cola de salida del usuario sin acercarla al límite de los clientes lentos,
+// leídas del archivo ya sincronizado. Lo que no cabe sigue en la próxima tanda
+static void advance_drain(box_t *box) {
+    conn_t *conn = on_inbox_find(box->username);
+    if (conn == NULL) {
+        save_rest(box);
+        return;
+    }
+
+    if (box->rfd < 0 && box->off < box->bytes) {
+        char path[PATH_SIZE];
+        box_path(box->username, BOX_SUFFIX, path);
+        box->rfd = open(path, O_RDONLY | O_CLOEXEC);
+        if (box->rfd < 0) {
+            perror("Error al leer un buzón");
+            conn_put(conn);
+            return;
+        }
+    }
+
+    while (box->off < box->bytes) {
+        size_t room = conn_out_room(conn);
+        size_t limit = room < config.chunk_bytes ? room : config.chunk_bytes;
+        size_t avail = box->bytes - box->off;
+        if (limit > avail) {
+            limit = avail;
+        }
+        ssize_t got = limit > 0 ? pread(box->rfd, chunk, limit, (off_t)box->off) : 0;
+        if (got <= 0) {
+            if (got < 0) {
+                perror("Error al leer un buzón");
+            }
+            break;
+        }
+
+        // Solo documentos completos
+        size_t n = 0;
+        int docs = 0;
+        for (const char *p = chunk; (p = memchr(p, '\n', (size_t)got - (size_t)(p - chunk))) != NULL; p++) {
+            n = (size_t)(p - chunk) + 1;
+            docs++;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        frame_t *frame = frame_create(chunk, n);
+        if (frame == NULL) {
+            break;
+        }
+        int rc = conn_send_frame(conn, frame);
+        frame_put(frame);
+        if (rc < 0) {
+            break;
+        }
+        box->off += n;
+        box->sent += docs;
+        box->count -= docs;
+        pending_total -= (unsigned long)docs;
+        delivered_total += (unsigned long)docs;
+    }
+
+    if (box->off < box->bytes || !on_inbox_drained(box->username, conn)) {
+        conn_put(conn);
+        return;
+    }
+    conn_put(conn);
+
+    if (box->sent > 0) {
+        uint64_t elapsed = clock_ns() - box->since;
+        printf("Buzón de %s vaciado: %d DM en %.1f ms\n", box->username, box->sent, (double)elapsed / 1e6);
+        drains_total++;
+        drain_ns_total += elapsed;
+        if (elapsed > drain_max_ns) {
+            drain_max_ns = elapsed;
+        }
+    }
+    remove_box(box);
+}
+
+// Función para borrar los buzones que llevan más de ttl_secs sin DM nuevos
+static void expire_boxes(void) {
+    time_t now = time(NULL);
+    for (int i = box_count - 1; i >= 0; i--) {
+        box_t *box = boxes[i];
+        if (!box->draining && now - box->last_store > (time_t)config.ttl_secs) {
+            printf("Buzón de %s caducado: %d DM sin entregar\n", box->username, box->count);
+            expired_total += (unsigned long)box->count;
+            remove_box(box);
+        }
+    }
+}
+
+// Hilo del buzón: cada tanda atiende las operaciones en orden, sincroniza una sola
+// vez los buzones escritos y avanza los vaciados con lo ya sincronizado
+static void *inbox_loop(void *arg) {
+    (void)arg;
+    uint64_t next_sweep = 0;        // La primera tanda ya borra los caducados durante el apagado
+
+    while (1) {
+        usleep(INBOX_TICK_MS * 1000);
+
+        // Un solo fsync por buzón y por tanda; la tanda se corta si se llena la lista
+        inbox_op_t *op;
+        while (dirty_count < INBOX_QUEUE_SIZE && (op = mpsc_pop(&ops)) != NULL) {
+            if (op->drain) {
+                start_drain(op->username, op->queued_at);
+            } else {
+                store_message(op->username, op->frame, op->conn);
+                frame_put(op->frame);
+            }
+            if (op->conn != NULL) {
+                __atomic_sub_fetch(&op->conn->inbox_queued, 1, __ATOMIC_RELEASE);
+                conn_put(op->conn);
+            }
+            free(op);
+        }
+
+        for (int i = 0; i < dirty_count; i++) {
+            box_t *box = dirty[i];
+            if (fdatasync(box->fd) < 0) {
+                perror("Error al sincronizar un buzón");
+            }
+            close(box->fd);
+            box->fd = -1;
+        }
+        dirty_count = 0;
+        if (known_dirty) {
+            if (fdatasync(known_fd) < 0) {
+                perror("Error al sincronizar los nombres conocidos");
+            }
+            known_dirty = 0;
+        }
+
+        // Al quitar un buzón se mueve el último a su lugar: se recorre desde el final
+        for (int i = box_count - 1; i >= 0; i--) {
+            if (i < box_count && boxes[i]->draining) {
+                advance_drain(boxes[i]);
+            }
+        }
+        conn_flush_pending();
+
+        if (clock_ns() >= next_sweep) {
+            expire_boxes();
+            next_sweep = clock_ns() + INBOX_SWEEP_SECS * 1000000000ull;
+        }
+    }
+
+    return NULL;
+}
+
+// Función para cargar los nombres que alguna vez se registraron y dejar su archivo
+// abierto para agregar
+static int load_known(void) {
+    char path[PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%s", inbox_dir, KNOWN_FILE);
+    known_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (known_fd < 0) {
+        perror("Error al abrir los nombres conocidos");
+        return -1;
+    }
+
+    FILE *f = fdopen(dup(known_fd), "r");
+    if (f == NULL) {
+        perror("Error al leer los nombres conocidos");
+        return -1;
+    }
+    char line[2 * USERS_NAME_SIZE + 2];
+    char username[USERS_NAME_SIZE];
+    off_t keep = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n') {
+            break;      // Línea a medias de un corte
+        }
+        keep += (off_t)len;
+        if (parse_hex_name(line, len - 1, username, sizeof(username)) == 0) {
+            add_known(username, 0);
+        }
+    }
+    fclose(f);
+    if (ftruncate(known_fd, keep) < 0) {
+        perror("Error al recuperar los nombres conocidos");
+    }
+    return 0;
+}
+
+// Función para recuperar los buzones del directorio, sin el DM a medias que pudo
+// dejar un corte
+static int recover_boxes(void) {
+    DIR *dir = opendir(inbox_dir);
+    if (dir == NULL) {
+        perror("Error al abrir el directorio de buzones");
+        return -1;
+    }
+
+    struct dirent *entry;
+    char path[PATH_SIZE];
+    char username[USERS_NAME_SIZE];
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        size_t suffix = strlen(REWRITE_SUFFIX);
+        if (len > suffix && strcmp(entry->d_name + len - suffix, REWRITE_SUFFIX) == 0 &&
+            parse_hex_name(entry->d_name, len - suffix, username, sizeof(username)) == 0) {
+            box_path(username, REWRITE_SUFFIX, path);     // Reescritura interrumpida
+            unlink(path);
+            continue;
+        }
+        suffix = strlen(BOX_SUFFIX);
+        if (len <= suffix || strcmp(entry->d_name + len - suffix, BOX_SUFFIX) != 0 ||
+            parse_hex_name(entry->d_name, len - suffix, username, sizeof(username)) < 0) {
+            continue;
+        }
+
+        box_path(username, BOX_SUFFIX, path);
+        int fd = open(path, O_RDWR | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        size_t size = (size_t)st.st_size;
+        char *data = malloc(size > 0 ? size : 1);
+        ssize_t n = data != NULL ? read(fd, data, size) : -1;
+        if (n != (ssize_t)size) {
+            free(data);
+            close(fd);
+            continue;
+        }
+
+        // Contar los DM completos y cortar el último si quedó a medias
+        int count = 0;
+        size_t keep = 0;
+        for (const char *p = data; (p = memchr(p, '\n', size - (size_t)(p - data))) != NULL; p++) {
+            count++;
+            keep = (size_t)(p - data) + 1;
+        }
+        if (keep < size && ftruncate(fd, (off_t)keep) < 0) {
+            perror("Error al recuperar un buzón");
+        }
+        free(data);
+        close(fd);
+
+        box_t *box = count > 0 ? add_box(username) : NULL;
+        if (box == NULL) {
+            unlink(path);
+            continue;
+        }
+        box->count = count;
+        box->bytes = keep;
+        box->last_store = st.st_mtime;
+        box_bytes += (long long)keep;
+        pending_total += (unsigned long)count;
+        add_known(username, 0);
+    }
+    closedir(dir);
+    return 0;
+}
+
+int inbox_init(const char *dir, const inbox_config_t *cfg) {
+    pthread_t thread;
+
+    if (strlen(dir) >= sizeof(inbox_dir)) {
+        fprintf(stderr, "Ruta de los buzones demasiado larga: %s\n", dir);
+        return -1;
+    }
+    strcpy(inbox_dir, dir);
+    config = *cfg;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("Error al crear el directorio de buzones");
+        return -1;
+    }
+    dirty = malloc(INBOX_QUEUE_SIZE * sizeof(box_t *));
+    chunk = malloc(config.chunk_bytes);
+    if (dirty == NULL || chunk == NULL || user_index_init(&box_index, 64) < 0 ||
+        user_index_init(&known_index, 64) < 0 || mpsc_init(&ops, INBOX_QUEUE_SIZE) < 0 ||
+        load_known() < 0 || recover_boxes() < 0) {
+        return -1;
+    }
+
+    if (pthread_create(&thread, NULL, inbox_loop, NULL) != 0) {
+        perror("Error al crear el hilo de los buzones");
+        return -1;
+    }
+    pthread_detach(thread);
+
+    printf("Buzones en %s: %lu DM pendientes para %d usuarios (%zu nombres conocidos)\n",
+           dir, pending_total, box_count, known_index.count);
+    return 0;
+}
+
+// Función para encolar una operación al hilo del buzón
+static int push_op(const char *username, frame_t *frame, conn_t *conn) {
+    inbox_op_t *op = malloc(sizeof(inbox_op_t));
+    if (op == NULL) {
+        return -1;
+    }
+    op->drain = frame == NULL;
+    op->queued_at = clock_ns();
+    op->frame = frame;
+    op->conn = conn;
+    memcpy(op->username, username, strlen(username) + 1);
+
+    if (mpsc_push(&ops, op) < 0) {
+        free(op);
+        return -1;
+    }
+    return 0;
+}
+
+int inbox_store(const char *username, frame_t *frame, conn_t *conn) {
+    // Un nombre que no cabe no puede haberse registrado: nunca tiene buzón
+    if (strlen(username) >= USERS_NAME_SIZE) {
+        __atomic_add_fetch(&unknown_total, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    frame_get(frame);
+    if (conn != NULL) {
+        conn_get(conn);
+    }
+    if (push_op(username, frame, conn) < 0) {
+        frame_put(frame);
+        if (conn != NULL) {
+            conn_put(conn);
+        }
+        __atomic_add_fetch(&dropped_total, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+int inbox_drain(const char *username) {
+    if (push_op(username, NULL, NULL) < 0) {
+        fprintf(stderr, "Cola de buzones llena: el buzón de %s se vaciará en su próximo registro\n", username);
+        return -1;
+    }
+    return 0;
+}
+
+void inbox_report(void) {
+    unsigned long now[8] = {
+        __atomic_load_n(&pending_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&stored_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&rejected_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&unknown_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&dropped_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&expired_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&delivered_total, __ATOMIC_RELAXED),
+        __atomic_load_n(&drains_total, __ATOMIC_RELAXED)
+    };
+    uint64_t drain_ns = __atomic_load_n(&drain_ns_total, __ATOMIC_RELAXED);
+
+    if (memcmp(now, reported, sizeof(now)) == 0) {
+        return;     // Sin cambios desde el informe anterior
+    }
+
+    unsigned long drains = now[7] - reported[7];
+    uint64_t drain_max = __atomic_exchange_n(&drain_max_ns, 0, __ATOMIC_RELAXED);
+    printf("Buzones: %lu DM pendientes en %d buzones (%lld KiB), cola %zu | %lu guardados, %lu rechazados, "
+           "%lu a desconocidos, %lu descartados, %lu caducados | %lu entregados, %lu vaciados "
+           "(%.1f ms de media, máx. %.1f)\n",
+           now[0], __atomic_load_n(&box_count, __ATOMIC_RELAXED), __atomic_load_n(&box_bytes, __ATOMIC_RELAXED) / 1024,
+           mpsc_depth(&ops), now[1] - reported[1], now[2] - reported[2], now[3] - reported[3],
+           now[4] - reported[4], now[5] - reported[5], now[6] - reported[6], drains,
+           drains > 0 ? (double)(drain_ns - reported_drain_ns) / (double)drains / 1e6 : 0.0,
+           (double)drain_max / 1e6);
+
+    memcpy(reported, now, sizeof(now));
+    reported_drain_ns = drain_ns;
+}
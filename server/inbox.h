@@ -0,0 +1,57 @@
+#ifndef INBOX_H
+#define INBOX_H
+
+#include <stddef.h>
+#include "conn.h"
+#include "frame.h"
+
+#define INBOX_MAX_MESSAGES 1000             // DM pendientes por usuario (--inbox-max)
+#define INBOX_MAX_BYTES (4 * 1024 * 1024)   // Techo en bytes de cada buzón
+#define INBOX_MAX_BOXES 10000               // Buzones a la vez
+#define INBOX_TOTAL_BYTES (256LL * 1024 * 1024) // Techo de todos los buzones juntos (--inbox-total-bytes)
+#define INBOX_TTL_SECS (7 * 24 * 3600)      // Un buzón sin DM nuevos se borra al cumplirlo (--inbox-ttl)
+#define INBOX_SWEEP_SECS 60                 // Intervalo de la búsqueda de buzones caducados
+#define INBOX_CHUNK_BYTES (64 * 1024)       // Tope de cada trama del vaciado
+#define INBOX_TICK_MS 10                    // Intervalo del hilo del buzón: una tanda y un fsync
+#define INBOX_QUEUE_SIZE 65536              // Operaciones pendientes del hilo del buzón
+
+typedef struct {
+    int max_messages;           // Por buzón
+    size_t chunk_bytes;         // Tope de cada trama del vaciado
+    int max_boxes;
+    long long max_bytes;        // De todos los buzones juntos
+    unsigned ttl_secs;
+} inbox_config_t;
+
+// Buzón de DM para usuarios desconectados: un archivo por destinatario con los
+// documentos JSON, uno por línea. Solo tienen buzón los nombres que alguna vez se
+// registraron (se recuerdan en el archivo "conocidos"). Todo el trabajo lo hace
+// un hilo propio, así que guardar un DM o vaciar un buzón nunca frena al hilo que
+// los pide
+
+// Prepara el buzón en dir (lo crea si no existe), recupera los pendientes y lanza
+// su hilo
+int inbox_init(const char *dir, const inbox_config_t *config);
+
+// Toma una referencia a un DM (documento JSON) y lo encola para guardarlo; nunca
+// bloquea. Con conn, el DM se desvió porque el vaciado de esa conexión sigue en
+// curso y cuenta en conn->inbox_queued hasta guardarse. Retorna -1 si no se encoló
+int inbox_store(const char *username, frame_t *frame, conn_t *conn);
+
+// Programa el vaciado del buzón de un usuario recién registrado: sus DM salen en
+// pocas tramas grandes, a medida que su cola de salida tiene lugar. Retorna -1 si
+// la cola del hilo está llena
+int inbox_drain(const char *username);
+
+// Imprime DM pendientes, guardados, rechazados y vaciados desde el informe anterior
+void inbox_report(void);
+
+// Callbacks implementados por el servidor (hilo del buzón): conexión del usuario
+// registrado con ese nombre, con una referencia, o NULL si no está
+conn_t *on_inbox_find(const char *username);
+
+// El buzón del usuario de conn quedó vacío: da por terminado el vaciado si no hay
+// DM desviados en camino. Retorna 0 si aún los hay
+int on_inbox_drained(const char *username, conn_t *conn);
+
+#endif
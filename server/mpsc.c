@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include "mpsc.h"
+
+int mpsc_init(mpsc_t *queue, size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    queue->cells = malloc(cap * sizeof(mpsc_cell_t));
+    if (queue->cells == NULL) {
+        return -1;
+    }
+    // La celda i espera al productor de la posición i
+    for (size_t i = 0; i < cap; i++) {
+        queue->cells[i].seq = i;
+    }
+    queue->mask = cap - 1;
+    queue->tail = 0;
+    queue->head = 0;
+    return 0;
+}
+
+// Función para reservar una posición con CAS y publicar el dato en su celda
+int mpsc_push(mpsc_t *queue, void *data) {
+    size_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+    while (1) {
+        mpsc_cell_t *cell = &queue->cells[pos & queue->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        long dif = (long)(seq - pos);
+
+        if (dif == 0) {
+            // Celda libre para esta posición: intentar quedársela
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->data = data;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+            // El CAS fallido ya cargó la posición actual en pos
+        } else if (dif < 0) {
+            // El consumidor aún no liberó la celda de hace una vuelta: llena
+            return -1;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Función para tomar la siguiente celda publicada y devolverla a los productores
+void *mpsc_pop(mpsc_t *queue) {
+    size_t pos = queue->head;
+    mpsc_cell_t *cell = &queue->cells[pos & queue->mask];
+
+    if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+        return NULL;    // Vacía, o el productor de esta posición aún no terminó
+    }
+
+    void *data = cell->data;
+    __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&queue->head, pos + 1, __ATOMIC_RELAXED);
+    return data;
+}
+
+size_t mpsc_depth(const mpsc_t *queue) {
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    return tail > head ? tail - head : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stddef.h>
+
+// Celda del anillo: el número de secuencia indica de quién es el turno
+typedef struct {
+    size_t seq;
+    void *data;
+} mpsc_cell_t;
+
+// Cola acotada sin candados de varios productores y un consumidor
+typedef struct {
+    mpsc_cell_t *cells;
+    size_t mask;                                // Capacidad - 1 (potencia de dos)
+    size_t tail __attribute__((aligned(64)));   // Siguiente posición a reservar (productores)
+    size_t head __attribute__((aligned(64)));   // Siguiente posición a consumir (consumidor)
+} mpsc_t;
+
+// Prepara una cola con al menos la capacidad indicada
+int mpsc_init(mpsc_t *queue, size_t capacity);
+
+// Encola un puntero no nulo desde cualquier hilo; -1 si la cola está llena
+int mpsc_push(mpsc_t *queue, void *data);
+
+// Desencola desde el único hilo consumidor; NULL si está vacía
+void *mpsc_pop(mpsc_t *queue);
+
+// Elementos encolados (aproximado si hay productores activos)
+size_t mpsc_depth(const mpsc_t *queue);
+
+#endif
@@ -0,0 +1,684 @@
+#define _GNU_SOURCE   // memrchr()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "msglog.h"
+#include "mpsc.h"
+
+#define WRITE_BATCH 512         // Documentos por writev() (dos iovec cada uno)
+#define MAINTENANCE_SECS 1      // Sellado por tiempo, retención y compactación
+#define PATH_SIZE 4096
+#define SEGMENT_SUFFIX ".log"
+#define COMPACT_SUFFIX ".log.tmp"
+
+// Segmento: un archivo de solo agregado y su mapa de solo lectura. Lo comparten la
+// lista del registro y las tramas del historial que lo leen; el último en soltarlo
+// lo cierra, aunque el archivo ya se haya borrado
+typedef struct segment {
+    long long base;         // Posición de su primer documento
+    size_t written;         // Bytes escritos (solo el hilo escritor)
+    size_t durable;         // Bytes ya sincronizados: los lectores no pasan de aquí (atómico)
+    int fd;
+    char *map;
+    size_t map_len;
+    time_t created;
+    time_t last_write;      // Para la retención por antigüedad
+    int refs;
+    struct segment *next;
+} segment_t;
+
+struct msglog {
+    char dir[PATH_SIZE - 64];   // Deja lugar al nombre de los segmentos
+    msglog_config_t config;
+    mpsc_t queue;               // Tramas por agregar, de los hilos que difunden
+    pthread_t thread;
+    pthread_mutex_t mutex;      // Protege la lista frente a los lectores del historial
+    segment_t *first;           // El más antiguo
+    segment_t *active;          // El último: solo en él se escribe
+    int segments;
+
+    // Estadísticas acumuladas (escritas solo por el hilo escritor, salvo dropped)
+    unsigned long appended;
+    unsigned long bytes;
+    unsigned long syncs;
+    unsigned long dropped;
+    unsigned long compacted;
+    unsigned long expired;
+
+    // Totales del informe anterior (solo el hilo que informa)
+    unsigned long prev_appended;
+    unsigned long prev_bytes;
+    unsigned long prev_syncs;
+    unsigned long prev_dropped;
+};
+
+static const char newline[] = "\n";
+
+// Función para armar la ruta de un segmento (o de su compactación en curso)
+static void segment_path(const msglog_t *log, long long base, const char *suffix, char *path) {
+    snprintf(path, PATH_SIZE, "%s/%020lld%s", log->dir, base, suffix);
+}
+
+// Función para mapear un archivo ya abierto como segmento; map_len puede exceder el
+// archivo para que el segmento activo crezca sin volver a mapearlo
+static segment_t *segment_new(int fd, long long base, size_t size, size_t map_len) {
+    segment_t *seg = calloc(1, sizeof(segment_t));
+    if (seg == NULL) {
+        return NULL;
+    }
+    seg->map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    if (seg->map == MAP_FAILED) {
+        perror("Error al mapear un segmento del registro");
+        free(seg);
+        return NULL;
+    }
+    seg->base = base;
+    seg->written = size;
+    seg->durable = size;
+    seg->fd = fd;
+    seg->map_len = map_len;
+    seg->created = time(NULL);
+    seg->last_write = seg->created;
+    seg->refs = 1;
+    return seg;
+}
+
+static void segment_put(segment_t *seg) {
+    if (__atomic_sub_fetch(&seg->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        munmap(seg->map, seg->map_len);
+        close(seg->fd);
+        free(seg);
+    }
+}
+
+// Liberación de la última trama del historial que leía el segmento
+static void segment_release(void *owner) {
+    segment_put(owner);
+}
+
+// Función para crear el archivo de un segmento vacío que empieza en base
+static segment_t *segment_create(msglog_t *log, long long base) {
+    char path[PATH_SIZE];
+    segment_path(log, base, SEGMENT_SUFFIX, path);
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("Error al crear un segmento del registro");
+        return NULL;
+    }
+    segment_t *seg = segment_new(fd, base, 0, log->config.segment_bytes);
+    if (seg == NULL) {
+        close(fd);
+        unlink(path);
+    }
+    return seg;
+}
+
+// Función para que las altas, bajas y renombres de segmentos sobrevivan a un corte
+static void sync_dir(const msglog_t *log) {
+    int fd = open(log->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Función para escribir todos los iovec aunque writev() los tome por partes
+static int write_all(int fd, struct iovec *iov, int n_iov) {
+    while (n_iov > 0) {
+        ssize_t n = writev(fd, iov, n_iov < IOV_MAX ? n_iov : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (n_iov > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            n_iov--;
+        }
+        if (n_iov > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// Función para sincronizar lo escrito en el segmento activo y mostrárselo a los
+// lectores: un solo fsync por tanda, sin importar cuántos mensajes traiga
+static void sync_active(msglog_t *log) {
+    segment_t *seg = log->active;
+    if (seg->durable == seg->written) {
+        return;
+    }
+    if (fdatasync(seg->fd) < 0) {
+        perror("Error al sincronizar el registro");
+        return;
+    }
+    __atomic_add_fetch(&log->syncs, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&seg->durable, seg->written, __ATOMIC_RELEASE);
+}
+
+// Función para sellar el segmento activo y abrir el siguiente a continuación
+static int roll_segment(msglog_t *log) {
+    segment_t *old = log->active;
+    sync_active(log);
+    segment_t *seg = segment_create(log, old->base + (long long)old->written);
+    if (seg == NULL) {
+        return -1;
+    }
+    sync_dir(log);
+
+    pthread_mutex_lock(&log->mutex);
+    old->next = seg;
+    log->active = seg;
+    log->segments++;
+    pthread_mutex_unlock(&log->mutex);
+    return 0;
+}
+
+// Función para escribir una tanda de documentos: los que caben en el segmento
+// activo van juntos en un writev(); el resto pasa a un segmento nuevo
+static void write_batch(msglog_t *log, frame_t **batch, int n) {
+    struct iovec iov[WRITE_BATCH * 2];
+    size_t limit = log->config.segment_bytes;
+    int start = 0;
+
+    while (start < n) {
+        segment_t *seg = log->active;
+        size_t len = 0;
+        int n_iov = 0;
+        int end = start;
+
+        // Un documento que no cabe ni en un segmento vacío no se guarda
+        if (batch[start]->len + 1 > limit) {
+            __atomic_add_fetch(&log->dropped, 1, __ATOMIC_RELAXED);
+            start++;
+            continue;
+        }
+
+        while (end < n && seg->written + len + batch[end]->len + 1 <= limit) {
+            iov[n_iov].iov_base = batch[end]->data;
+            iov[n_iov++].iov_len = batch[end]->len;
+            iov[n_iov].iov_base = (char *)newline;
+            iov[n_iov++].iov_len = 1;
+            len += batch[end]->len + 1;
+            end++;
+        }
+
+        if (end == start) {
+            if (roll_segment(log) < 0) {
+                __atomic_add_fetch(&log->dropped, (unsigned long)(n - start), __ATOMIC_RELAXED);
+                return;
+            }
+            continue;
+        }
+
+        if (write_all(seg->fd, iov, n_iov) < 0) {
+            // Sin documentos a medias: lo escrito de esta tanda se descarta
+            perror("Error al escribir en el registro");
+            if (ftruncate(seg->fd, (off_t)seg->written) < 0) {
+                perror("Error al truncar el registro");
+            }
+            __atomic_add_fetch(&log->dropped, (unsigned long)(end - start), __ATOMIC_RELAXED);
+        } else {
+            seg->written += len;
+            seg->last_write = time(NULL);
+            __atomic_add_fetch(&log->appended, (unsigned long)(end - start), __ATOMIC_RELAXED);
+            __atomic_add_fetch(&log->bytes, len, __ATOMIC_RELAXED);
+        }
+        start = end;
+    }
+}
+
+// Función para borrar los segmentos sellados más antiguos que exceden la retención
+static void expire_segments(msglog_t *log, time_t now) {
+    long long total = 0;
+    for (segment_t *seg = log->first; seg != NULL; seg = seg->next) {
+        total += (long long)seg->written;
+    }
+
+    while (log->first != log->active) {
+        segment_t *seg = log->first;
+        if (total <= log->config.retention_bytes &&
+            now - seg->last_write < (time_t)log->config.retention_secs) {
+            break;
+        }
+
+        char path[PATH_SIZE];
+        segment_path(log, seg->base, SEGMENT_SUFFIX, path);
+        unlink(path);
+
+        pthread_mutex_lock(&log->mutex);
+        log->first = seg->next;
+        log->segments--;
+        pthread_mutex_unlock(&log->mutex);
+
+        total -= (long long)seg->written;
+        log->expired++;
+        segment_put(seg);   // Los lectores en curso lo conservan mapeado
+    }
+}
+
+// Función para reunir en un solo segmento los sellados de from a to (contiguos):
+// se escriben juntos en un archivo temporal que luego reemplaza al primero. Las
+// posiciones no cambian. Retorna el segmento nuevo o NULL si falla
+static segment_t *merge_segments(msglog_t *log, segment_t *prev, segment_t *from, segment_t *to,
+                                 size_t total) {
+    char tmp[PATH_SIZE];
+    char path[PATH_SIZE];
+    segment_path(log, from->base, COMPACT_SUFFIX, tmp);
+    segment_path(log, from->base, SEGMENT_SUFFIX, path);
+
+    int fd = open(tmp, O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("Error al compactar el registro");
+        return NULL;
+    }
+
+    int failed = 0;
+    for (segment_t *seg = from; !failed; seg = seg->next) {
+        struct iovec iov = {seg->map, seg->written};
+        failed = write_all(fd, &iov, 1) < 0;
+        if (seg == to) {
+            break;
+        }
+    }
+
+    segment_t *merged = NULL;
+    if (!failed && fdatasync(fd) == 0) {
+        merged = segment_new(fd, from->base, total, total);
+    }
+    if (merged == NULL || rename(tmp, path) < 0) {
+        perror("Error al compactar el registro");
+        if (merged != NULL) {
+            segment_put(merged);
+        } else {
+            close(fd);
+        }
+        unlink(tmp);
+        return NULL;
+    }
+    merged->created = from->created;
+    merged->last_write = to->last_write;
+
+    // Publicar el segmento nuevo en lugar del tramo; los lectores en curso siguen
+    // con los mapas viejos
+    int count = 0;
+    pthread_mutex_lock(&log->mutex);
+    merged->next = to->next;
+    if (prev != NULL) {
+        prev->next = merged;
+    } else {
+        log->first = merged;
+    }
+    for (segment_t *seg = from; seg != merged->next; seg = seg->next) {
+        count++;
+    }
+    log->segments -= count - 1;
+    pthread_mutex_unlock(&log->mutex);
+
+    // El primero ya quedó reemplazado por el renombre
+    segment_t *seg = from;
+    while (seg != merged->next) {
+        segment_t *next = seg->next;
+        if (seg != from) {
+            segment_path(log, seg->base, SEGMENT_SUFFIX, path);
+            unlink(path);
+        }
+        segment_put(seg);
+        seg = next;
+    }
+    sync_dir(log);
+    log->compacted += (unsigned long)count;
+    return merged;
+}
+
+// Función para compactar: los segmentos sellados chicos (por tiempo o por un
+// reinicio) y contiguos se reúnen mientras quepan en uno de tamaño normal
+static void compact_segments(msglog_t *log) {
+    size_t limit = log->config.segment_bytes;
+    size_t small = limit / 4;
+    segment_t *prev = NULL;
+    segment_t *seg = log->first;
+
+    while (seg != NULL && seg != log->active) {
+        segment_t *last = seg;
+        size_t total = seg->written;
+        while (last->written < small && last->next != log->active &&
+               last->next->written < small && total + last->next->written <= limit &&
+               last->base + (long long)last->written == last->next->base) {
+            last = last->next;
+            total += last->written;
+        }
+
+        if (last != seg) {
+            segment_t *merged = merge_segments(log, prev, seg, last, total);
+            if (merged == NULL) {
+                return;
+            }
+            seg = merged;
+        }
+        prev = seg;
+        seg = seg->next;
+    }
+}
+
+// Hilo escritor: cada intervalo vacía la cola, escribe en tandas y sincroniza una
+// sola vez; de paso sella, vence y compacta segmentos
+static void *writer_loop(void *arg) {
+    msglog_t *log = arg;
+    frame_t *batch[WRITE_BATCH];
+    time_t next_maintenance = 0;
+
+    while (1) {
+        usleep(log->config.fsync_ms * 1000);
+
+        int n;
+        do {
+            frame_t *frame;
+            n = 0;
+            while (n < WRITE_BATCH && (frame = mpsc_pop(&log->queue)) != NULL) {
+                batch[n++] = frame;
+            }
+            if (n > 0) {
+                write_batch(log, batch, n);
+                for (int i = 0; i < n; i++) {
+                    frame_put(batch[i]);
+                }
+            }
+        } while (n == WRITE_BATCH);
+        sync_active(log);
+
+        time_t now = time(NULL);
+        if (now < next_maintenance) {
+            continue;
+        }
+        next_maintenance = now + MAINTENANCE_SECS;
+
+        segment_t *active = log->active;
+        if (active->written > 0 && now - active->created >= (time_t)log->config.segment_secs) {
+            roll_segment(log);
+        }
+        expire_segments(log, now);
+        compact_segments(log);
+    }
+
+    return NULL;
+}
+
+static int compare_bases(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Función para recuperar los segmentos del directorio: el último pasa a ser el
+// activo, sin el documento a medias que pudo dejar un corte
+static int recover_segments(msglog_t *log) {
+    DIR *dir = opendir(log->dir);
+    if (dir == NULL) {
+        perror("Error al abrir el directorio del registro");
+        return -1;
+    }
+
+    long long *bases = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+    struct dirent *entry;
+    char path[PATH_SIZE];
+    while ((entry = readdir(dir)) != NULL) {
+        char *end;
+        long long base = strtoll(entry->d_name, &end, 10);
+        if (end == entry->d_name || base < 0) {
+            continue;
+        }
+        if (strcmp(end, COMPACT_SUFFIX) == 0) {
+            segment_path(log, base, COMPACT_SUFFIX, path);     // Compactación interrumpida
+            unlink(path);
+            continue;
+        }
+        if (strcmp(end, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap > 0 ? cap * 2 : 64;
+            long long *grown = realloc(bases, cap * sizeof(long long));
+            if (grown == NULL) {
+                free(bases);
+                closedir(dir);
+                return -1;
+            }
+            bases = grown;
+        }
+        bases[count++] = base;
+    }
+    closedir(dir);
+    if (count > 1) {
+        qsort(bases, count, sizeof(long long), compare_bases);
+    }
+
+    segment_t *tail = NULL;
+    long long end = 0;
+    for (size_t i = 0; i < count; i++) {
+        int last = i == count - 1;
+        segment_path(log, bases[i], SEGMENT_SUFFIX, path);
+
+        // Un segmento dentro de otro quedó de una compactación que no llegó a borrarlo
+        if (tail != NULL && bases[i] < end) {
+            unlink(path);
+            continue;
+        }
+
+        struct stat st;
+        int fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC);
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            perror("Error al abrir un segmento del registro");
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        size_t size = (size_t)st.st_size;
+        if (size == 0 && !last) {
+            close(fd);
+            unlink(path);
+            continue;
+        }
+
+        size_t map_len = last && size < log->config.segment_bytes ? log->config.segment_bytes : size;
+        segment_t *seg = segment_new(fd, bases[i], size, map_len);
+        if (seg == NULL) {
+            close(fd);
+            continue;
+        }
+        seg->last_write = st.st_mtime;
+
+        // Solo el activo puede terminar en un documento a medias
+        if (last && size > 0 && seg->map[size - 1] != '\n') {
+            const char *nl = memrchr(seg->map, '\n', size);
+            size_t keep = nl != NULL ? (size_t)(nl - seg->map) + 1 : 0;
+            if (ftruncate(fd, (off_t)keep) < 0) {
+                perror("Error al recuperar el registro");
+            }
+            printf("Registro %s: %zu bytes incompletos descartados\n", log->dir, size - keep);
+            seg->written = seg->durable = keep;
+        }
+
+        if (tail != NULL) {
+            tail->next = seg;
+        } else {
+            log->first = seg;
+        }
+        tail = seg;
+        log->segments++;
+        end = seg->base + (long long)seg->written;
+    }
+    free(bases);
+
+    if (tail == NULL) {
+        tail = segment_create(log, 0);
+        if (tail == NULL) {
+            return -1;
+        }
+        log->first = tail;
+        log->segments = 1;
+        sync_dir(log);
+    }
+    log->active = tail;
+    return 0;
+}
+
+msglog_t *msglog_open(const char *dir, const msglog_config_t *config) {
+    msglog_t *log = calloc(1, sizeof(msglog_t));
+    if (log == NULL) {
+        return NULL;
+    }
+    if (strlen(dir) >= sizeof(log->dir)) {
+        fprintf(stderr, "Ruta del registro demasiado larga: %s\n", dir);
+        free(log);
+        return NULL;
+    }
+    strcpy(log->dir, dir);
+    log->config = *config;
+    pthread_mutex_init(&log->mutex, NULL);
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("Error al crear el directorio del registro");
+        free(log);
+        return NULL;
+    }
+    if (recover_segments(log) < 0 || mpsc_init(&log->queue, MSGLOG_QUEUE_SIZE) < 0) {
+        free(log);
+        return NULL;
+    }
+
+    if (pthread_create(&log->thread, NULL, writer_loop, log) != 0) {
+        perror("Error al crear el hilo del registro");
+        free(log);
+        return NULL;
+    }
+    pthread_detach(log->thread);
+
+    segment_t *active = log->active;
+    printf("Registro %s: %d segmentos, posiciones %lld a %lld\n", dir, log->segments,
+           log->first->base, active->base + (long long)active->written);
+    return log;
+}
+
+int msglog_append(msglog_t *log, frame_t *frame) {
+    frame_get(frame);
+    if (mpsc_push(&log->queue, frame) < 0) {
+        frame_put(frame);
+        __atomic_add_fetch(&log->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+int msglog_read(msglog_t *log, long long before, size_t max_bytes, frame_t **frames, int max_frames,
+                long long *from, long long *to) {
+    int n = 0;
+
+    pthread_mutex_lock(&log->mutex);
+
+    // Fin del rango: before (o lo último durable), retrocedido al final de un documento
+    segment_t *active = log->active;
+    long long end = active->base + (long long)__atomic_load_n(&active->durable, __ATOMIC_ACQUIRE);
+    if (before >= 0 && before < end) {
+        end = before;
+    }
+    segment_t *last = NULL;
+    for (segment_t *seg = log->first; seg != NULL && seg->base < end; seg = seg->next) {
+        last = seg;
+    }
+    if (last == NULL) {
+        end = log->first->base;
+    } else {
+        size_t len = __atomic_load_n(&last->durable, __ATOMIC_ACQUIRE);
+        if (end > last->base + (long long)len) {
+            end = last->base + (long long)len;
+        }
+        size_t off = (size_t)(end - last->base);
+        if (last->map[off - 1] != '\n') {
+            const char *nl = memrchr(last->map, '\n', off);
+            end = last->base + (nl != NULL ? (long long)(nl - last->map) + 1 : 0);
+        }
+    }
+
+    // Principio: max_bytes antes, avanzado al comienzo de un documento
+    long long start = end - (long long)max_bytes;
+    *from = end;
+    *to = end;
+    for (segment_t *seg = log->first; seg != NULL && seg->base < end && n < max_frames; seg = seg->next) {
+        long long len = (long long)__atomic_load_n(&seg->durable, __ATOMIC_ACQUIRE);
+        long long lo = start > seg->base ? start : seg->base;
+        long long hi = end < seg->base + len ? end : seg->base + len;
+        if (lo >= hi) {
+            continue;
+        }
+        if (lo > seg->base && seg->map[lo - seg->base - 1] != '\n') {
+            const char *nl = memchr(seg->map + (lo - seg->base), '\n', (size_t)(hi - lo));
+            if (nl == NULL) {
+                continue;
+            }
+            lo = seg->base + (nl - seg->map) + 1;
+            if (lo >= hi) {
+                continue;
+            }
+        }
+
+        frame_t *frame = frame_create_file(seg->map + (lo - seg->base), (size_t)(hi - lo), seg->fd,
+                                           lo - seg->base, segment_release, seg);
+        if (frame == NULL) {
+            break;
+        }
+        __atomic_add_fetch(&seg->refs, 1, __ATOMIC_RELAXED);
+        if (n == 0) {
+            *from = lo;
+        }
+        *to = hi;
+        frames[n++] = frame;
+    }
+
+    pthread_mutex_unlock(&log->mutex);
+    return n;
+}
+
+void msglog_report(msglog_t *log) {
+    unsigned long appended = __atomic_load_n(&log->appended, __ATOMIC_RELAXED);
+    unsigned long bytes = __atomic_load_n(&log->bytes, __ATOMIC_RELAXED);
+    unsigned long syncs = __atomic_load_n(&log->syncs, __ATOMIC_RELAXED);
+    unsigned long dropped = __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+
+    unsigned long count = appended - log->prev_appended;
+    if (count == 0 && dropped == log->prev_dropped) {
+        return;
+    }
+
+    unsigned long synced = syncs - log->prev_syncs;
+    printf("Registro %s: %lu mensajes (%lu KiB), %lu fsync (%.1f mensajes por fsync), %lu descartados, "
+           "cola %zu | %d segmentos, %lu compactados, %lu vencidos\n",
+           log->dir, count, (bytes - log->prev_bytes) / 1024, synced,
+           synced > 0 ? (double)count / (double)synced : 0.0, dropped - log->prev_dropped,
+           mpsc_depth(&log->queue), __atomic_load_n(&log->segments, __ATOMIC_RELAXED),
+           __atomic_load_n(&log->compacted, __ATOMIC_RELAXED),
+           __atomic_load_n(&log->expired, __ATOMIC_RELAXED));
+
+    log->prev_appended = appended;
+    log->prev_bytes = bytes;
+    log->prev_syncs = syncs;
+    log->prev_dropped = dropped;
+}
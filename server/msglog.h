@@ -0,0 +1,48 @@
+#ifndef MSGLOG_H
+#define MSGLOG_H
+
+#include <stddef.h>
+#include "frame.h"
+
+// Registro de mensajes en disco: segmentos de solo agregado, cada uno con los
+// documentos JSON tal como se enviaron, uno por línea. Un segmento se llama por la
+// posición (en bytes desde el origen del registro) de su primer documento, así que
+// cada mensaje tiene una posición estable aunque se borren los segmentos antiguos
+#define MSGLOG_SEGMENT_BYTES (64 * 1024 * 1024)     // Tamaño al que se sella el segmento activo
+#define MSGLOG_SEGMENT_SECS 3600                    // Antigüedad a la que se sella aunque no esté lleno
+#define MSGLOG_RETENTION_BYTES (1024LL * 1024 * 1024)   // Lo que se conserva de cada registro
+#define MSGLOG_RETENTION_SECS (7 * 24 * 3600)
+#define MSGLOG_FSYNC_MS 10                          // Intervalo del grupo de escritura: un fsync por tanda
+#define MSGLOG_QUEUE_SIZE 65536                     // Mensajes pendientes de escribir
+#define MSGLOG_READ_FRAMES 32                       // Tramos por lectura del historial (uno por segmento)
+
+typedef struct {
+    size_t segment_bytes;
+    unsigned segment_secs;
+    long long retention_bytes;
+    unsigned retention_secs;
+    unsigned fsync_ms;
+} msglog_config_t;
+
+typedef struct msglog msglog_t;
+
+// Abre el registro del directorio dir (lo crea si no existe), recupera sus
+// segmentos y lanza su hilo escritor. Retorna NULL si falla
+msglog_t *msglog_open(const char *dir, const msglog_config_t *config);
+
+// Toma una referencia a la trama (un documento JSON) y la encola para agregarla al
+// registro; nunca bloquea ni hace E/S. Retorna -1 si la cola está llena: ese
+// mensaje no se guarda
+int msglog_append(msglog_t *log, frame_t *frame);
+
+// Prepara una lectura del historial: hasta max_bytes de documentos ya durables que
+// terminan antes de la posición before (before < 0: hasta el final). Cada tramo es
+// una trama sobre el mapa de su segmento, sin copia, y lo mantiene vivo mientras
+// esté encolada. Retorna el número de tramas y en from/to el rango leído
+int msglog_read(msglog_t *log, long long before, size_t max_bytes, frame_t **frames, int max_frames,
+                long long *from, long long *to);
+
+// Imprime mensajes, fsync, descartes y segmentos desde el informe anterior
+void msglog_report(msglog_t *log);
+
+#endif
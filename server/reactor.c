@@ -0,0 +1,349 @@
+#define _GNU_SOURCE   // accept4(), pthread_setaffinity_np()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "reactor.h"
+#include "uring.h"
+#include "slab.h"
+
+// Reactor epoll: un hilo con su propio socket de escucha SO_REUSEPORT
+typedef struct {
+    int id;
+    int epoll_fd;
+    int listen_fd;
+    int spare_fd;       // Descriptor de reserva para sobrevivir a EMFILE
+    pthread_t thread;
+} epoll_reactor_t;
+
+static reactor_config_t config;
+static epoll_reactor_t *reactors;
+static slab_cache_t *conn_cache;
+
+// Marca usada en epoll_event.data.ptr para distinguir el socket de escucha
+static char listen_tag;
+
+// epoll_pwait2() necesita Linux 5.11; se deja de intentar al primer ENOSYS
+static int has_pwait2 = 1;
+
+// Función para crear un socket de escucha compartible entre reactores
+int create_listen_socket(int port, int backlog) {
+    struct sockaddr_in address;
+    int opt = 1;
+    int fd;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        perror("Error al crear socket");
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        perror("Error en setsockopt");
+        close(fd);
+        return -1;
+    }
+
+    // Cada reactor abre su propio socket en el mismo puerto y el kernel reparte las conexiones
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        perror("Error en setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("Error en bind");
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, backlog) < 0) {
+        perror("Error en listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Función para desactivar Nagle: las tramas del chat son pequeñas y sensibles a la latencia
+void set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Función para fijar el hilo actual a un núcleo si se pidió afinidad
+void pin_reactor_thread(int id) {
+    if (!config.pin_cpus) {
+        return;
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((int)(id % (ncpu > 0 ? ncpu : 1)), &set);
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        fprintf(stderr, "No se pudo fijar el reactor %d a un núcleo: %s\n", id, strerror(err));
+    }
+}
+
+// Función para preparar los sockets de escucha y los reactores
+int reactor_init(const reactor_config_t *cfg) {
+    config = *cfg;
+
+    if (config.backend == IO_URING) {
+        return uring_init(&config);
+    }
+
+    reactors = calloc((size_t)config.reactors, sizeof(epoll_reactor_t));
+    conn_cache = slab_cache_create("conexiones", sizeof(conn_t));
+    if (reactors == NULL || conn_cache == NULL) {
+        perror("Error al reservar reactores");
+        return -1;
+    }
+
+    for (int i = 0; i < config.reactors; i++) {
+        epoll_reactor_t *r = &reactors[i];
+        r->id = i;
+
+        if ((r->listen_fd = create_listen_socket(config.port, config.backlog)) < 0) {
+            return -1;
+        }
+
+        if ((r->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            perror("Error en epoll_create1");
+            return -1;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &listen_tag;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->listen_fd, &ev) < 0) {
+            perror("Error en epoll_ctl");
+            return -1;
+        }
+
+        r->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    return 0;
+}
+
+// Función para cerrar una conexión y liberar su estado
+static void close_conn(conn_t *conn) {
+    on_client_close(conn);
+    conn_shutdown(conn);
+    close(conn->fd);   // close() también la retira del conjunto de epoll
+    conn_put(conn);    // Otros hilos pueden conservar referencias hasta vaciar su lote
+}
+
+// Función para aceptar todas las conexiones pendientes (modo edge-triggered)
+static void accept_clients(epoll_reactor_t *r) {
+    while (1) {
+        struct sockaddr_in address;
+        socklen_t addrlen = sizeof(address);
+        int fd = accept4(r->listen_fd, (struct sockaddr *)&address, &addrlen,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && r->spare_fd >= 0) {
+                // Sin descriptores: liberar la reserva para aceptar y descartar
+                close(r->spare_fd);
+                fd = accept(r->listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                r->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                fprintf(stderr, "Conexión rechazada: límite de descriptores alcanzado\n");
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Error en accept");
+            }
+            return;
+        }
+
+        conn_t *conn = slab_alloc(conn_cache);
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        set_nodelay(fd);
+        conn_init(conn, fd, &address, r->id);
+
+        // EPOLLOUT en modo edge solo llega cuando un socket lleno vuelve a tener espacio
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("Error en epoll_ctl");
+            close(fd);
+            conn_put(conn);
+            continue;
+        }
+
+        printf("Nueva conexión desde %s:%d (reactor %d)\n", conn->ip, conn->port, r->id);
+    }
+}
+
+// Función para leer de un cliente hasta vaciar el socket (modo edge-triggered)
+static void read_client(conn_t *conn) {
+    char buffer[BUFFER_SIZE];
+
+    while (1) {
+        if (__atomic_load_n(&conn->in_paused, __ATOMIC_ACQUIRE)) {
+            return;     // Cliente lento: lo pendiente espera en el socket hasta reactor_resume()
+        }
+        ssize_t n = recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            // Una lectura puede traer varios documentos o solo parte de uno
+            if (conn_feed(conn, buffer, (size_t)n) < 0) {
+                close_conn(conn);
+                return;
+            }
+        } else if (n == 0) {
+            close_conn(conn);
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            close_conn(conn);
+            return;
+        }
+    }
+}
+
+// Función para esperar eventos hasta wait_ns nanosegundos (-1: sin plazo). Se llama
+// a epoll_pwait2() por syscall() para no depender de glibc 2.35; sin soporte en el
+// kernel se usa epoll_wait() con el plazo redondeado hacia arriba a milisegundos
+static int wait_events(int epoll_fd, struct epoll_event *events, long long wait_ns) {
+#ifdef __NR_epoll_pwait2
+    if (__atomic_load_n(&has_pwait2, __ATOMIC_RELAXED)) {
+        struct timespec timeout = {(time_t)(wait_ns / 1000000000), (long)(wait_ns % 1000000000)};
+        int n = (int)syscall(__NR_epoll_pwait2, epoll_fd, events, MAX_EVENTS, wait_ns >= 0 ? &timeout : NULL,
+                             NULL, 0);
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+        __atomic_store_n(&has_pwait2, 0, __ATOMIC_RELAXED);
+    }
+#else
+    (void)has_pwait2;
+#endif
+    int timeout_ms = wait_ns >= 0 ? (int)((wait_ns + 999999) / 1000000) : -1;
+    return epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+}
+
+// Función del bucle de eventos de un reactor epoll
+static void *epoll_reactor_loop(void *arg) {
+    epoll_reactor_t *r = arg;
+    struct epoll_event events[MAX_EVENTS];
+    long long wait_ns = -1;     // Vencimiento de la salida diferida más próxima (-1: ninguna)
+
+    pin_reactor_thread(r->id);
+
+    while (1) {
+        // Con salida diferida por la ventana de agrupación, se espera solo hasta que venza
+        int n = wait_events(r->epoll_fd, events, wait_ns);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error en epoll_wait");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &listen_tag) {
+                accept_clients(r);
+                continue;
+            }
+
+            conn_t *conn = events[i].data.ptr;
+            if (events[i].events & EPOLLERR) {
+                close_conn(conn);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && conn_write(conn) < 0) {
+                close_conn(conn);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+                // EPOLLHUP/EPOLLRDHUP también se atienden leyendo: recv() devolverá 0
+                read_client(conn);
+            }
+        }
+
+        // Las respuestas del lote salen juntas, una llamada a writev() por conexión
+        wait_ns = conn_flush_window();
+    }
+
+    return NULL;
+}
+
+// Función para lanzar los reactores; el hilo actual ejecuta el reactor 0
+void reactor_run(void) {
+    if (config.backend == IO_URING) {
+        uring_run();
+        return;
+    }
+
+    for (int i = 1; i < config.reactors; i++) {
+        if (pthread_create(&reactors[i].thread, NULL, epoll_reactor_loop, &reactors[i]) != 0) {
+            perror("Error al crear hilo reactor");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(reactors[i].thread);
+    }
+
+    epoll_reactor_loop(&reactors[0]);
+}
+
+// Función para vaciar la cola de salida de una conexión
+void reactor_flush(conn_t *conn) {
+    if (config.backend == IO_URING) {
+        uring_flush(conn);
+        return;
+    }
+
+    // Los errores de escritura los atiende el reactor dueño al recibir EPOLLERR/EPOLLHUP
+    conn_write(conn);
+}
+
+// Función para reanudar la lectura de una conexión pausada
+void reactor_resume(conn_t *conn) {
+    if (config.backend == IO_URING) {
+        // El anillo dueño vuelve a armar el recv al vaciar sus conexiones marcadas
+        uring_flush(conn);
+        return;
+    }
+
+    // Volver a registrar los eventos hace que epoll notifique de nuevo lo ya legible
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    if (epoll_ctl(reactors[conn->reactor].epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        perror("Error en epoll_ctl");
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "conn.h"
+
+#define BUFFER_SIZE 2048        // Tamaño del buffer de lectura por recv()
+#define MAX_EVENTS 256          // Eventos procesados por llamada a epoll_wait
+#define DEFAULT_BACKLOG 1024    // Cola de conexiones pendientes por socket de escucha
+
+// Motor de E/S elegido al iniciar el servidor
+typedef enum {
+    IO_EPOLL = 0,   // epoll edge-triggered con writev() no bloqueante
+    IO_URING        // io_uring con accept/recv multishot y envíos por lotes
+} io_backend_t;
+
+// Configuración del reactor elegida al iniciar
+typedef struct {
+    int port;
+    io_backend_t backend;
+    int reactors;       // Hilos reactor, cada uno con su socket SO_REUSEPORT
+    int backlog;        // Tamaño de la cola de listen() de cada socket
+    int pin_cpus;       // Fijar el reactor i al núcleo i
+} reactor_config_t;
+
+// Crea los sockets de escucha y prepara un reactor por hilo con el motor indicado
+int reactor_init(const reactor_config_t *config);
+
+// Lanza los hilos reactor; el hilo actual ejecuta el reactor 0 (no retorna)
+void reactor_run(void);
+
+// Vacía la cola de salida de la conexión con el motor de E/S activo
+void reactor_flush(conn_t *conn);
+
+// Vuelve a leer de una conexión cuya lectura estaba en pausa
+void reactor_resume(conn_t *conn);
+
+// Crea un socket TCP de escucha no bloqueante con SO_REUSEPORT en el puerto indicado
+int create_listen_socket(int port, int backlog);
+
+// Fija el hilo actual al núcleo correspondiente al reactor indicado
+void pin_reactor_thread(int id);
+
+// Desactiva el algoritmo de Nagle en un socket de cliente
+void set_nodelay(int fd);
+
+// Callbacks implementados por el servidor
+int on_client_message(conn_t *conn, const char *data, size_t len);
+void on_client_close(conn_t *conn);
+
+#endif
@@ -1,121 +1,358 @@
-#ifdef _WIN32
-  // Definir versión mínima de Windows para habilitar inet_ntop
-  #ifndef _WIN32_WINNT
-    #define _WIN32_WINNT 0x0600
-  #endif
-
-  #include <winsock2.h>
-  #include <ws2tcpip.h>
-  #include <windows.h>
-  #include <pthread.h>   // Necesario si usas pthreads-win32
-  #pragma comment(lib, "ws2_32.lib")
-
-  // Redefinir funciones POSIX a las equivalentes de Win32
-  #define close(fd) closesocket(fd)
-  #define sleep(x) Sleep((x)*1000)
-
-#else
-  // En Linux/Unix, las cabeceras POSIX normales
-  #include <unistd.h>
-  #include <pthread.h>
-  #include <sys/socket.h>
-  #include <netinet/in.h>
-  #include <arpa/inet.h>
-#endif
+// Cabeceras POSIX (el servidor usa epoll, por lo que requiere Linux)
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <time.h>
-#include "cJSON.h"  // Asegúrate de que cJSON.h esté en tu proyecto
+#include <errno.h>
+#include <sys/stat.h>
+#include "reactor.h"
+#include "users.h"
+#include "directory.h"
+#include "slab.h"
+#include "dispatch.h"
+#include "wire.h"
+#include "compress.h"
+#include "msglog.h"
+#include "inbox.h"
 
-#define MAX_CLIENTS 100
-#define BUFFER_SIZE 2048
+#define DEFAULT_MAX_USERS 100000    // Techo de usuarios registrados (--max-users)
+#define MEMORY_BUDGET_PER_USER 1024 // Bytes por usuario inactivo que no deben superarse
 #define DEFAULT_PORT 50213
+#define MEMORY_REPORT_SECS 60         // Intervalo del informe de memoria
+#define PIPELINE_REPORT_SECS 5        // Intervalo del informe de etapas
+#define HISTORY_BYTES (256 * 1024)    // Historial por solicitud (a lo sumo media cola de salida)
 
-// Estructura para usuarios
-typedef struct {
-    char username[50];
-    char ip[INET_ADDRSTRLEN];
-    int socket;
-    int status;  // 0: ACTIVO, 1: OCUPADO, 2: INACTIVO
-    time_t last_activity;
-} user_t;
-
-// Estructura para clientes
-typedef struct {
-    int socket;
-    struct sockaddr_in address;
-} client_t;
-
-// Variables globales
-user_t users[MAX_CLIENTS];
-int user_count = 0;
-pthread_mutex_t users_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Respuestas fijas: se serializan una sola vez al iniciar, en cada formato de salida
+typedef enum {
+    REPLY_OK = 0,
+    REPLY_REGISTERED,           // OK del REGISTRO (confirma la codificación y la compresión)
+    REPLY_DUPLICATE,            // Rechazo del REGISTRO (ídem)
+    REPLY_NAME_TOO_LONG,        // Rechazo del REGISTRO: el nombre no cabe (ídem)
+    REPLY_INVALID_STATUS,
+    REPLY_USER_NOT_FOUND,
+    REPLY_NO_HISTORY,           // HISTORIA sin registro de mensajes (--log-dir)
+    N_REPLIES
+} reply_t;
+
+static const struct {
+    const char *respuesta;
+    const char *razon;
+    int confirms_format;        // Lleva "codificacion" y "compresion" en las variantes que las usan
+} reply_specs[N_REPLIES] = {
+    [REPLY_OK] = {"OK", NULL, 0},
+    [REPLY_REGISTERED] = {"OK", NULL, 1},
+    [REPLY_DUPLICATE] = {"ERROR", "Nombre o dirección duplicado", 1},
+    [REPLY_NAME_TOO_LONG] = {"ERROR", "NOMBRE_DEMASIADO_LARGO", 1},
+    [REPLY_INVALID_STATUS] = {"ERROR", "ESTADO_INVALIDO", 0},
+    [REPLY_USER_NOT_FOUND] = {"ERROR", "USUARIO_NO_ENCONTRADO", 0},
+    [REPLY_NO_HISTORY] = {"ERROR", "HISTORIAL_DESACTIVADO", 0},
+};
+
+static frame_t *replies[N_REPLIES][CONN_FORMATS];      // Inmutables, nunca se liberan
+
+// Cada hilo serializa en su propio buffer, que se reutiliza de una trama a otra
+static __thread wire_writer_t writer;
+
+// Campos que usan los comandos; el resto de cada solicitud solo se valida
+#define REQUEST_FIELDS (WIRE_FIELD(WIRE_KEY_TIPO) | WIRE_FIELD(WIRE_KEY_ACCION) | \
+                        WIRE_FIELD(WIRE_KEY_USUARIO) | WIRE_FIELD(WIRE_KEY_DIRECCION_IP) | \
+                        WIRE_FIELD(WIRE_KEY_ESTADO) | WIRE_FIELD(WIRE_KEY_NOMBRE_EMISOR) | \
+                        WIRE_FIELD(WIRE_KEY_NOMBRE_DESTINATARIO) | WIRE_FIELD(WIRE_KEY_MENSAJE) | \
+                        WIRE_FIELD(WIRE_KEY_CODIFICACION) | WIRE_FIELD(WIRE_KEY_OPERACIONES) | \
+                        WIRE_FIELD(WIRE_KEY_COMPRESION) | WIRE_FIELD(WIRE_KEY_ANTES))
+
+// Solicitud en curso de cada hilo: se analiza y se atiende sin pasar a otro
+static __thread wire_request_t request;
+
+// Operación de un LOTE en curso; sus cadenas se copian aparte de las de la solicitud
+static __thread wire_request_t operation;
+
+// Alguna conexión negoció compresión: desde entonces la LISTA también se prepara
+// comprimida (atómico; nunca vuelve a 0)
+static int compression_used;
+
+// Registros de mensajes en disco (--log-dir): las difusiones, que se sirven como
+// historial, y los mensajes directos, que solo se guardan. NULL si no se usan
+static msglog_t *broadcast_log;
+static msglog_t *direct_log;
+static size_t history_bytes = HISTORY_BYTES;
+
+// Los DM a usuarios desconectados esperan en su buzón (--log-dir; --inbox-max 0 lo desactiva)
+static int inbox_enabled;
+
+// Variables globales (los usuarios viven en las porciones de users.c)
+pthread_mutex_t directory_mutex = PTHREAD_MUTEX_INITIALIZER;    // Serializa las reconstrucciones
+unsigned long published_version = (unsigned long)-1;    // Versión de la última instantánea
 
 // Prototipos
-void *handle_client(void *arg);
 void *check_inactivity(void *arg);
-int register_user(const char *username, const char *ip, int socket);
-void remove_user(const char *username);
+int register_user(const char *username, const char *ip, conn_t *conn, int encoding, int compressed);
+void remove_user(conn_t *conn);
 void broadcast_message(const char *sender, const char *message);
 void send_direct_message(const char *sender, const char *recipient, const char *message);
-void list_users(int client_socket);
-void get_user_info(const char *username, int client_socket);
-void change_user_status(const char *username, int status);
+void list_users(conn_t *client);
+void get_user_info(const char *username, conn_t *client);
+void change_user_status(conn_t *conn, int status);
+void touch_user(conn_t *conn);
+void report_memory(void);
+static wire_request_t *parse_request(const char *buffer, size_t len);
+static void handle_request(conn_t *conn, const wire_request_t *req);
+
+// Función que atiende un verbo del protocolo. Retorna la respuesta fija (reply_t)
+// que le corresponde o uno de estos resultados
+#define CMD_DONE -1         // Atendido; no lleva respuesta fija (o ya envió la suya)
+#define CMD_IGNORED -2      // Faltan campos o no se permite aquí: se descarta sin responder
+typedef int (*command_fn)(conn_t *conn, const wire_request_t *req);
+static int run_command(conn_t *conn, const wire_request_t *req, int batched);
+static void release_session(conn_t *conn);
+static frame_t *writer_frame(int compressed);
+static void writer_send(conn_t *conn);
+static int init_replies(void);
+static void send_reply(conn_t *conn, reply_t reply);
+static int open_logs(const char *dir, const msglog_config_t *config);
+
+// Función para mostrar la forma de uso y terminar
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [puerto] [--io epoll|uring] [--reactors N] [--backlog N] [--pin] [--shards N] [--max-users N] [--idle-timeout S] [--workers N] [--outq-max BYTES] [--outq-global BYTES] [--slow-policy drop|pause|disconnect] [--coalesce-us US] [--coalesce-frames N] [--log-dir DIR] [--log-segment-bytes N] [--log-segment-secs S] [--log-retention-bytes N] [--log-retention-secs S] [--log-fsync-ms MS] [--inbox-max N] [--inbox-total-bytes N] [--inbox-ttl S]\n", prog);
+    exit(EXIT_FAILURE);
+}
 
 int main(int argc, char *argv[]) {
-#ifdef _WIN32
-    // Inicializar WinSock
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
-        fprintf(stderr, "Error: WSAStartup() falló\n");
-        exit(EXIT_FAILURE);
+    pthread_t inactivity_thread;
+    struct rlimit rl;
+    reactor_config_t config;
+    int shards = DEFAULT_SHARDS;
+    int max_users = DEFAULT_MAX_USERS;
+    double idle_secs = DEFAULT_IDLE_MS / 1000.0;
+    int workers;
+    size_t outq_max = OUTQ_MAX_BYTES;
+    size_t outq_global = OUTQ_GLOBAL_MAX_BYTES;
+    slow_policy_t slow_policy = SLOW_DROP;
+    long coalesce_us = 0;
+    long coalesce_frames = COALESCE_FRAMES;
+    const char *log_dir = NULL;
+    inbox_config_t inbox_config = {
+        INBOX_MAX_MESSAGES, INBOX_CHUNK_BYTES, INBOX_MAX_BOXES, INBOX_TOTAL_BYTES, INBOX_TTL_SECS
+    };
+    msglog_config_t log_config = {
+        MSGLOG_SEGMENT_BYTES, MSGLOG_SEGMENT_SECS, MSGLOG_RETENTION_BYTES, MSGLOG_RETENTION_SECS, MSGLOG_FSYNC_MS
+    };
+    
+    static const struct option long_options[] = {
+        {"io", required_argument, NULL, 'i'},
+        {"reactors", required_argument, NULL, 'r'},
+        {"backlog", required_argument, NULL, 'b'},
+        {"pin", no_argument, NULL, 'p'},
+        {"shards", required_argument, NULL, 's'},
+        {"max-users", required_argument, NULL, 'm'},
+        {"idle-timeout", required_argument, NULL, 't'},
+        {"workers", required_argument, NULL, 'w'},
+        {"outq-max", required_argument, NULL, 'o'},
+        {"outq-global", required_argument, NULL, 'g'},
+        {"slow-policy", required_argument, NULL, 'l'},
+        {"coalesce-us", required_argument, NULL, 'c'},
+        {"coalesce-frames", required_argument, NULL, 'f'},
+        {"log-dir", required_argument, NULL, 'd'},
+        {"log-segment-bytes", required_argument, NULL, 'S'},
+        {"log-segment-secs", required_argument, NULL, 'T'},
+        {"log-retention-bytes", required_argument, NULL, 'R'},
+        {"log-retention-secs", required_argument, NULL, 'A'},
+        {"log-fsync-ms", required_argument, NULL, 'y'},
+        {"inbox-max", required_argument, NULL, 'x'},
+        {"inbox-total-bytes", required_argument, NULL, 'B'},
+        {"inbox-ttl", required_argument, NULL, 'u'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    // Valores por defecto: epoll, un reactor por núcleo
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    config.port = DEFAULT_PORT;
+    config.backend = IO_EPOLL;
+    config.reactors = ncpu > 0 ? (int)ncpu : 1;
+    config.backlog = DEFAULT_BACKLOG;
+    config.pin_cpus = 0;
+    workers = config.reactors;
+    
+    // Verificar argumentos: [puerto] [--io epoll|uring] [--reactors N] [--backlog N] [--pin] [--shards N] [--max-users N] [--idle-timeout S] [--workers N] [--outq-max BYTES] [--outq-global BYTES] [--slow-policy drop|pause|disconnect] [--coalesce-us US] [--coalesce-frames N] [--log-dir DIR] [--log-segment-bytes N] [--log-segment-secs S] [--log-retention-bytes N] [--log-retention-secs S] [--log-fsync-ms MS] [--inbox-max N] [--inbox-total-bytes N] [--inbox-ttl S]
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                if (strcmp(optarg, "epoll") == 0) {
+                    config.backend = IO_EPOLL;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    config.backend = IO_URING;
+                } else {
+                    usage(argv[0]);
+                }
+                break;
+            case 'r':
+                config.reactors = atoi(optarg);
+                break;
+            case 'b':
+                config.backlog = atoi(optarg);
+                break;
+            case 'p':
+                config.pin_cpus = 1;
+                break;
+            case 's':
+                shards = atoi(optarg);
+                break;
+            case 'm':
+                max_users = atoi(optarg);
+                break;
+            case 't':
+                idle_secs = atof(optarg);
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'o':
+                outq_max = strtoul(optarg, NULL, 10);
+                break;
+            case 'g':
+                outq_global = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                if (strcmp(optarg, "drop") == 0) {
+                    slow_policy = SLOW_DROP;
+                } else if (strcmp(optarg, "pause") == 0) {
+                    slow_policy = SLOW_PAUSE;
+                } else if (strcmp(optarg, "disconnect") == 0) {
+                    slow_policy = SLOW_DISCONNECT;
+                } else {
+                    usage(argv[0]);
+                }
+                break;
+            case 'c':
+                coalesce_us = atol(optarg);
+                break;
+            case 'f':
+                coalesce_frames = atol(optarg);
+                break;
+            case 'd':
+                log_dir = optarg;
+                break;
+            case 'S':
+                log_config.segment_bytes = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                log_config.segment_secs = (unsigned)atoi(optarg);
+                break;
+            case 'R':
+                log_config.retention_bytes = atoll(optarg);
+                break;
+            case 'A':
+                log_config.retention_secs = (unsigned)atoi(optarg);
+                break;
+            case 'y':
+                log_config.fsync_ms = (unsigned)atoi(optarg);
+                break;
+            case 'x':
+                inbox_config.max_messages = atoi(optarg);
+                break;
+            case 'B':
+                inbox_config.max_bytes = atoll(optarg);
+                break;
+            case 'u':
+                inbox_config.ttl_secs = (unsigned)atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
     }
-#endif
-
-    int server_fd, client_socket;
-    struct sockaddr_in address;
-    int opt = 1;
-    int addrlen = sizeof(address);
-    pthread_t thread_id, inactivity_thread;
     
-    // Verificar argumentos
-    int port = DEFAULT_PORT;
-    if (argc > 1) {
-        port = atoi(argv[1]);
+    if (optind < argc) {
+        config.port = atoi(argv[optind]);
+    }
+    if (config.reactors < 1 || config.backlog < 1 || max_users < 1 || idle_secs <= 0 || workers < 0 ||
+        outq_max == 0 || outq_global < outq_max || coalesce_us < 0 || coalesce_us > 1000000 ||
+        coalesce_frames < 1 || log_config.segment_bytes < MAX_FRAME_SIZE || log_config.segment_secs < 1 ||
+        log_config.retention_bytes < 0 || log_config.retention_secs < 1 || log_config.fsync_ms < 1 ||
+        log_config.fsync_ms > 1000 || inbox_config.max_messages < 0 || inbox_config.max_bytes < MAX_FRAME_SIZE ||
+        inbox_config.ttl_secs < 1) {
+        usage(argv[0]);
+    }
+    
+    // Un cliente que cierra a mitad de un envío no debe terminar el proceso
+    signal(SIGPIPE, SIG_IGN);
+    
+    // Subir el límite de descriptores al máximo permitido para admitir muchas conexiones
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
     }
     
-    // Crear socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("Error al crear socket");
+    conn_set_limits(outq_max, outq_global, slow_policy);
+    conn_set_coalesce((unsigned)coalesce_us, (unsigned)coalesce_frames);
+    
+    if (users_init(shards, max_users, (unsigned long)(idle_secs * 1000)) < 0) {
         exit(EXIT_FAILURE);
     }
     
-    // Configurar socket
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (char *)&opt, sizeof(opt))) {
-        perror("Error en setsockopt");
+    if (frame_init() < 0) {
+        fprintf(stderr, "Error al crear las reservas de tramas\n");
         exit(EXIT_FAILURE);
     }
     
-    // Configurar dirección
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
+    if (init_replies() < 0) {
+        exit(EXIT_FAILURE);
+    }
     
-    // Vincular socket
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("Error en bind");
+    // El historial de una solicitud no debe llenar por sí solo la cola de salida
+    if (history_bytes > outq_max / 2) {
+        history_bytes = outq_max / 2;
+    }
+    if (log_dir != NULL && open_logs(log_dir, &log_config) < 0) {
         exit(EXIT_FAILURE);
     }
+    if (log_dir != NULL && inbox_config.max_messages > 0) {
+        // Cada trama del vaciado cabe holgada en la mitad de la cola de salida que se le deja
+        char path[4096];
+        if (outq_max / 4 < inbox_config.chunk_bytes) {
+            inbox_config.chunk_bytes = outq_max / 4;
+        }
+        snprintf(path, sizeof(path), "%s/buzones", log_dir);
+        if (inbox_init(path, &inbox_config) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        inbox_enabled = 1;
+    }
     
-    // Escuchar conexiones
-    if (listen(server_fd, 10) < 0) {
-        perror("Error en listen");
+    if (dispatch_init(workers) < 0) {
         exit(EXIT_FAILURE);
     }
     
-    printf("Servidor iniciado en el puerto %d\n", port);
+    if (reactor_init(&config) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    
+    printf("Servidor iniciado en el puerto %d (E/S: %s, reactores: %d, backlog: %d, porciones: %d, máx. usuarios: %d, inactividad: %.1f s, trabajadores: %d)\n",
+           config.port, config.backend == IO_URING ? "io_uring" : "epoll", config.reactors, config.backlog,
+           shards, max_users, idle_secs, workers);
+    if (coalesce_us > 0) {
+        printf("Agrupación de salida: cada conexión espera hasta %ld us o %ld tramas antes de escribirse\n",
+               coalesce_us, coalesce_frames);
+    }
+    if (log_dir != NULL) {
+        printf("Registro de mensajes en %s: segmentos de %zu KiB o %u s, retención %lld MiB o %u s, fsync cada %u ms\n",
+               log_dir, log_config.segment_bytes / 1024, log_config.segment_secs,
+               log_config.retention_bytes / (1024 * 1024), log_config.retention_secs, log_config.fsync_ms);
+    }
+    if (inbox_enabled) {
+        printf("Buzones de DM: hasta %d mensajes por usuario desconectado, %lld MiB en total, caducan a los %u s\n",
+               inbox_config.max_messages, inbox_config.max_bytes / (1024 * 1024), inbox_config.ttl_secs);
+    }
     
     // Iniciar hilo para verificar inactividad
     if (pthread_create(&inactivity_thread, NULL, check_inactivity, NULL) != 0) {
@@ -124,471 +361,844 @@ int main(int argc, char *argv[]) {
         pthread_detach(inactivity_thread);
     }
     
-    // Aceptar conexiones entrantes
-    while (1) {
-        if ((client_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            perror("Error en accept");
-            continue;
-        }
-        
-        // Crear estructura para el cliente
-        client_t *client = malloc(sizeof(client_t));
-        client->socket = client_socket;
-        client->address = address;
-        
-        // Crear un hilo para manejar al cliente
-        if (pthread_create(&thread_id, NULL, handle_client, (void *)client) != 0) {
-            perror("Error al crear hilo");
-            close(client_socket);
-            free(client);
-        } else {
-            pthread_detach(thread_id);
-        }
+    // Cada reactor acepta y lee de sus propios clientes; el hilo principal ejecuta el primero
+    reactor_run();
+    
+    return 0;
+}
+
+// Función para recibir un documento JSON completo de un cliente (hilo de E/S)
+int on_client_message(conn_t *conn, const char *buffer, size_t len) {
+    // Con pool, el análisis y el despacho se hacen en un trabajador
+    if (dispatch_count() > 0) {
+        return dispatch_submit(conn, buffer, len);
     }
     
-    // Cerrar el socket del servidor
-    close(server_fd);
+    wire_request_t *req = parse_request(buffer, len);
+    if (req == NULL) {
+        return -1;
+    }
+    handle_request(conn, req);
+    return 0;
+}
 
-#ifdef _WIN32
-    WSACleanup();
-#endif
+void *on_dispatch_parse(conn_t *conn, const char *data, size_t len) {
+    (void)conn;
+    return parse_request(data, len);
+}
 
-    return 0;
+void on_dispatch_request(conn_t *conn, void *req) {
+    handle_request(conn, req);
 }
 
-// Función para manejar conexiones de clientes
-void *handle_client(void *arg) {
-    client_t *client = (client_t *)arg;
-    int socket_fd = client->socket;
-    struct sockaddr_in address = client->address;
-    char buffer[BUFFER_SIZE] = {0};
-    char ip[INET_ADDRSTRLEN];
+// Función para analizar un documento; debe ocupar exactamente la trama. Se recorre
+// una sola vez y solo se copian los campos que usan los comandos, sin crear nodos.
+// Una trama comprimida se expande antes en el buffer del hilo, que sigue vivo
+// mientras se atiende (los arreglos de un LOTE apuntan a él)
+static wire_request_t *parse_request(const char *buffer, size_t len) {
+    if ((unsigned char)buffer[0] == COMPRESS_MARK) {
+        buffer = decompress_frame(buffer, len, MAX_FRAME_SIZE, &len);
+        if (buffer == NULL || (unsigned char)buffer[0] == COMPRESS_MARK) {
+            fprintf(stderr, "Error en trama comprimida\n");
+            return NULL;
+        }
+    }
+    
+    if (wire_extract(&request, buffer, len, REQUEST_FIELDS) < 0) {
+        // Trama binaria: el primer byte la distingue de un documento JSON
+        fprintf(stderr, buffer[0] == WIRE_MARK ? "Error en trama binaria\n" : "Error en JSON\n");
+        return NULL;
+    }
+    return &request;
+}
 
-    // Obtener IP del cliente (inet_ntop está habilitado con _WIN32_WINNT >= 0x0600)
-    inet_ntop(AF_INET, &(address.sin_addr), ip, INET_ADDRSTRLEN);
-    printf("Nueva conexión desde %s:%d\n", ip, ntohs(address.sin_port));
+// Registro de usuario
+static int cmd_registro(conn_t *conn, const wire_request_t *req) {
+    const char *usuario = req->fields[WIRE_KEY_USUARIO];
+    const char *codificacion = req->fields[WIRE_KEY_CODIFICACION];
+    const char *compresion = req->fields[WIRE_KEY_COMPRESION];
+    
+    if (usuario == NULL || req->fields[WIRE_KEY_DIRECCION_IP] == NULL) {
+        return CMD_IGNORED;
+    }
     
-    free(client);
+    // Codificación y compresión pedidas por el cliente: solo rigen si el registro se
+    // acepta, desde su respuesta. Un rechazo sale en el formato que ya tenía
+    int encoding = codificacion != NULL && strcmp(codificacion, WIRE_MSGPACK_NAME) == 0 ? WIRE_MSGPACK : WIRE_JSON;
+    int compressed = compresion != NULL && strcmp(compresion, COMPRESS_NAME) == 0;
     
-    // Leer mensajes del cliente
-    while (recv(socket_fd, buffer, BUFFER_SIZE, 0) > 0) {
-        // Procesar mensaje JSON
-        cJSON *json = cJSON_Parse(buffer);
-        if (json == NULL) {
-            fprintf(stderr, "Error en JSON\n");
-            goto cleanup;
+    // Hasta que se vacíe su buzón, los DM nuevos para este usuario van detrás de
+    // los pendientes: se marca antes de que el registro lo haga visible
+    int drain = inbox_enabled && conn->user == NULL;
+    if (drain) {
+        __atomic_store_n(&conn->inbox_pending, 1, __ATOMIC_RELEASE);
+    }
+    
+    int result = register_user(usuario, conn->ip, conn, encoding, compressed);
+    
+    // Los DM que esperaban en su buzón llegan después de la respuesta
+    if (result == 0 && drain) {
+        send_reply(conn, REPLY_REGISTERED);
+        if (inbox_drain(usuario) < 0) {
+            __atomic_store_n(&conn->inbox_pending, 0, __ATOMIC_RELEASE);
+        }
+        return CMD_DONE;
+    }
+    if (drain) {
+        __atomic_store_n(&conn->inbox_pending, 0, __ATOMIC_RELEASE);
+    }
+    
+    // Responder al cliente
+    if (result == 2) {
+        return REPLY_NAME_TOO_LONG;
+    }
+    return result == 0 ? REPLY_REGISTERED : REPLY_DUPLICATE;
+}
+
+// Salida de usuario
+static int cmd_exit(conn_t *conn, const wire_request_t *req) {
+    if (req->fields[WIRE_KEY_USUARIO] == NULL) {
+        return CMD_IGNORED;
+    }
+    remove_user(conn);
+    
+    // Responder OK
+    return REPLY_OK;
+}
+
+// Cambio de estado
+static int cmd_estado(conn_t *conn, const wire_request_t *req) {
+    const char *estado = req->fields[WIRE_KEY_ESTADO];
+    
+    if (req->fields[WIRE_KEY_USUARIO] != NULL && estado != NULL) {
+        int status_code;
+        if (strcmp(estado, "ACTIVO") == 0) {
+            status_code = 0;
+        } else if (strcmp(estado, "OCUPADO") == 0) {
+            status_code = 1;
+        } else if (strcmp(estado, "INACTIVO") == 0) {
+            status_code = 2;
+        } else {
+            status_code = -1;
         }
         
-        // Obtener tipo de mensaje
-        cJSON *tipo = cJSON_GetObjectItemCaseSensitive(json, "tipo");
-        cJSON *accion = cJSON_GetObjectItemCaseSensitive(json, "accion");
-        
-        // Procesar según tipo o acción
-        if (tipo != NULL && cJSON_IsString(tipo)) {
-            // Registro de usuario
-            if (strcmp(tipo->valuestring, "REGISTRO") == 0) {
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                cJSON *direccionIP = cJSON_GetObjectItemCaseSensitive(json, "direccionIP");
-                
-                if (usuario != NULL && cJSON_IsString(usuario) &&
-                    direccionIP != NULL && cJSON_IsString(direccionIP)) {
-                    
-                    int result = register_user(usuario->valuestring, ip, socket_fd);
-                    
-                    // Responder al cliente
-                    cJSON *response = cJSON_CreateObject();
-                    if (result == 0) {
-                        cJSON_AddStringToObject(response, "respuesta", "OK");
-                    } else {
-                        cJSON_AddStringToObject(response, "respuesta", "ERROR");
-                        cJSON_AddStringToObject(response, "razon", "Nombre o dirección duplicado");
-                    }
-                    
-                    char *response_str = cJSON_Print(response);
-                    send(socket_fd, response_str, strlen(response_str), 0);
-                    
-                    free(response_str);
-                    cJSON_Delete(response);
-                }
-            }
-            // Salida de usuario
-            else if (strcmp(tipo->valuestring, "EXIT") == 0) {
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                
-                if (usuario != NULL && cJSON_IsString(usuario)) {
-                    remove_user(usuario->valuestring);
-                    
-                    // Responder OK
-                    cJSON *response = cJSON_CreateObject();
-                    cJSON_AddStringToObject(response, "respuesta", "OK");
-                    
-                    char *response_str = cJSON_Print(response);
-                    send(socket_fd, response_str, strlen(response_str), 0);
-                    
-                    free(response_str);
-                    cJSON_Delete(response);
-                }
-            }
-            // Cambio de estado
-            else if (strcmp(tipo->valuestring, "ESTADO") == 0) {
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                cJSON *estado = cJSON_GetObjectItemCaseSensitive(json, "estado");
-                
-                if (usuario != NULL && cJSON_IsString(usuario) &&
-                    estado != NULL && cJSON_IsString(estado)) {
-                    
-                    int status_code;
-                    if (strcmp(estado->valuestring, "ACTIVO") == 0) {
-                        status_code = 0;
-                    } else if (strcmp(estado->valuestring, "OCUPADO") == 0) {
-                        status_code = 1;
-                    } else if (strcmp(estado->valuestring, "INACTIVO") == 0) {
-                        status_code = 2;
-                    } else {
-                        status_code = -1;
-                    }
-                    
-                    if (status_code >= 0) {
-                        change_user_status(usuario->valuestring, status_code);
-                        
-                        // Responder OK
-                        cJSON *response = cJSON_CreateObject();
-                        cJSON_AddStringToObject(response, "respuesta", "OK");
-                        
-                        char *response_str = cJSON_Print(response);
-                        send(socket_fd, response_str, strlen(response_str), 0);
-                        
-                        free(response_str);
-                        cJSON_Delete(response);
-                    } else {
-                        // Estado inválido
-                        cJSON *response = cJSON_CreateObject();
-                        cJSON_AddStringToObject(response, "respuesta", "ERROR");
-                        cJSON_AddStringToObject(response, "razon", "ESTADO_INVALIDO");
-                        
-                        char *response_str = cJSON_Print(response);
-                        send(socket_fd, response_str, strlen(response_str), 0);
-                        
-                        free(response_str);
-                        cJSON_Delete(response);
-                    }
-                }
-            }
-            // Información de usuario
-            else if (strcmp(tipo->valuestring, "MOSTRAR") == 0) {
-                cJSON *usuario = cJSON_GetObjectItemCaseSensitive(json, "usuario");
-                
-                if (usuario != NULL && cJSON_IsString(usuario)) {
-                    get_user_info(usuario->valuestring, socket_fd);
-                }
-            }
-        } else if (accion != NULL && cJSON_IsString(accion)) {
-            // Broadcast
-            if (strcmp(accion->valuestring, "BROADCAST") == 0) {
-                cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
-                cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
-                
-                if (emisor != NULL && cJSON_IsString(emisor) &&
-                    mensaje != NULL && cJSON_IsString(mensaje)) {
-                    
-                    broadcast_message(emisor->valuestring, mensaje->valuestring);
-                    
-                    // Actualizar última actividad
-                    pthread_mutex_lock(&users_mutex);
-                    for (int i = 0; i < user_count; i++) {
-                        if (strcmp(users[i].username, emisor->valuestring) == 0) {
-                            users[i].last_activity = time(NULL);
-                            break;
-                        }
-                    }
-                    pthread_mutex_unlock(&users_mutex);
-                }
-            }
-            // Mensaje directo
-            else if (strcmp(accion->valuestring, "DM") == 0) {
-                cJSON *emisor = cJSON_GetObjectItemCaseSensitive(json, "nombre_emisor");
-                cJSON *destinatario = cJSON_GetObjectItemCaseSensitive(json, "nombre_destinatario");
-                cJSON *mensaje = cJSON_GetObjectItemCaseSensitive(json, "mensaje");
-                
-                if (emisor != NULL && cJSON_IsString(emisor) &&
-                    destinatario != NULL && cJSON_IsString(destinatario) &&
-                    mensaje != NULL && cJSON_IsString(mensaje)) {
-                    
-                    send_direct_message(emisor->valuestring, destinatario->valuestring, mensaje->valuestring);
-                    
-                    // Actualizar última actividad
-                    pthread_mutex_lock(&users_mutex);
-                    for (int i = 0; i < user_count; i++) {
-                        if (strcmp(users[i].username, emisor->valuestring) == 0) {
-                            users[i].last_activity = time(NULL);
-                            break;
-                        }
-                    }
-                    pthread_mutex_unlock(&users_mutex);
-                }
-            }
-            // Lista de usuarios
-            else if (strcmp(accion->valuestring, "LISTA") == 0) {
-                list_users(socket_fd);
-            }
+        if (status_code < 0) {
+            // Estado inválido
+            return REPLY_INVALID_STATUS;
         }
+        change_user_status(conn, status_code);
         
-        cJSON_Delete(json);
-        memset(buffer, 0, BUFFER_SIZE);
+        // Responder OK
+        return REPLY_OK;
     }
+    return CMD_IGNORED;
+}
+
+// Información de usuario
+static int cmd_mostrar(conn_t *conn, const wire_request_t *req) {
+    const char *usuario = req->fields[WIRE_KEY_USUARIO];
     
-cleanup:
-    // El cliente se desconectó, limpieza
-    printf("Cliente desconectado\n");
+    if (usuario == NULL) {
+        return CMD_IGNORED;
+    }
+    get_user_info(usuario, conn);
+    return CMD_DONE;
+}
+
+// Broadcast
+static int cmd_broadcast(conn_t *conn, const wire_request_t *req) {
+    const char *emisor = req->fields[WIRE_KEY_NOMBRE_EMISOR];
+    const char *mensaje = req->fields[WIRE_KEY_MENSAJE];
     
-    // Buscar y eliminar usuario por socket
-    pthread_mutex_lock(&users_mutex);
-    for (int i = 0; i < user_count; i++) {
-        if (users[i].socket == socket_fd) {
-            printf("Eliminando usuario: %s\n", users[i].username);
-            
-            // Mover el último usuario a esta posición
-            if (i < user_count - 1) {
-                users[i] = users[user_count - 1];
-            }
-            
-            // Reducir conteo
-            user_count--;
-            break;
+    if (emisor == NULL || mensaje == NULL) {
+        return CMD_IGNORED;
+    }
+    broadcast_message(emisor, mensaje);
+    
+    // Actualizar última actividad del usuario de esta sesión
+    touch_user(conn);
+    return CMD_DONE;
+}
+
+// Mensaje directo
+static int cmd_dm(conn_t *conn, const wire_request_t *req) {
+    const char *emisor = req->fields[WIRE_KEY_NOMBRE_EMISOR];
+    const char *destinatario = req->fields[WIRE_KEY_NOMBRE_DESTINATARIO];
+    const char *mensaje = req->fields[WIRE_KEY_MENSAJE];
+    
+    if (emisor == NULL || destinatario == NULL || mensaje == NULL) {
+        return CMD_IGNORED;
+    }
+    send_direct_message(emisor, destinatario, mensaje);
+    
+    // Actualizar última actividad del usuario de esta sesión
+    touch_user(conn);
+    return CMD_DONE;
+}
+
+// Lista de usuarios
+static int cmd_lista(conn_t *conn, const wire_request_t *req) {
+    (void)req;
+    list_users(conn);
+    return CMD_DONE;
+}
+
+// Historial de difusiones: los documentos pasan del registro a la cola tal como se
+// guardaron (en JSON, que todo cliente acepta), sin copiarlos, y al final va la
+// respuesta con el rango enviado. "antes" pide los anteriores a una posición
+static int cmd_historia(conn_t *conn, const wire_request_t *req) {
+    frame_t *frames[MSGLOG_READ_FRAMES];
+    const char *antes = req->fields[WIRE_KEY_ANTES];
+    long long from;
+    long long to;
+    
+    if (broadcast_log == NULL) {
+        return REPLY_NO_HISTORY;
+    }
+    
+    int n = msglog_read(broadcast_log, antes != NULL ? atoll(antes) : -1, history_bytes,
+                        frames, MSGLOG_READ_FRAMES, &from, &to);
+    for (int i = 0; i < n; i++) {
+        conn_send_frame(conn, frames[i]);
+        frame_put(frames[i]);
+    }
+    
+    wire_writer_begin(&writer, conn->encoding);
+    wire_begin_object(&writer, WIRE_NO_KEY);
+    wire_add_verb(&writer, WIRE_KEY_ACCION, WIRE_VERB_HISTORIA);
+    wire_add_string(&writer, WIRE_KEY_RESPUESTA, "OK");
+    wire_add_int(&writer, WIRE_KEY_DESDE, from);
+    wire_add_int(&writer, WIRE_KEY_HASTA, to);
+    wire_end_object(&writer);
+    writer_send(conn);
+    return CMD_DONE;
+}
+
+// Lote de operaciones: cada una se atiende igual que si llegara sola, en orden y en
+// esta misma pasada, pero sin su respuesta propia; al final va una sola respuesta
+// con cuántas se procesaron y cuántas se rechazaron
+static int cmd_lote(conn_t *conn, const wire_request_t *req) {
+    wire_items_t items;
+    long long processed = 0;
+    long long rejected = 0;
+    int rc;
+    
+    if (wire_items_begin(&items, req, WIRE_KEY_OPERACIONES) < 0) {
+        return CMD_IGNORED;
+    }
+    
+    // Las operaciones no pueden traer otro lote: no se piden sus arreglos
+    while ((rc = wire_items_next(&items, &operation, REQUEST_FIELDS & ~WIRE_FIELD(WIRE_KEY_OPERACIONES))) != 0) {
+        int result = rc > 0 ? run_command(conn, &operation, 1) : CMD_IGNORED;
+        if (result == CMD_DONE || result == REPLY_OK) {
+            processed++;
+        } else {
+            rejected++;
         }
     }
-    pthread_mutex_unlock(&users_mutex);
     
-    close(socket_fd);
-    return NULL;
+    wire_writer_begin(&writer, conn->encoding);
+    wire_begin_object(&writer, WIRE_NO_KEY);
+    wire_add_verb(&writer, WIRE_KEY_ACCION, WIRE_VERB_LOTE);
+    wire_add_string(&writer, WIRE_KEY_RESPUESTA, "OK");
+    wire_add_int(&writer, WIRE_KEY_PROCESADAS, processed);
+    wire_add_int(&writer, WIRE_KEY_RECHAZADAS, rejected);
+    wire_end_object(&writer);
+    writer_send(conn);
+    return CMD_DONE;
+}
+
+// Tabla de comandos indexada por verbo: cada uno se atiende solo en su campo
+// (tipo o accion), y dentro de un LOTE solo si es de los que se pueden agrupar.
+// Un verbo nuevo se agrega a wire.h y aquí con su función
+static const struct {
+    wire_key_t field;
+    command_fn handler;
+    int batchable;
+} commands[WIRE_VERBS] = {
+    [WIRE_VERB_REGISTRO] = {WIRE_KEY_TIPO, cmd_registro, 0},
+    [WIRE_VERB_EXIT] = {WIRE_KEY_TIPO, cmd_exit, 0},
+    [WIRE_VERB_ESTADO] = {WIRE_KEY_TIPO, cmd_estado, 1},
+    [WIRE_VERB_MOSTRAR] = {WIRE_KEY_TIPO, cmd_mostrar, 0},
+    [WIRE_VERB_BROADCAST] = {WIRE_KEY_ACCION, cmd_broadcast, 1},
+    [WIRE_VERB_DM] = {WIRE_KEY_ACCION, cmd_dm, 1},
+    [WIRE_VERB_LISTA] = {WIRE_KEY_ACCION, cmd_lista, 0},
+    [WIRE_VERB_LOTE] = {WIRE_KEY_ACCION, cmd_lote, 0},
+    [WIRE_VERB_HISTORIA] = {WIRE_KEY_ACCION, cmd_historia, 0},
+};
+
+// Función para ejecutar el comando de una solicitud: un hash del verbo y un salto
+static int run_command(conn_t *conn, const wire_request_t *req, int batched) {
+    // Si hay tipo, manda sobre accion
+    wire_key_t field = req->fields[WIRE_KEY_TIPO] != NULL ? WIRE_KEY_TIPO : WIRE_KEY_ACCION;
+    const char *name = req->fields[field];
+    
+    if (name != NULL) {
+        int verb = wire_verb_lookup(name);
+        if (verb >= 0 && commands[verb].handler != NULL && commands[verb].field == field &&
+            (!batched || commands[verb].batchable)) {
+            return commands[verb].handler(conn, req);
+        }
+    }
+    return CMD_IGNORED;
+}
+
+// Función para atender una solicitud ya analizada y enviar su respuesta fija
+static void handle_request(conn_t *conn, const wire_request_t *req) {
+    int result = run_command(conn, req, 0);
+    if (result >= 0) {
+        send_reply(conn, result);
+    }
+}
+
+// Función para limpiar el usuario asociado a una conexión cerrada
+void on_client_close(conn_t *conn) {
+    // El cliente se desconectó, limpieza
+    printf("Cliente desconectado\n");
+    
+    // Con pool, el cierre se atiende detrás de las solicitudes pendientes de la conexión
+    if (dispatch_count() > 0) {
+        dispatch_close(conn);
+    } else {
+        release_session(conn);
+    }
 }
 
-// Función para verificar inactividad
+void on_dispatch_close(conn_t *conn) {
+    release_session(conn);
+}
+
+// Función para eliminar el usuario de una conexión cerrada
+static void release_session(conn_t *conn) {
+    // Eliminar el usuario de la sesión, si llegó a registrarse
+    if (conn->user != NULL) {
+        printf("Eliminando usuario: %s\n", conn->user->username);
+        users_remove(conn->user);
+        directory_touch();
+    }
+}
+
+// Función para verificar inactividad: cada tick solo se visitan los usuarios cuyo plazo venció
 void *check_inactivity(void *arg) {
     (void)arg;
+    unsigned long next_report = timer_wheel_now() + timer_wheel_ticks(MEMORY_REPORT_SECS * 1000);
+    unsigned long next_pipeline = timer_wheel_now() + timer_wheel_ticks(PIPELINE_REPORT_SECS * 1000);
+    
     while (1) {
-        sleep(60); // Verificar cada minuto
+        usleep(TIMER_TICK_MS * 1000);
         
-        time_t current_time = time(NULL);
+        unsigned long now = timer_wheel_now();
         
-        pthread_mutex_lock(&users_mutex);
-        
-        for (int i = 0; i < user_count; i++) {
-            // Si han pasado más de 5 minutos desde la última actividad
-            if (users[i].status != 2 && difftime(current_time, users[i].last_activity) > 300) {
-                printf("Usuario %s marcado como INACTIVO por inactividad\n", users[i].username);
-                users[i].status = 2; // Marcar como INACTIVO
+        // Avanzar la rueda de cada porción de una en una
+        for (int s = 0; s < users_shard_count(); s++) {
+            user_shard_t *shard = users_shard(s);
+            pthread_mutex_lock(&shard->mutex);
+            
+            timer_node_t *timer = timer_wheel_advance(&shard->idle, now);
+            while (timer != NULL) {
+                timer_node_t *next = timer->next;
+                user_t *user = (user_t *)((char *)timer - offsetof(user_t, idle_timer));
+                
+                printf("Usuario %s marcado como INACTIVO por inactividad\n", user->username);
+                user->status = 2; // Marcar como INACTIVO
+                directory_touch();
                 
                 // Notificar al usuario
-                cJSON *json = cJSON_CreateObject();
-                cJSON_AddStringToObject(json, "tipo", "ESTADO");
-                cJSON_AddStringToObject(json, "usuario", users[i].username);
-                cJSON_AddStringToObject(json, "estado", "INACTIVO");
+                wire_writer_begin(&writer, user->conn->encoding);
+                wire_begin_object(&writer, WIRE_NO_KEY);
+                wire_add_verb(&writer, WIRE_KEY_TIPO, WIRE_VERB_ESTADO);
+                wire_add_string(&writer, WIRE_KEY_USUARIO, user->username);
+                wire_add_string(&writer, WIRE_KEY_ESTADO, "INACTIVO");
+                wire_end_object(&writer);
                 
-                char *json_str = cJSON_Print(json);
-                send(users[i].socket, json_str, strlen(json_str), 0);
+                writer_send(user->conn);
                 
-                free(json_str);
-                cJSON_Delete(json);
+                timer = next;
             }
+            
+            pthread_mutex_unlock(&shard->mutex);
         }
         
-        pthread_mutex_unlock(&users_mutex);
+        // Escribir los avisos ya fuera del candado
+        conn_flush_pending();
+        
+        if ((long)(now - next_report) >= 0) {
+            report_memory();
+            next_report = now + timer_wheel_ticks(MEMORY_REPORT_SECS * 1000);
+        }
+        if ((long)(now - next_pipeline) >= 0) {
+            dispatch_report();
+            conn_report();
+            if (broadcast_log != NULL) {
+                msglog_report(broadcast_log);
+                msglog_report(direct_log);
+            }
+            if (inbox_enabled) {
+                inbox_report();
+            }
+            next_pipeline = now + timer_wheel_ticks(PIPELINE_REPORT_SECS * 1000);
+        }
     }
     
     return NULL;
 }
 
-// Función para registrar un usuario
-int register_user(const char *username, const char *ip, int socket) {
-    int result = 0;
-    
-    pthread_mutex_lock(&users_mutex);
+// Función para registrar un usuario con el formato de salida negociado. Retorna 0 si
+// se registró, 2 si el nombre es demasiado largo y 1 si se rechaza por otro motivo
+int register_user(const char *username, const char *ip, conn_t *conn, int encoding, int compressed) {
+    // Una sesión solo representa a un usuario
+    if (conn->user != NULL) {
+        printf("Rechazo de registro: la conexión ya está registrada como '%s'\n", conn->user->username);
+        return 1;
+    }
     
-    // Verificar si el nombre de usuario ya existe
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            result = 1; // Error, nombre de usuario ya existe
+    switch (users_add(username, ip, conn, encoding, compressed, NULL)) {
+        case USERS_OK:
+            // La LISTA empieza a prepararse comprimida con la versión que publica este registro
+            if (compressed) {
+                __atomic_store_n(&compression_used, 1, __ATOMIC_RELAXED);
+            }
+            directory_touch();
+            printf("Usuario registrado: %s (%s)\n", username, ip);
+            return 0;
+        case USERS_DUPLICATE:
             printf("Rechazo de registro: Nombre de usuario '%s' ya existe\n", username);
-            break;
-        }
+            return 1;
+        case USERS_NAME_TOO_LONG:
+            printf("Rechazo de registro: Nombre de usuario de más de %d caracteres\n", USERS_NAME_SIZE - 1);
+            return 2;
+        default:
+            printf("Rechazo de registro: Máximo de clientes alcanzado\n");
+            return 1;
     }
-    
-    // Si no existe, agregarlo
-    if (result == 0 && user_count < MAX_CLIENTS) {
-        strncpy(users[user_count].username, username, sizeof(users[user_count].username) - 1);
-        users[user_count].username[sizeof(users[user_count].username) - 1] = '\0'; // Garantizar terminación
-        
-        strncpy(users[user_count].ip, ip, sizeof(users[user_count].ip) - 1);
-        users[user_count].ip[sizeof(users[user_count].ip) - 1] = '\0'; // Garantizar terminación
-        
-        users[user_count].socket = socket;
-        users[user_count].status = 0; // ACTIVO
-        users[user_count].last_activity = time(NULL);
-        user_count++;
-        printf("Usuario registrado: %s (%s)\n", username, ip);
-    } else if (user_count >= MAX_CLIENTS) {
-        result = 1; // Error, máximo de clientes alcanzado
-        printf("Rechazo de registro: Máximo de clientes alcanzado\n");
+}
+
+// Función para eliminar el usuario de una sesión
+void remove_user(conn_t *conn) {
+    if (conn->user != NULL) {
+        printf("Usuario eliminado: %s\n", conn->user->username);
+        users_remove(conn->user);
+        directory_touch();
+    }
+}
+
+// Función para cambiar estado del usuario de una sesión
+void change_user_status(conn_t *conn, int status) {
+    user_t *user = conn->user;
+    if (user == NULL) {
+        return;
     }
     
-    pthread_mutex_unlock(&users_mutex);
+    user_shard_t *shard = users_shard(user->shard);
+    pthread_mutex_lock(&shard->mutex);
+    user->status = status;
+    users_touch(user);
+    pthread_mutex_unlock(&shard->mutex);
+    directory_touch();
+}
+
+// Función para registrar actividad del usuario de una sesión
+void touch_user(conn_t *conn) {
+    user_t *user = conn->user;
+    if (user == NULL) {
+        return;
+    }
     
-    return result;
+    user_shard_t *shard = users_shard(user->shard);
+    pthread_mutex_lock(&shard->mutex);
+    users_touch(user);
+    pthread_mutex_unlock(&shard->mutex);
 }
 
-// Función para eliminar un usuario
-void remove_user(const char *username) {
-    pthread_mutex_lock(&users_mutex);
+// Función para informar de la memoria del directorio y las conexiones
+void report_memory(void) {
+    int total = users_total();
+    if (total == 0) {
+        return;
+    }
+    
+    // Registros (usuarios y conexiones) más arreglos e índices de las porciones
+    size_t bytes = slab_total_bytes() + users_index_bytes();
+    size_t per_user = bytes / (size_t)total;
     
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            // Mover el último usuario a esta posición
-            if (i < user_count - 1) {
-                users[i] = users[user_count - 1];
+    printf("Memoria: %d usuarios, %zu KiB, %zu bytes por usuario (presupuesto %d)%s\n",
+           total, bytes / 1024, per_user, MEMORY_BUDGET_PER_USER,
+           per_user > MEMORY_BUDGET_PER_USER ? " EXCEDIDO" : "");
+    slab_report();
+}
+
+// Función para terminar lo escrito en el buffer del hilo, comprimido si se pide y si
+// ahorra bytes (si no, va tal cual: el receptor acepta ambas)
+static const char *writer_finish(int compressed, size_t *len) {
+    const char *data = wire_writer_end(&writer, len);
+    if (data != NULL && compressed) {
+        size_t packed_len;
+        const char *packed = compress_frame(data, *len, &packed_len);
+        if (packed != NULL) {
+            *len = packed_len;
+            return packed;
+        }
+    }
+    return data;
+}
+
+// Función para crear una trama con lo escrito en el buffer del hilo
+static frame_t *writer_frame(int compressed) {
+    size_t len;
+    const char *data = writer_finish(compressed, &len);
+    return data != NULL ? frame_create(data, len) : NULL;
+}
+
+// Función para enviar a un cliente lo escrito en el buffer del hilo
+static void writer_send(conn_t *conn) {
+    size_t len;
+    const char *data = writer_finish(conn->compressed, &len);
+    if (data != NULL) {
+        conn_send(conn, data, len);
+    }
+}
+
+// Función para escribir un mensaje de chat; recipient es NULL en las difusiones
+static void write_chat(wire_encoding_t encoding, wire_verb_t verb, const char *sender,
+                       const char *recipient, const char *message) {
+    wire_writer_begin(&writer, encoding);
+    wire_begin_object(&writer, WIRE_NO_KEY);
+    wire_add_verb(&writer, WIRE_KEY_ACCION, verb);
+    wire_add_string(&writer, WIRE_KEY_NOMBRE_EMISOR, sender);
+    if (recipient != NULL) {
+        wire_add_string(&writer, WIRE_KEY_NOMBRE_DESTINATARIO, recipient);
+    }
+    wire_add_string(&writer, WIRE_KEY_MENSAJE, message);
+    wire_end_object(&writer);
+}
+
+// Función para serializar las respuestas fijas en todos los formatos de salida
+static int init_replies(void) {
+    for (int r = 0; r < N_REPLIES; r++) {
+        for (int f = 0; f < CONN_FORMATS; f++) {
+            int e = f / 2;
+            int compressed = f % 2;
+            wire_writer_begin(&writer, e);
+            wire_begin_object(&writer, WIRE_NO_KEY);
+            wire_add_string(&writer, WIRE_KEY_RESPUESTA, reply_specs[r].respuesta);
+            if (reply_specs[r].razon != NULL) {
+                wire_add_string(&writer, WIRE_KEY_RAZON, reply_specs[r].razon);
+            }
+            if (reply_specs[r].confirms_format && e == WIRE_MSGPACK) {
+                wire_add_string(&writer, WIRE_KEY_CODIFICACION, WIRE_MSGPACK_NAME);
+            }
+            if (reply_specs[r].confirms_format && compressed) {
+                wire_add_string(&writer, WIRE_KEY_COMPRESION, COMPRESS_NAME);
             }
+            wire_end_object(&writer);
             
-            // Reducir conteo
-            user_count--;
-            printf("Usuario eliminado: %s\n", username);
-            break;
+            replies[r][f] = writer_frame(compressed);
+            if (replies[r][f] == NULL) {
+                fprintf(stderr, "Error al preparar las respuestas fijas\n");
+                return -1;
+            }
         }
     }
-    
-    pthread_mutex_unlock(&users_mutex);
+    return 0;
+}
+
+// Función para encolar una respuesta fija: solo se toma una referencia a su trama
+static void send_reply(conn_t *conn, reply_t reply) {
+    conn_send_frame(conn, replies[reply][CONN_FORMAT(conn)]);
 }
 
-// Función para cambiar estado de usuario
-void change_user_status(const char *username, int status) {
-    pthread_mutex_lock(&users_mutex);
+// Función para abrir los registros de mensajes en subdirectorios de dir
+static int open_logs(const char *dir, const msglog_config_t *config) {
+    char path[4096];
     
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            users[i].status = status;
-            users[i].last_activity = time(NULL);
-            break;
-        }
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("Error al crear el directorio de registros");
+        return -1;
     }
     
-    pthread_mutex_unlock(&users_mutex);
+    snprintf(path, sizeof(path), "%s/difusiones", dir);
+    broadcast_log = msglog_open(path, config);
+    snprintf(path, sizeof(path), "%s/directos", dir);
+    direct_log = msglog_open(path, config);
+    return broadcast_log != NULL && direct_log != NULL ? 0 : -1;
 }
 
 // Función para transmitir mensaje a todos
 void broadcast_message(const char *sender, const char *message) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "accion", "BROADCAST");
-    cJSON_AddStringToObject(json, "nombre_emisor", sender);
-    cJSON_AddStringToObject(json, "mensaje", message);
-    
-    char *json_str = cJSON_Print(json);
-    
-    pthread_mutex_lock(&users_mutex);
+    // Una sola trama por formato compartida por todas las colas: sin copia por
+    // destinatario. Cada una se serializa (y comprime) la primera vez que un
+    // destinatario la necesita
+    frame_t *frames[CONN_FORMATS] = {NULL};
     
-    for (int i = 0; i < user_count; i++) {
-        send(users[i].socket, json_str, strlen(json_str), 0);
+    // Bajo cada candado solo se encola; la escritura ocurre al final del lote del reactor.
+    // Se recorre una porción a la vez para no frenar a las demás
+    for (int s = 0; s < users_shard_count(); s++) {
+        user_shard_t *shard = users_shard(s);
+        pthread_mutex_lock(&shard->mutex);
+        
+        for (int i = 0; i < shard->count; i++) {
+            conn_t *conn = shard->users[i]->conn;
+            int f = CONN_FORMAT(conn);
+            if (frames[f] == NULL) {
+                write_chat(conn->encoding, WIRE_VERB_BROADCAST, sender, NULL, message);
+                frames[f] = writer_frame(conn->compressed);
+                if (frames[f] == NULL) {
+                    continue;
+                }
+                frames[f]->droppable = 1;  // Un cliente lento puede perder difusiones antiguas
+            }
+            conn_send_frame(conn, frames[f]);
+        }
+        
+        pthread_mutex_unlock(&shard->mutex);
     }
     
-    pthread_mutex_unlock(&users_mutex);
+    // El registro se alimenta después de repartir: solo toma una referencia al
+    // documento JSON (que se arma aquí si ningún destinatario lo usó)
+    if (broadcast_log != NULL) {
+        if (frames[0] == NULL) {
+            write_chat(WIRE_JSON, WIRE_VERB_BROADCAST, sender, NULL, message);
+            frames[0] = writer_frame(0);
+        }
+        if (frames[0] != NULL) {
+            msglog_append(broadcast_log, frames[0]);
+        }
+    }
     
-    free(json_str);
-    cJSON_Delete(json);
+    for (int f = 0; f < CONN_FORMATS; f++) {
+        if (frames[f] != NULL) {
+            frame_put(frames[f]);
+        }
+    }
 }
 
 // Función para mensaje directo
 void send_direct_message(const char *sender, const char *recipient, const char *message) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "accion", "DM");
-    cJSON_AddStringToObject(json, "nombre_emisor", sender);
-    cJSON_AddStringToObject(json, "nombre_destinatario", recipient);
-    cJSON_AddStringToObject(json, "mensaje", message);
+    // Solo se bloquea la porción del destinatario, y solo para encontrarlo: la
+    // referencia a su conexión permite serializar en su codificación fuera del candado
+    user_shard_t *shard = users_shard_of(recipient);
+    pthread_mutex_lock(&shard->mutex);
+    
+    user_t *user = users_find(shard, recipient);
+    conn_t *conn = user != NULL ? user->conn : NULL;
+    int via_inbox = 0;
+    if (conn != NULL) {
+        conn_get(conn);
+        
+        // Con el vaciado de su buzón en curso, el DM va detrás de los pendientes
+        via_inbox = __atomic_load_n(&conn->inbox_pending, __ATOMIC_ACQUIRE);
+        if (via_inbox) {
+            __atomic_add_fetch(&conn->inbox_queued, 1, __ATOMIC_RELEASE);
+        }
+    }
     
-    char *json_str = cJSON_Print(json);
+    pthread_mutex_unlock(&shard->mutex);
     
-    pthread_mutex_lock(&users_mutex);
+    // Se guarda aunque el destinatario no esté conectado; si no lo está, además
+    // queda en su buzón hasta que se registre. Un nombre que no cabe no puede
+    // haberse registrado nunca: no tiene buzón
+    int to_inbox = via_inbox || (conn == NULL && inbox_enabled && strlen(recipient) < USERS_NAME_SIZE);
+    if (direct_log != NULL || to_inbox) {
+        write_chat(WIRE_JSON, WIRE_VERB_DM, sender, recipient, message);
+        frame_t *frame = writer_frame(0);
+        if (frame != NULL) {
+            if (direct_log != NULL) {
+                msglog_append(direct_log, frame);
+            }
+            if (to_inbox && inbox_store(recipient, frame, via_inbox ? conn : NULL) < 0 && via_inbox) {
+                // Cola del buzón llena: mejor adelantarse que perderlo
+                __atomic_sub_fetch(&conn->inbox_queued, 1, __ATOMIC_RELEASE);
+                via_inbox = 0;
+            }
+            frame_put(frame);
+        }
+    }
     
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, recipient) == 0) {
-            send(users[i].socket, json_str, strlen(json_str), 0);
-            break;
+    if (conn != NULL) {
+        if (!via_inbox) {
+            write_chat(conn->encoding, WIRE_VERB_DM, sender, recipient, message);
+            writer_send(conn);
         }
+        conn_put(conn);
     }
+}
+
+// Función para encontrar la conexión de un usuario registrado (hilo del buzón)
+conn_t *on_inbox_find(const char *username) {
+    user_shard_t *shard = users_shard_of(username);
+    pthread_mutex_lock(&shard->mutex);
     
-    pthread_mutex_unlock(&users_mutex);
+    user_t *user = users_find(shard, username);
+    conn_t *conn = user != NULL ? user->conn : NULL;
+    if (conn != NULL) {
+        conn_get(conn);
+    }
     
-    free(json_str);
-    cJSON_Delete(json);
+    pthread_mutex_unlock(&shard->mutex);
+    return conn;
 }
 
-// Función para listar usuarios
-void list_users(int client_socket) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON *usuarios = cJSON_CreateArray();
+// Función para terminar el vaciado del buzón de un usuario (hilo del buzón): solo
+// si no quedan DM desviados en camino, bajo el mismo candado con que se desvían
+int on_inbox_drained(const char *username, conn_t *conn) {
+    user_shard_t *shard = users_shard_of(username);
+    pthread_mutex_lock(&shard->mutex);
+    
+    int done = __atomic_load_n(&conn->inbox_queued, __ATOMIC_ACQUIRE) == 0;
+    if (done) {
+        __atomic_store_n(&conn->inbox_pending, 0, __ATOMIC_RELEASE);
+    }
     
-    cJSON_AddStringToObject(json, "accion", "LISTA");
+    pthread_mutex_unlock(&shard->mutex);
+    return done;
+}
+
+// Función para construir y publicar una instantánea del directorio (directory_mutex tomado)
+static void publish_directory(void) {
+    unsigned long version = directory_version();
+    if (version == published_version) {
+        return;
+    }
+    
+    // Tomar todas las porciones en orden para copiar un estado coherente
+    int n_shards = users_shard_count();
+    for (int s = 0; s < n_shards; s++) {
+        pthread_mutex_lock(&users_shard(s)->mutex);
+    }
+    
+    dir_snapshot_t *snapshot = directory_alloc((size_t)users_total());
+    if (snapshot == NULL) {
+        for (int s = n_shards - 1; s >= 0; s--) {
+            pthread_mutex_unlock(&users_shard(s)->mutex);
+        }
+        return;
+    }
+    snapshot->version = version;
     
-    pthread_mutex_lock(&users_mutex);
+    size_t n = 0;
+    for (int s = 0; s < n_shards; s++) {
+        user_shard_t *shard = users_shard(s);
+        for (int i = 0; i < shard->count && n < snapshot->count; i++) {
+            user_t *user = shard->users[i];
+            dir_entry_t *e = &snapshot->entries[n++];
+            memcpy(e->username, user->username, sizeof(e->username));
+            memcpy(e->ip, user->ip, sizeof(e->ip));
+            e->status = user->status;
+        }
+    }
+    snapshot->count = n;
+    
+    for (int s = n_shards - 1; s >= 0; s--) {
+        pthread_mutex_unlock(&users_shard(s)->mutex);
+    }
+    
+    // La respuesta LISTA se serializa una vez por versión y la comparten todos los
+    // lectores. Las variantes comprimidas solo se preparan si alguien las usa
+    int failed = 0;
+    int compress_too = __atomic_load_n(&compression_used, __ATOMIC_RELAXED);
+    for (int f = 0; f < CONN_FORMATS; f++) {
+        int compressed = f % 2;
+        if (compressed && !compress_too) {
+            continue;
+        }
+        wire_writer_begin(&writer, f / 2);
+        wire_begin_object(&writer, WIRE_NO_KEY);
+        wire_add_verb(&writer, WIRE_KEY_ACCION, WIRE_VERB_LISTA);
+        wire_begin_array(&writer, WIRE_KEY_USUARIOS);
+        for (size_t i = 0; i < snapshot->count; i++) {
+            wire_add_string(&writer, WIRE_NO_KEY, snapshot->entries[i].username);
+        }
+        wire_end_array(&writer);
+        wire_end_object(&writer);
+        
+        snapshot->lista[f] = writer_frame(compressed);
+        failed |= snapshot->lista[f] == NULL;
+    }
     
-    for (int i = 0; i < user_count; i++) {
-        cJSON_AddItemToArray(usuarios, cJSON_CreateString(users[i].username));
+    if (failed) {
+        for (int f = 0; f < CONN_FORMATS; f++) {
+            if (snapshot->lista[f] != NULL) {
+                frame_put(snapshot->lista[f]);
+            }
+        }
+        free(snapshot);
+        return;
     }
+    directory_publish(snapshot);
+    published_version = version;
+}
+
+// Función para abrir una lectura del directorio con una instantánea al día;
+// solo la primera lectura tras un cambio toma los candados para reconstruirla
+static const dir_snapshot_t *read_directory(void) {
+    const dir_snapshot_t *snapshot = directory_read_begin();
+    if (snapshot != NULL && snapshot->version == directory_version()) {
+        return snapshot;
+    }
+    directory_read_end();
     
-    pthread_mutex_unlock(&users_mutex);
+    pthread_mutex_lock(&directory_mutex);
+    publish_directory();
+    pthread_mutex_unlock(&directory_mutex);
     
-    cJSON_AddItemToObject(json, "usuarios", usuarios);
+    return directory_read_begin();
+}
+
+// Función para listar usuarios
+void list_users(conn_t *client) {
+    const dir_snapshot_t *snapshot = read_directory();
     
-    char *json_str = cJSON_Print(json);
-    send(client_socket, json_str, strlen(json_str), 0);
+    if (snapshot != NULL) {
+        // Sin variante comprimida (la instantánea es anterior a la primera conexión
+        // que la pidió) va la de su codificación sin comprimir
+        frame_t *lista = snapshot->lista[CONN_FORMAT(client)];
+        conn_send_frame(client, lista != NULL ? lista : snapshot->lista[client->encoding * 2]);
+    }
     
-    free(json_str);
-    cJSON_Delete(json);
+    directory_read_end();
 }
 
 // Función para mostrar información de usuario
-void get_user_info(const char *username, int client_socket) {
-    cJSON *json = cJSON_CreateObject();
+void get_user_info(const char *username, conn_t *client) {
     int found = 0;
     
-    pthread_mutex_lock(&users_mutex);
-    
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0) {
-            const char *status_str;
-            switch (users[i].status) {
-                case 0:
-                    status_str = "ACTIVO";
-                    break;
-                case 1:
-                    status_str = "OCUPADO";
-                    break;
-                case 2:
-                    status_str = "INACTIVO";
-                    break;
-                default:
-                    status_str = "DESCONOCIDO";
-                    break;
-            }
-            
-            cJSON_AddStringToObject(json, "tipo", "MOSTRAR");
-            cJSON_AddStringToObject(json, "usuario", username);
-            cJSON_AddStringToObject(json, "direccionIP", users[i].ip);
-            cJSON_AddStringToObject(json, "estado", status_str);
-            found = 1;
-            break;
+    const dir_snapshot_t *snapshot = read_directory();
+    
+    const dir_entry_t *e = snapshot != NULL ? directory_find(snapshot, username) : NULL;
+    if (e != NULL) {
+        const char *status_str;
+        switch (e->status) {
+            case 0:
+                status_str = "ACTIVO";
+                break;
+            case 1:
+                status_str = "OCUPADO";
+                break;
+            case 2:
+                status_str = "INACTIVO";
+                break;
+            default:
+                status_str = "DESCONOCIDO";
+                break;
         }
+        
+        // Se escribe mientras la instantánea sigue abierta: e apunta dentro de ella
+        wire_writer_begin(&writer, client->encoding);
+        wire_begin_object(&writer, WIRE_NO_KEY);
+        wire_add_verb(&writer, WIRE_KEY_TIPO, WIRE_VERB_MOSTRAR);
+        wire_add_string(&writer, WIRE_KEY_USUARIO, username);
+        wire_add_string(&writer, WIRE_KEY_DIRECCION_IP, e->ip);
+        wire_add_string(&writer, WIRE_KEY_ESTADO, status_str);
+        wire_end_object(&writer);
+        found = 1;
     }
     
-    pthread_mutex_unlock(&users_mutex);
+    directory_read_end();
     
     if (!found) {
-        cJSON_Delete(json);
-        json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "respuesta", "ERROR");
-        cJSON_AddStringToObject(json, "razon", "USUARIO_NO_ENCONTRADO");
+        send_reply(client, REPLY_USER_NOT_FOUND);
+        return;
     }
     
-    char *json_str = cJSON_Print(json);
-    send(client_socket, json_str, strlen(json_str), 0);
-    
-    free(json_str);
-    cJSON_Delete(json);
+    writer_send(client);
 }
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "slab.h"
+
+// Cabecera al inicio de cada bloque; el bloque de un objeto se obtiene alineando su dirección
+typedef struct slab {
+    slab_cache_t *cache;
+    struct slab *prev;
+    struct slab *next;
+    void *free_list;
+    unsigned used;
+    unsigned fresh;         // Objetos nunca entregados al final del bloque
+} slab_t;
+
+#define SLAB_HEADER ((sizeof(slab_t) + 63) & ~(size_t)63)
+
+static slab_cache_t *caches;
+static pthread_mutex_t caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+slab_cache_t *slab_cache_create(const char *name, size_t obj_size) {
+    slab_cache_t *cache = calloc(1, sizeof(slab_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    // Objetos alineados a 16 bytes y con espacio para el enlace de la lista libre
+    obj_size = (obj_size + 15) & ~(size_t)15;
+    cache->name = name;
+    cache->obj_size = obj_size;
+    cache->per_slab = (unsigned)((SLAB_SIZE - SLAB_HEADER) / obj_size);
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    pthread_mutex_lock(&caches_mutex);
+    cache->next = caches;
+    caches = cache;
+    pthread_mutex_unlock(&caches_mutex);
+    return cache;
+}
+
+// Función para pedir al sistema un bloque alineado a su tamaño
+static slab_t *slab_create(slab_cache_t *cache) {
+    char *raw = mmap(NULL, SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Recortar el exceso para que el bloque quede alineado
+    uintptr_t start = ((uintptr_t)raw + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1);
+    size_t head = start - (uintptr_t)raw;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    munmap((char *)start + SLAB_SIZE, SLAB_SIZE - head);
+
+    slab_t *slab = (slab_t *)start;
+    slab->cache = cache;
+    slab->prev = slab->next = NULL;
+    slab->free_list = NULL;
+    slab->used = 0;
+    slab->fresh = 0;
+    cache->slabs++;
+    return slab;
+}
+
+static void list_remove(slab_cache_t *cache, slab_t *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->partial = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+static void list_push(slab_cache_t *cache, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = cache->partial;
+    if (cache->partial != NULL) {
+        cache->partial->prev = slab;
+    }
+    cache->partial = slab;
+}
+
+// Función para entregar un objeto, creciendo por bloques según la demanda
+void *slab_alloc(slab_cache_t *cache) {
+    void *obj;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    slab_t *slab = cache->partial;
+    if (slab == NULL) {
+        if (cache->spare != NULL) {
+            slab = cache->spare;
+            cache->spare = NULL;
+        } else if ((slab = slab_create(cache)) == NULL) {
+            pthread_mutex_unlock(&cache->mutex);
+            return NULL;
+        }
+        list_push(cache, slab);
+    }
+
+    if (slab->free_list != NULL) {
+        obj = slab->free_list;
+        slab->free_list = *(void **)obj;
+    } else {
+        obj = (char *)slab + SLAB_HEADER + (size_t)slab->fresh * cache->obj_size;
+        slab->fresh++;
+    }
+    slab->used++;
+    cache->in_use++;
+
+    if (slab->used == cache->per_slab) {
+        list_remove(cache, slab);   // Lleno: sale de la lista hasta que se libere algo
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    memset(obj, 0, cache->obj_size);
+    return obj;
+}
+
+// Función para devolver un objeto; los bloques vacíos vuelven al sistema
+void slab_free(void *obj) {
+    if (obj == NULL) {
+        return;
+    }
+
+    slab_t *slab = (slab_t *)((uintptr_t)obj & ~(uintptr_t)(SLAB_SIZE - 1));
+    slab_cache_t *cache = slab->cache;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    if (slab->used == cache->per_slab) {
+        list_push(cache, slab);
+    }
+    *(void **)obj = slab->free_list;
+    slab->free_list = obj;
+    slab->used--;
+    cache->in_use--;
+
+    if (slab->used == 0) {
+        list_remove(cache, slab);
+        slab->free_list = NULL;
+        slab->fresh = 0;
+        if (cache->spare == NULL) {
+            cache->spare = slab;
+        } else {
+            munmap(slab, SLAB_SIZE);
+            cache->slabs--;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+size_t slab_total_bytes(void) {
+    size_t total = 0;
+
+    pthread_mutex_lock(&caches_mutex);
+    for (slab_cache_t *c = caches; c != NULL; c = c->next) {
+        total += __atomic_load_n(&c->slabs, __ATOMIC_RELAXED) * SLAB_SIZE;
+    }
+    pthread_mutex_unlock(&caches_mutex);
+    return total;
+}
+
+void slab_report(void) {
+    pthread_mutex_lock(&caches_mutex);
+    for (slab_cache_t *c = caches; c != NULL; c = c->next) {
+        pthread_mutex_lock(&c->mutex);
+        printf("  %-10s %8zu objetos de %4zu bytes en %5zu bloques (%zu KiB)\n",
+               c->name, c->in_use, c->obj_size, c->slabs, c->slabs * SLAB_SIZE / 1024);
+        pthread_mutex_unlock(&c->mutex);
+    }
+    pthread_mutex_unlock(&caches_mutex);
+}
@@ -0,0 +1,39 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SLAB_SIZE (64 * 1024)   // Tamaño y alineación de cada bloque de objetos
+
+struct slab;
+
+// Reserva de objetos de tamaño fijo que crece por bloques y los devuelve al vaciarse
+typedef struct slab_cache {
+    const char *name;
+    size_t obj_size;
+    unsigned per_slab;          // Objetos que caben en un bloque
+    pthread_mutex_t mutex;
+    struct slab *partial;       // Bloques con objetos libres
+    struct slab *spare;         // Un bloque vacío guardado para evitar oscilaciones
+    size_t slabs;               // Bloques reservados (incluido el de reserva)
+    size_t in_use;              // Objetos entregados
+    struct slab_cache *next;    // Registro global para los informes de memoria
+} slab_cache_t;
+
+// Crea una reserva para objetos del tamaño indicado
+slab_cache_t *slab_cache_create(const char *name, size_t obj_size);
+
+// Entrega un objeto puesto a cero, o NULL sin memoria
+void *slab_alloc(slab_cache_t *cache);
+
+// Devuelve un objeto a la reserva de la que salió
+void slab_free(void *obj);
+
+// Bytes reservados por todos los bloques de todas las reservas
+size_t slab_total_bytes(void);
+
+// Imprime una línea por reserva: objetos en uso, bloques y bytes
+void slab_report(void);
+
+#endif
@@ -0,0 +1,112 @@
+#include <time.h>
+#include "timer_wheel.h"
+
+#define LEVEL_SHIFT(level) (TIMER_LEVEL_BITS * (level))
+#define SLOT_MASK (TIMER_SLOTS - 1)
+#define MAX_DELTA ((1UL << LEVEL_SHIFT(TIMER_LEVELS)) - 1)
+
+unsigned long timer_wheel_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long)ts.tv_sec * 1000 + (unsigned long)ts.tv_nsec / 1000000) / TIMER_TICK_MS;
+}
+
+unsigned long timer_wheel_ticks(unsigned long ms) {
+    unsigned long ticks = (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    return ticks ? ticks : 1;
+}
+
+void timer_wheel_init(timer_wheel_t *wheel, unsigned long now) {
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_SLOTS; slot++) {
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+    wheel->now = now;
+}
+
+// Función para enlazar un temporizador en la ranura que le toca según lo que falta para vencer
+static void place(timer_wheel_t *wheel, timer_node_t *timer) {
+    unsigned long delta = timer->expires - wheel->now;
+    int level = 0;
+
+    while (level < TIMER_LEVELS - 1 && delta >= (1UL << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+
+    timer_node_t **head = &wheel->slots[level][(timer->expires >> LEVEL_SHIFT(level)) & SLOT_MASK];
+    timer->next = *head;
+    if (timer->next != NULL) {
+        timer->next->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_node_t *timer, unsigned long expires) {
+    timer_wheel_cancel(timer);
+
+    // Un plazo ya pasado vence en el próximo tick; uno demasiado lejano se acota
+    if ((long)(expires - wheel->now) <= 0) {
+        expires = wheel->now + 1;
+    } else if (expires - wheel->now > MAX_DELTA) {
+        expires = wheel->now + MAX_DELTA;
+    }
+    timer->expires = expires;
+    place(wheel, timer);
+}
+
+void timer_wheel_cancel(timer_node_t *timer) {
+    if (timer->pprev == NULL) {
+        return;
+    }
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// Función para redistribuir una ranura de un nivel superior cuando su intervalo empieza
+static void cascade(timer_wheel_t *wheel, int level) {
+    timer_node_t **head = &wheel->slots[level][(wheel->now >> LEVEL_SHIFT(level)) & SLOT_MASK];
+    timer_node_t *timer = *head;
+
+    *head = NULL;
+    while (timer != NULL) {
+        timer_node_t *next = timer->next;
+        place(wheel, timer);
+        timer = next;
+    }
+}
+
+timer_node_t *timer_wheel_advance(timer_wheel_t *wheel, unsigned long now) {
+    timer_node_t *expired = NULL;
+    timer_node_t **tail = &expired;
+
+    while ((long)(now - wheel->now) > 0) {
+        wheel->now++;
+
+        // Al completar una vuelta del nivel inferior, bajar la ranura siguiente del superior
+        for (int level = 1; level < TIMER_LEVELS; level++) {
+            if ((wheel->now & ((1UL << LEVEL_SHIFT(level)) - 1)) != 0) {
+                break;
+            }
+            cascade(wheel, level);
+        }
+
+        // Todo lo que queda en la ranura del nivel 0 vence en este tick
+        timer_node_t **head = &wheel->slots[0][wheel->now & SLOT_MASK];
+        timer_node_t *timer = *head;
+        *head = NULL;
+        while (timer != NULL) {
+            timer->pprev = NULL;
+            *tail = timer;
+            tail = &timer->next;
+            timer = timer->next;
+        }
+    }
+
+    return expired;
+}
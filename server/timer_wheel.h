@@ -0,0 +1,39 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#define TIMER_TICK_MS 100       // Resolución de la rueda
+#define TIMER_LEVEL_BITS 6
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVELS 5          // 64^5 ticks: plazos de hasta ~3 años
+
+// Temporizador intrusivo: se incrusta en el registro que vigila
+typedef struct timer_node {
+    struct timer_node *next;
+    struct timer_node **pprev;  // NULL: no programado
+    unsigned long expires;      // Tick de vencimiento
+} timer_node_t;
+
+// Rueda jerárquica: el nivel n tiene ranuras de 64^n ticks; los plazos lejanos bajan de nivel al acercarse
+typedef struct {
+    unsigned long now;          // Último tick procesado
+    timer_node_t *slots[TIMER_LEVELS][TIMER_SLOTS];
+} timer_wheel_t;
+
+// Tick actual del reloj monótono
+unsigned long timer_wheel_now(void);
+
+// Convierte milisegundos en ticks (al menos uno)
+unsigned long timer_wheel_ticks(unsigned long ms);
+
+void timer_wheel_init(timer_wheel_t *wheel, unsigned long now);
+
+// Programa o reprograma un temporizador en O(1)
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_node_t *timer, unsigned long expires);
+
+// Desprograma un temporizador; no hace nada si no estaba programado
+void timer_wheel_cancel(timer_node_t *timer);
+
+// Avanza la rueda hasta el tick indicado y retorna los vencidos, ya desprogramados, encadenados por next
+timer_node_t *timer_wheel_advance(timer_wheel_t *wheel, unsigned long now);
+
+#endif
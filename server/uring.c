@@ -0,0 +1,621 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "reactor.h"
+#include "uring.h"
+#include "slab.h"
+
+// Tipo de operación codificado en los bits bajos de user_data
+#define OP_ACCEPT 1
+#define OP_RECV   2
+#define OP_SEND   3
+#define OP_CANCEL 4
+#define OP_WAKE   5
+#define OP_MASK   7
+
+// Conexión del backend io_uring: estado común más el sendmsg en vuelo
+typedef struct uconn {
+    conn_t base;
+    struct iovec iov[URING_SEND_IOV];   // Tramas del envío en vuelo (apuntan a la cola)
+    struct msghdr msg;
+    int recv_armed;
+    int recv_cancelling;                // Recv cancelado por pausa, a la espera de su fin
+    int sending;
+    int closing;
+    int dirty;
+    struct uconn *next_dirty;
+    int handoff_queued;                 // Protegido por handoff_mutex del anillo dueño
+    struct uconn *next_handoff;
+} uconn_t;
+
+// Anillo io_uring de un reactor: colas, buffers provistos y socket de escucha propios
+typedef struct {
+    int id;
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_buf_ring *buf_ring;
+    char *buf_base;
+    int listen_fd;
+    int wake_fd;
+    uint64_t wake_value;
+    uconn_t *dirty_head;
+    pthread_mutex_t handoff_mutex;      // Conexiones con salida encolada desde otros hilos
+    uconn_t *handoff_head;
+    uconn_t *handoff_tail;
+    pthread_t thread;
+} uring_t;
+
+static uring_t *rings;
+static int n_rings;
+static __thread uring_t *ring;      // Anillo del hilo actual (NULL fuera de los reactores)
+static slab_cache_t *uconn_cache;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Función para entregar al kernel las SQE preparadas (y opcionalmente esperar, como
+// mucho wait_ns si no es -1)
+static int ring_enter(unsigned min_complete, long long wait_ns) {
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void *argp = NULL;
+    size_t argsz = 0;
+
+    if (min_complete && wait_ns >= 0) {
+        ts.tv_sec = wait_ns / 1000000000;
+        ts.tv_nsec = wait_ns % 1000000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    while (1) {
+        int ret = sys_io_uring_enter(ring->fd, ring->to_submit, min_complete, flags, argp, argsz);
+        if (ret >= 0) {
+            ring->to_submit = 0;
+            return ret;
+        }
+        if (errno == ETIME) {
+            return 0;   // Venció la espera sin completaciones
+        }
+        if (errno != EINTR) {
+            perror("Error en io_uring_enter");
+            return -1;
+        }
+    }
+}
+
+// Función para obtener una SQE libre, vaciando la cola si está llena
+static struct io_uring_sqe *get_sqe(void) {
+    while (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        if (ring_enter(0, -1) < 0) {
+            return NULL;
+        }
+    }
+
+    unsigned idx = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+static uint64_t make_tag(void *ptr, int op) {
+    return (uint64_t)(uintptr_t)ptr | (uint64_t)op;
+}
+
+// Función para devolver un buffer al anillo de buffers provistos
+static void recycle_buffer(unsigned bid) {
+    unsigned short tail = ring->buf_ring->tail;
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[tail & (URING_BUFFERS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(ring->buf_base + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = (unsigned short)bid;
+    __atomic_store_n(&ring->buf_ring->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static void arm_accept(void) {
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = ring->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = make_tag(NULL, OP_ACCEPT);
+}
+
+static void arm_recv(uconn_t *c) {
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->base.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = make_tag(c, OP_RECV);
+    c->recv_armed = 1;
+    c->recv_cancelling = 0;
+}
+
+// Función para cancelar el recv multishot de una conexión
+static void cancel_recv(uconn_t *c) {
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = make_tag(c, OP_RECV);
+    sqe->user_data = make_tag(NULL, OP_CANCEL);
+    c->recv_cancelling = 1;
+}
+
+static int recv_paused(uconn_t *c) {
+    return __atomic_load_n(&c->base.in_paused, __ATOMIC_ACQUIRE);
+}
+
+static void arm_wake(void) {
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == NULL) {
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = ring->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->wake_value;
+    sqe->len = sizeof(ring->wake_value);
+    sqe->user_data = make_tag(NULL, OP_WAKE);
+}
+
+static void mark_dirty(uconn_t *c) {
+    if (!c->dirty) {
+        c->dirty = 1;
+        c->next_dirty = ring->dirty_head;
+        ring->dirty_head = c;
+    }
+}
+
+// Función para iniciar el cierre de una conexión; se libera al terminar sus operaciones
+static void close_uconn(uconn_t *c) {
+    if (c->closing) {
+        // Ya cerrándose: la operación que terminó pudo ser la última en vuelo, y
+        // solo flush_dirty() suelta la referencia del anillo
+        mark_dirty(c);
+        return;
+    }
+    c->closing = 1;
+    on_client_close(&c->base);
+    conn_shutdown(&c->base);
+
+    if (c->recv_armed && !c->recv_cancelling) {
+        cancel_recv(c);
+    }
+
+    // Las operaciones en vuelo conservan su referencia al socket
+    close(c->base.fd);
+    mark_dirty(c);
+}
+
+// Función para enviar de una vez las primeras tramas de la cola de una conexión
+static void start_send(uconn_t *c) {
+    // Solo este hilo retira tramas y las que quedan en vuelo no se descartan, así que los
+    // iovec siguen válidos tras soltar el mutex
+    pthread_mutex_lock(&c->base.out_mutex);
+    int n_iov = conn_out_iov(&c->base, c->iov, URING_SEND_IOV);
+    c->base.out_inflight = (unsigned)n_iov;
+    pthread_mutex_unlock(&c->base.out_mutex);
+    if (n_iov == 0) {
+        return;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe();
+    if (sqe == NULL) {
+        return;
+    }
+    memset(&c->msg, 0, sizeof(c->msg));
+    c->msg.msg_iov = c->iov;
+    c->msg.msg_iovlen = (size_t)n_iov;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->base.fd;
+    sqe->addr = (uint64_t)(uintptr_t)&c->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = make_tag(c, OP_SEND);
+    c->sending = 1;
+}
+
+// Función para preparar los envíos de todas las conexiones con salida pendiente
+static void flush_dirty(void) {
+    uconn_t *c = ring->dirty_head;
+    ring->dirty_head = NULL;
+
+    while (c != NULL) {
+        uconn_t *next = c->next_dirty;
+        c->dirty = 0;
+
+        if (c->closing) {
+            if (!c->recv_armed && !c->sending) {
+                conn_put(&c->base);     // Referencia del anillo dueño
+            }
+        } else {
+            if (!c->sending) {
+                start_send(c);
+            }
+            if (!c->recv_armed && !recv_paused(c)) {
+                arm_recv(c);    // Lectura reanudada tras una pausa
+            }
+        }
+        c = next;
+    }
+}
+
+// Función para registrar una conexión recién aceptada
+static void handle_accept(int fd) {
+    struct sockaddr_in address;
+    socklen_t addrlen = sizeof(address);
+
+    uconn_t *c = slab_alloc(uconn_cache);
+    if (c == NULL) {
+        close(fd);
+        return;
+    }
+    set_nodelay(fd);
+    if (getpeername(fd, (struct sockaddr *)&address, &addrlen) == 0) {
+        conn_init(&c->base, fd, &address, ring->id);
+    } else {
+        conn_init(&c->base, fd, NULL, ring->id);
+    }
+
+    printf("Nueva conexión desde %s:%d (reactor %d)\n", c->base.ip, c->base.port, ring->id);
+    arm_recv(c);
+}
+
+// Función para procesar una completación de recv multishot
+static void handle_recv(uconn_t *c, struct io_uring_cqe *cqe) {
+    int more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (!more) {
+        c->recv_armed = 0;
+    }
+
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        char *data = ring->buf_base + (size_t)bid * BUFFER_SIZE;
+
+        if (!c->closing && conn_feed(&c->base, data, (size_t)cqe->res) < 0) {
+            close_uconn(c);
+        }
+        recycle_buffer(bid);
+    } else if (cqe->res == -ENOBUFS) {
+        // Sin buffers libres: el multishot terminó, se vuelve a armar abajo
+    } else if (cqe->res == -ECANCELED && !c->closing) {
+        // Cancelado por pausa: se vuelve a armar al reanudar
+    } else if (!c->closing) {
+        // EOF o error de lectura
+        close_uconn(c);
+    }
+
+    if (c->closing) {
+        mark_dirty(c);
+    } else if (recv_paused(c)) {
+        // Cliente lento: dejar de recibir hasta que vacíe su cola de salida
+        if (c->recv_armed && !c->recv_cancelling) {
+            cancel_recv(c);
+        }
+    } else if (!c->recv_armed) {
+        arm_recv(c);
+    }
+}
+
+// Función para procesar la completación de un envío
+static void handle_send(uconn_t *c, struct io_uring_cqe *cqe) {
+    c->sending = 0;
+    if (c->closing) {
+        // La cola sigue en su lugar tras conn_shutdown(): solo flush_dirty() la suelta
+        mark_dirty(c);
+        return;
+    }
+    if (cqe->res < 0) {
+        close_uconn(c);
+        return;
+    }
+
+    pthread_mutex_lock(&c->base.out_mutex);
+    unsigned inflight = c->base.out_inflight;
+    unsigned before = c->base.out_count;
+    c->base.out_inflight = 0;
+    conn_out_consume(&c->base, (size_t)cqe->res);
+    int partial = before - c->base.out_count < inflight || c->base.out_off > 0;
+    int queued = c->base.out_count > 0;
+    pthread_mutex_unlock(&c->base.out_mutex);
+
+    // Lo que quedó de un envío parcial sale con el siguiente lote. Las tramas que
+    // llegaron durante el envío esperan su ventana de agrupación, como en epoll
+    if (queued && !partial) {
+        conn_flush_later(&c->base);
+    } else {
+        mark_dirty(c);
+    }
+}
+
+// Función para atender las conexiones con salida encolada desde otros hilos
+static void handle_wake(void) {
+    pthread_mutex_lock(&ring->handoff_mutex);
+    uconn_t *c = ring->handoff_head;
+    ring->handoff_head = ring->handoff_tail = NULL;
+    while (c != NULL) {
+        uconn_t *next = c->next_handoff;
+        c->handoff_queued = 0;
+        if (!c->closing) {
+            mark_dirty(c);
+        }
+        conn_put(&c->base);
+        c = next;
+    }
+    pthread_mutex_unlock(&ring->handoff_mutex);
+
+    arm_wake();
+}
+
+// Función para crear un anillo y registrar sus buffers provistos
+static int setup_ring(uring_t *r, const reactor_config_t *config) {
+    struct io_uring_params params;
+
+    ring = r;   // Las funciones de preparación de SQE usan el anillo actual
+
+    if ((ring->listen_fd = create_listen_socket(config->port, config->backlog)) < 0) {
+        return -1;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_ENTRIES * 4;
+    if ((ring->fd = sys_io_uring_setup(URING_ENTRIES, &params)) < 0) {
+        perror("Error en io_uring_setup");
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        fprintf(stderr, "Error: el kernel no soporta IORING_FEAT_SINGLE_MMAP\n");
+        return -1;
+    }
+    // La ventana de agrupación necesita esperas con plazo en io_uring_enter
+    if (conn_coalescing() && !(params.features & IORING_FEAT_EXT_ARG)) {
+        fprintf(stderr, "Error: el kernel no soporta IORING_FEAT_EXT_ARG (necesario para --coalesce-us)\n");
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ring_size = sq_size > cq_size ? sq_size : cq_size;
+
+    char *ring_ptr = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring_ptr == MAP_FAILED) {
+        perror("Error en mmap del anillo");
+        return -1;
+    }
+    ring->sq_head = (unsigned *)(ring_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(ring_ptr + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(ring_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(ring_ptr + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *)(ring_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(ring_ptr + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(ring_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(ring_ptr + params.cq_off.cqes);
+
+    ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        perror("Error en mmap de las SQE");
+        return -1;
+    }
+
+    // Anillo de buffers provistos para recv multishot
+    ring->buf_ring = mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buf_base = malloc((size_t)URING_BUFFERS * BUFFER_SIZE);
+    if (ring->buf_ring == MAP_FAILED || ring->buf_base == NULL) {
+        perror("Error al reservar buffers de lectura");
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("Error al registrar el anillo de buffers");
+        return -1;
+    }
+    ring->buf_ring->tail = 0;
+    for (unsigned i = 0; i < URING_BUFFERS; i++) {
+        recycle_buffer(i);
+    }
+
+    if ((ring->wake_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+        perror("Error en eventfd");
+        return -1;
+    }
+    pthread_mutex_init(&ring->handoff_mutex, NULL);
+
+    arm_accept();
+    arm_wake();
+
+    ring = NULL;
+    return 0;
+}
+
+// Función para crear un anillo por reactor
+int uring_init(const reactor_config_t *config) {
+    rings = calloc((size_t)config->reactors, sizeof(uring_t));
+    uconn_cache = slab_cache_create("conexiones", sizeof(uconn_t));
+    if (rings == NULL || uconn_cache == NULL) {
+        perror("Error al reservar los anillos");
+        return -1;
+    }
+
+    n_rings = config->reactors;
+    for (int i = 0; i < n_rings; i++) {
+        rings[i].id = i;
+        if (setup_ring(&rings[i], config) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Función del bucle de completaciones de un anillo
+static void *uring_loop(void *arg) {
+    long long wait_ns = -1;     // Vencimiento de la salida diferida más próxima (-1: ninguna)
+
+    ring = arg;
+    pin_reactor_thread(ring->id);
+
+    while (1) {
+        // Un solo io_uring_enter envía el lote completo y espera completaciones; con
+        // salida diferida por la ventana de agrupación, solo hasta que venza
+        if (ring_enter(1, wait_ns) < 0) {
+            return NULL;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            int op = (int)(cqe->user_data & OP_MASK);
+            uconn_t *c = (uconn_t *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+
+            switch (op) {
+                case OP_ACCEPT:
+                    if (cqe->res >= 0) {
+                        handle_accept(cqe->res);
+                    } else if (cqe->res != -EAGAIN && cqe->res != -EINTR) {
+                        fprintf(stderr, "Error en accept: %s\n", strerror(-cqe->res));
+                    }
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                        arm_accept();
+                    }
+                    break;
+                case OP_RECV:
+                    handle_recv(c, cqe);
+                    break;
+                case OP_SEND:
+                    handle_send(c, cqe);
+                    break;
+                case OP_WAKE:
+                    handle_wake();
+                    break;
+                default:
+                    break;
+            }
+
+            head++;
+            // Liberar la entrada del CQ enseguida para no desbordarlo
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+            if (head == tail) {
+                tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        // Las respuestas del lote se agrupan por conexión y salen juntas
+        wait_ns = conn_flush_window();
+        flush_dirty();
+    }
+
+    return NULL;
+}
+
+// Función para lanzar un hilo por anillo; el hilo actual atiende el anillo 0
+void uring_run(void) {
+    for (int i = 1; i < n_rings; i++) {
+        if (pthread_create(&rings[i].thread, NULL, uring_loop, &rings[i]) != 0) {
+            perror("Error al crear hilo reactor");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(rings[i].thread);
+    }
+
+    uring_loop(&rings[0]);
+}
+
+// Función para programar el envío de la cola de una conexión en su anillo dueño
+void uring_flush(conn_t *conn) {
+    uconn_t *c = (uconn_t *)conn;
+
+    if (ring != NULL && ring->id == conn->reactor) {
+        if (!c->closing) {
+            mark_dirty(c);
+        }
+        return;
+    }
+
+    // La conexión pertenece a otro anillo: entregársela por su cola de traspaso
+    uring_t *target = &rings[conn->reactor];
+    pthread_mutex_lock(&target->handoff_mutex);
+    if (c->handoff_queued) {
+        pthread_mutex_unlock(&target->handoff_mutex);
+        return;
+    }
+    c->handoff_queued = 1;
+    c->next_handoff = NULL;
+    conn_get(conn);
+    int was_empty = target->handoff_head == NULL;
+    if (target->handoff_tail != NULL) {
+        target->handoff_tail->next_handoff = c;
+    } else {
+        target->handoff_head = c;
+    }
+    target->handoff_tail = c;
+    pthread_mutex_unlock(&target->handoff_mutex);
+
+    // Despertar al anillo solo en la transición vacía -> no vacía
+    uint64_t one = 1;
+    if (was_empty && write(target->wake_fd, &one, sizeof(one)) < 0) {
+        perror("Error al despertar el anillo");
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include "reactor.h"
+
+#define URING_ENTRIES 4096      // Entradas de la cola de envío (SQ)
+#define URING_BUFFERS 1024      // Buffers provistos al kernel para recv multishot
+#define URING_BUFFER_GROUP 0    // Grupo de buffers usado por las lecturas
+#define URING_SEND_IOV 16       // Tramas agrupadas por cada sendmsg en vuelo
+
+// Crea un anillo por reactor, registra sus buffers provistos y arma el accept multishot
+int uring_init(const reactor_config_t *config);
+
+// Lanza los hilos de los anillos; el hilo actual atiende el anillo 0 (no retorna)
+void uring_run(void);
+
+// Pide al anillo dueño que envíe la cola de salida de la conexión al final de su lote
+void uring_flush(conn_t *conn);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "user_index.h"
+
+// Función hash FNV-1a de 32 bits sobre el nombre de usuario
+static uint32_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Función para localizar la entrada de un nombre (o la libre donde iría)
+static size_t probe(const user_index_t *index, const char *name, uint32_t hash) {
+    size_t mask = index->cap - 1;
+    size_t i = hash & mask;
+
+    while (index->entries[i].name != NULL) {
+        if (index->entries[i].hash == hash && strcmp(index->entries[i].name, name) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+int user_index_init(user_index_t *index, size_t capacity) {
+    size_t cap = 16;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    index->entries = calloc(cap, sizeof(user_index_entry_t));
+    if (index->entries == NULL) {
+        return -1;
+    }
+    index->cap = cap;
+    index->count = 0;
+    return 0;
+}
+
+// Función para cambiar la capacidad de la tabla y reubicar las entradas
+static int resize(user_index_t *index, size_t capacity) {
+    user_index_t resized;
+
+    if (user_index_init(&resized, capacity) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < index->cap; i++) {
+        user_index_entry_t *e = &index->entries[i];
+        if (e->name != NULL) {
+            resized.entries[probe(&resized, e->name, e->hash)] = *e;
+        }
+    }
+    resized.count = index->count;
+
+    free(index->entries);
+    *index = resized;
+    return 0;
+}
+
+int user_index_find(const user_index_t *index, const char *name) {
+    size_t i = probe(index, name, hash_name(name));
+    return index->entries[i].name != NULL ? index->entries[i].slot : -1;
+}
+
+int user_index_insert(user_index_t *index, const char *name, int slot) {
+    // Factor de carga máximo 1/2 para mantener cortas las secuencias de sondeo
+    if ((index->count + 1) * 2 > index->cap && resize(index, index->cap * 2) < 0) {
+        return -1;
+    }
+
+    uint32_t hash = hash_name(name);
+    user_index_entry_t *e = &index->entries[probe(index, name, hash)];
+    if (e->name == NULL) {
+        index->count++;
+    }
+    e->name = name;
+    e->hash = hash;
+    e->slot = slot;
+    return 0;
+}
+
+// Función para borrar sin lápidas: se desplazan hacia atrás las entradas que siguen
+void user_index_remove(user_index_t *index, const char *name) {
+    size_t mask = index->cap - 1;
+    size_t i = probe(index, name, hash_name(name));
+
+    if (index->entries[i].name == NULL) {
+        return;
+    }
+    index->count--;
+
+    size_t j = i;
+    while (1) {
+        index->entries[i].name = NULL;
+        do {
+            j = (j + 1) & mask;
+            if (index->entries[j].name == NULL) {
+                // Devolver memoria cuando la carga baja de 1/8 (si falla, se conserva)
+                if (index->cap > 16 && index->count * 8 < index->cap) {
+                    resize(index, index->cap / 2);
+                }
+                return;
+            }
+            // Una entrada puede llenar el hueco si su posición ideal no está entre i y j
+        } while (((j - (index->entries[j].hash & mask)) & mask) < ((j - i) & mask));
+        index->entries[i] = index->entries[j];
+        i = j;
+    }
+}
+
+void user_index_move(user_index_t *index, const char *name, int slot) {
+    user_index_entry_t *e = &index->entries[probe(index, name, hash_name(name))];
+    if (e->name != NULL) {
+        e->name = name;
+        e->slot = slot;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef USER_INDEX_H
+#define USER_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Entrada del índice: nombre (apunta al registro del usuario) y su posición en users[]
+typedef struct {
+    const char *name;   // NULL: entrada libre
+    uint32_t hash;
+    int slot;
+} user_index_entry_t;
+
+// Tabla hash de direccionamiento abierto (sondeo lineal) nombre -> posición
+typedef struct {
+    user_index_entry_t *entries;
+    size_t cap;         // Potencia de dos
+    size_t count;
+} user_index_t;
+
+// Prepara un índice vacío con al menos la capacidad indicada
+int user_index_init(user_index_t *index, size_t capacity);
+
+// Retorna la posición del usuario o -1 si no está
+int user_index_find(const user_index_t *index, const char *name);
+
+// Añade un nombre nuevo; el puntero debe seguir válido mientras esté indexado
+int user_index_insert(user_index_t *index, const char *name, int slot);
+
+// Quita un nombre del índice
+void user_index_remove(user_index_t *index, const char *name);
+
+// Actualiza la entrada de un usuario cuyo registro se movió (compactación)
+void user_index_move(user_index_t *index, const char *name, int slot);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "users.h"
+#include "slab.h"
+
+static user_shard_t *shards;
+static int n_shards;
+static unsigned shard_mask;
+static int max_total;
+static int total;       // Registrados en todas las porciones (atómico)
+static unsigned long idle_ticks;    // Plazo de inactividad en ticks de la rueda
+static slab_cache_t *user_cache;
+
+// Función hash FNV-1a para repartir nombres entre porciones
+static uint32_t shard_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    // Mezclar los bits altos: el índice de cada porción usa los bajos del mismo hash
+    return h ^ (h >> 16);
+}
+
+// Función para crear las porciones del directorio
+int users_init(int count, int max_users, unsigned long idle_ms) {
+    if (count < 1 || (count & (count - 1)) != 0) {
+        fprintf(stderr, "El número de porciones debe ser potencia de dos\n");
+        return -1;
+    }
+
+    shards = calloc((size_t)count, sizeof(user_shard_t));
+    user_cache = slab_cache_create("usuarios", sizeof(user_t));
+    if (shards == NULL || user_cache == NULL) {
+        perror("Error al reservar el directorio de usuarios");
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_init(&shards[i].mutex, NULL);
+        if (user_index_init(&shards[i].index, 16) < 0) {
+            perror("Error al crear el índice de usuarios");
+            return -1;
+        }
+        timer_wheel_init(&shards[i].idle, timer_wheel_now());
+    }
+    n_shards = count;
+    shard_mask = (unsigned)count - 1;
+    max_total = max_users;
+    idle_ticks = timer_wheel_ticks(idle_ms);
+    return 0;
+}
+
+int users_shard_count(void) {
+    return n_shards;
+}
+
+user_shard_t *users_shard(int i) {
+    return &shards[i];
+}
+
+user_shard_t *users_shard_of(const char *username) {
+    return &shards[shard_hash(username) & shard_mask];
+}
+
+user_t *users_find(user_shard_t *shard, const char *username) {
+    int i = user_index_find(&shard->index, username);
+    return i >= 0 ? shard->users[i] : NULL;
+}
+
+// Función para registrar un usuario en su porción
+int users_add(const char *username, const char *ip, conn_t *conn, int encoding, int compressed, user_t **out) {
+    user_shard_t *shard = users_shard_of(username);
+    int result = USERS_OK;
+
+    // Se rechaza en lugar de recortarlo: el índice y las búsquedas usan el nombre completo
+    if (strlen(username) >= USERS_NAME_SIZE) {
+        return USERS_NAME_TOO_LONG;
+    }
+
+    pthread_mutex_lock(&shard->mutex);
+
+    if (user_index_find(&shard->index, username) >= 0) {
+        pthread_mutex_unlock(&shard->mutex);
+        return USERS_DUPLICATE;
+    }
+
+    // Reservar plaza en el límite global antes de tocar la porción
+    if (__atomic_add_fetch(&total, 1, __ATOMIC_RELAXED) > max_total) {
+        __atomic_sub_fetch(&total, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&shard->mutex);
+        return USERS_FULL;
+    }
+
+    user_t *user = slab_alloc(user_cache);
+    if (user == NULL) {
+        result = USERS_FULL;
+    } else if (shard->count == shard->cap) {
+        int cap = shard->cap ? shard->cap * 2 : 16;
+        user_t **tmp = realloc(shard->users, (size_t)cap * sizeof(user_t *));
+        if (tmp == NULL) {
+            result = USERS_FULL;
+        } else {
+            shard->users = tmp;
+            shard->cap = cap;
+        }
+    }
+
+    if (result == USERS_OK) {
+        memcpy(user->username, username, strlen(username) + 1);
+
+        strncpy(user->ip, ip, sizeof(user->ip) - 1);
+        user->ip[sizeof(user->ip) - 1] = '\0'; // Garantizar terminación
+
+        user->conn = conn;
+        user->status = 0; // ACTIVO
+        user->shard = (int)(shard - shards);
+        user->slot = shard->count;
+
+        if (user_index_insert(&shard->index, user->username, user->slot) < 0) {
+            result = USERS_FULL;
+        }
+    }
+
+    if (result == USERS_OK) {
+        shard->users[shard->count++] = user;
+        users_touch(user);
+        if (conn != NULL) {
+            conn->user = user;
+            conn->encoding = encoding;
+            conn->compressed = compressed;
+        }
+        if (out != NULL) {
+            *out = user;
+        }
+    } else {
+        slab_free(user);
+        __atomic_sub_fetch(&total, 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+    return result;
+}
+
+// Función para registrar actividad: solo se reprograma el temporizador del propio usuario
+void users_touch(user_t *user) {
+    user->last_activity = time(NULL);
+
+    // Un usuario ya INACTIVO no vuelve a vencer hasta que cambie de estado
+    if (user->status == 2) {
+        timer_wheel_cancel(&user->idle_timer);
+    } else {
+        timer_wheel_schedule(&users_shard(user->shard)->idle, &user->idle_timer,
+                             timer_wheel_now() + idle_ticks);
+    }
+}
+
+// Función para quitar un usuario compactando su porción
+void users_remove(user_t *user) {
+    user_shard_t *shard = &shards[user->shard];
+
+    pthread_mutex_lock(&shard->mutex);
+
+    int i = user->slot;
+    user_index_remove(&shard->index, user->username);
+    timer_wheel_cancel(&user->idle_timer);
+
+    // Mover el último usuario a esta posición
+    if (i < shard->count - 1) {
+        user_t *last = shard->users[shard->count - 1];
+        shard->users[i] = last;
+        last->slot = i;
+        user_index_move(&shard->index, last->username, i);
+    }
+    shard->count--;
+
+    // Devolver memoria cuando la porción se vacía
+    if (shard->cap > 16 && shard->count < shard->cap / 4) {
+        user_t **tmp = realloc(shard->users, (size_t)(shard->cap / 2) * sizeof(user_t *));
+        if (tmp != NULL) {
+            shard->users = tmp;
+            shard->cap /= 2;
+        }
+    }
+
+    if (user->conn != NULL) {
+        user->conn->user = NULL;
+    }
+
+    pthread_mutex_unlock(&shard->mutex);
+
+    __atomic_sub_fetch(&total, 1, __ATOMIC_RELAXED);
+    slab_free(user);
+}
+
+int users_total(void) {
+    return __atomic_load_n(&total, __ATOMIC_RELAXED);
+}
+
+// Función para sumar la memoria de los arreglos e índices de las porciones
+size_t users_index_bytes(void) {
+    size_t bytes = (size_t)n_shards * sizeof(user_shard_t);
+
+    for (int i = 0; i < n_shards; i++) {
+        pthread_mutex_lock(&shards[i].mutex);
+        bytes += (size_t)shards[i].cap * sizeof(user_t *);
+        bytes += shards[i].index.cap * sizeof(user_index_entry_t);
+        pthread_mutex_unlock(&shards[i].mutex);
+    }
+    return bytes;
+}
@@ -0,0 +1,74 @@
+#ifndef USERS_H
+#define USERS_H
+
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "conn.h"
+#include "user_index.h"
+#include "timer_wheel.h"
+
+#define DEFAULT_SHARDS 16       // Porciones del directorio de usuarios (potencia de dos)
+#define DEFAULT_IDLE_MS 300000  // Inactividad tras la que un usuario pasa a INACTIVO
+#define USERS_NAME_SIZE 50      // Nombre más su terminador: los más largos se rechazan
+
+// Resultados de users_add()
+#define USERS_OK 0
+#define USERS_DUPLICATE 1       // Nombre ya registrado
+#define USERS_FULL 2            // Límite de usuarios alcanzado o sin memoria
+#define USERS_NAME_TOO_LONG 3   // El nombre no cabe en USERS_NAME_SIZE
+
+// Estructura para usuarios
+typedef struct user {
+    char username[USERS_NAME_SIZE];
+    char ip[INET_ADDRSTRLEN];
+    conn_t *conn;   // Conexión del usuario (su cola de salida)
+    int status;  // 0: ACTIVO, 1: OCUPADO, 2: INACTIVO
+    time_t last_activity;
+    timer_node_t idle_timer;    // Plazo de inactividad en la rueda de su porción
+    int shard;      // Porción que contiene el registro
+    int slot;       // Posición dentro de su porción
+} user_t;
+
+// Porción del directorio: usuarios cuyo nombre cae en ella por hash, con su propio candado
+typedef struct {
+    pthread_mutex_t mutex;
+    user_t **users;         // Compactados: al borrar se mueve el último al hueco
+    int count;
+    int cap;
+    user_index_t index;     // Nombre -> posición en users
+    timer_wheel_t idle;     // Plazos de inactividad de sus usuarios
+} user_shard_t;
+
+// Crea el directorio con el número de porciones indicado (potencia de dos)
+int users_init(int shards, int max_users, unsigned long idle_ms);
+
+int users_shard_count(void);
+
+user_shard_t *users_shard(int i);
+
+// Porción a la que pertenece un nombre
+user_shard_t *users_shard_of(const char *username);
+
+// Busca un usuario dentro de su porción (candado de la porción tomado)
+user_t *users_find(user_shard_t *shard, const char *username);
+
+// Registra un usuario y lo asocia a la conexión (conn->user); toma el candado de su
+// porción. Bajo el mismo candado fija en la conexión la codificación y la compresión
+// negociadas, así que quien encuentre al usuario ya las ve; si se rechaza, la
+// conexión queda como estaba
+int users_add(const char *username, const char *ip, conn_t *conn, int encoding, int compressed, user_t **out);
+
+// Quita el usuario, desasocia su conexión y libera el registro; toma el candado de su porción
+void users_remove(user_t *user);
+
+// Registra actividad y reprograma el plazo de inactividad (candado de la porción tomado)
+void users_touch(user_t *user);
+
+// Usuarios registrados en todo el directorio
+int users_total(void);
+
+// Bytes ocupados por los arreglos e índices de las porciones (sin los registros)
+size_t users_index_bytes(void);
+
+#endif
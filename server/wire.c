@@ -0,0 +1,1312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wire.h"
+
+// Claves conocidas: viajan como su índice en la tabla
+static const char *const wire_keys[WIRE_KEYS] = {
+    [WIRE_KEY_TIPO] = "tipo",
+    [WIRE_KEY_ACCION] = "accion",
+    [WIRE_KEY_USUARIO] = "usuario",
+    [WIRE_KEY_DIRECCION_IP] = "direccionIP",
+    [WIRE_KEY_ESTADO] = "estado",
+    [WIRE_KEY_NOMBRE_EMISOR] = "nombre_emisor",
+    [WIRE_KEY_NOMBRE_DESTINATARIO] = "nombre_destinatario",
+    [WIRE_KEY_MENSAJE] = "mensaje",
+    [WIRE_KEY_RESPUESTA] = "respuesta",
+    [WIRE_KEY_RAZON] = "razon",
+    [WIRE_KEY_USUARIOS] = "usuarios",
+    [WIRE_KEY_CODIFICACION] = "codificacion",
+    [WIRE_KEY_NOMBRE_USUARIO] = "nombre_usuario",
+    [WIRE_KEY_OPERACIONES] = "operaciones",
+    [WIRE_KEY_PROCESADAS] = "procesadas",
+    [WIRE_KEY_RECHAZADAS] = "rechazadas",
+    [WIRE_KEY_COMPRESION] = "compresion",
+    [WIRE_KEY_ANTES] = "antes",
+    [WIRE_KEY_DESDE] = "desde",
+    [WIRE_KEY_HASTA] = "hasta",
+};
+
+// Verbos de tipo/accion: viajan como su índice en la tabla
+static const char *const wire_verbs[WIRE_VERBS] = {
+    [WIRE_VERB_REGISTRO] = "REGISTRO",
+    [WIRE_VERB_EXIT] = "EXIT",
+    [WIRE_VERB_ESTADO] = "ESTADO",
+    [WIRE_VERB_MOSTRAR] = "MOSTRAR",
+    [WIRE_VERB_BROADCAST] = "BROADCAST",
+    [WIRE_VERB_DM] = "DM",
+    [WIRE_VERB_LISTA] = "LISTA",
+    [WIRE_VERB_SERVER_SHUTDOWN] = "SERVER_SHUTDOWN",
+    [WIRE_VERB_LOTE] = "LOTE",
+    [WIRE_VERB_HISTORIA] = "HISTORIA",
+};
+
+#define N_KEYS (int)WIRE_KEYS
+#define N_VERBS (int)WIRE_VERBS
+
+// Hash perfecto de los verbos, al estilo de gperf: longitud más primera y última
+// letra. La tabla se arma al compilar; si un verbo nuevo cae en una casilla ocupada,
+// la compilación falla en el _Static_assert de abajo y hay que ajustar la función
+#define VERB_HASH_SIZE 16
+#define VERB_HASH(first, last, len) (((len) + (first) + (last)) & (VERB_HASH_SIZE - 1))
+
+// Cada verbo con su primera y última letra y su longitud
+#define VERB_HASHES(X) \
+    X(WIRE_VERB_REGISTRO, 'R', 'O', 8) \
+    X(WIRE_VERB_EXIT, 'E', 'T', 4) \
+    X(WIRE_VERB_ESTADO, 'E', 'O', 6) \
+    X(WIRE_VERB_MOSTRAR, 'M', 'R', 7) \
+    X(WIRE_VERB_BROADCAST, 'B', 'T', 9) \
+    X(WIRE_VERB_DM, 'D', 'M', 2) \
+    X(WIRE_VERB_LISTA, 'L', 'A', 5) \
+    X(WIRE_VERB_SERVER_SHUTDOWN, 'S', 'N', 15) \
+    X(WIRE_VERB_LOTE, 'L', 'E', 4) \
+    X(WIRE_VERB_HISTORIA, 'H', 'A', 8)
+
+#define VERB_SLOT(verb, first, last, len) [VERB_HASH(first, last, len)] = (verb) + 1,
+#define VERB_ONE(verb, first, last, len) + 1
+#define VERB_BIT_SUM(verb, first, last, len) + (1u << VERB_HASH(first, last, len))
+#define VERB_BIT_OR(verb, first, last, len) | (1u << VERB_HASH(first, last, len))
+
+static const signed char verb_slots[VERB_HASH_SIZE] = {    // Verbo + 1; 0 es una casilla vacía
+    VERB_HASHES(VERB_SLOT)
+};
+
+// Sin casillas repetidas la suma de los bits de cada verbo es igual a su unión
+_Static_assert((0 VERB_HASHES(VERB_ONE)) == WIRE_VERBS, "falta un verbo en VERB_HASHES");
+_Static_assert((0u VERB_HASHES(VERB_BIT_SUM)) == (0u VERB_HASHES(VERB_BIT_OR)),
+               "dos verbos comparten casilla: hay que ajustar VERB_HASH");
+
+// Cursor de lectura sobre la carga de una trama
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    int depth;
+} wire_reader_t;
+
+static int lookup(const char *const *table, int n, const char *s) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(table[i], s) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Función para buscar una cadena sin terminador en una tabla
+static int lookup_n(const char *const *table, int n, const char *s, size_t len) {
+    for (int i = 0; i < n; i++) {
+        if (strlen(table[i]) == len && memcmp(table[i], s, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int is_verb_key(const char *key) {
+    return key != NULL && (strcmp(key, "tipo") == 0 || strcmp(key, "accion") == 0);
+}
+
+// Función para identificar un verbo: un hash y una comparación
+int wire_verb_lookup(const char *s) {
+    size_t len = strlen(s);
+    if (len == 0) {
+        return -1;
+    }
+
+    int verb = verb_slots[VERB_HASH((unsigned char)s[0], (unsigned char)s[len - 1], len)] - 1;
+    return verb >= 0 && strcmp(wire_verbs[verb], s) == 0 ? verb : -1;
+}
+
+size_t wire_payload_len(const char *header) {
+    const unsigned char *h = (const unsigned char *)header;
+    return ((size_t)h[0] << 24) | ((size_t)h[1] << 16) | ((size_t)h[2] << 8) | (size_t)h[3];
+}
+
+// Función para reservar n bytes más al final del buffer
+static unsigned char *buf_reserve(wire_buf_t *buf, size_t n) {
+    if (buf->failed) {
+        return NULL;
+    }
+    if (buf->len + n > buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : 256;
+        while (cap < buf->len + n) {
+            cap *= 2;
+        }
+        unsigned char *tmp = realloc(buf->data, cap);
+        if (tmp == NULL) {
+            buf->failed = 1;
+            return NULL;
+        }
+        buf->data = tmp;
+        buf->cap = cap;
+    }
+    unsigned char *p = buf->data + buf->len;
+    buf->len += n;
+    return p;
+}
+
+// Función para escribir un byte de tipo seguido de un entero big-endian de size bytes
+static void put_be(wire_buf_t *buf, unsigned char type, unsigned long long v, int size) {
+    unsigned char *p = buf_reserve(buf, 1 + (size_t)size);
+    if (p == NULL) {
+        return;
+    }
+    p[0] = type;
+    for (int i = size; i > 0; i--) {
+        p[i] = (unsigned char)(v & 0xff);
+        v >>= 8;
+    }
+}
+
+static void put_uint(wire_buf_t *buf, unsigned long long v) {
+    if (v < 0x80) {
+        put_be(buf, (unsigned char)v, 0, 0);    // fixint positivo
+    } else if (v <= 0xff) {
+        put_be(buf, 0xcc, v, 1);
+    } else if (v <= 0xffff) {
+        put_be(buf, 0xcd, v, 2);
+    } else if (v <= 0xffffffffULL) {
+        put_be(buf, 0xce, v, 4);
+    } else {
+        put_be(buf, 0xcf, v, 8);
+    }
+}
+
+static void put_int(wire_buf_t *buf, long long v) {
+    if (v >= 0) {
+        put_uint(buf, (unsigned long long)v);
+    } else if (v >= -32) {
+        put_be(buf, (unsigned char)(0xe0 | (v + 32)), 0, 0);    // fixint negativo
+    } else if (v >= -128) {
+        put_be(buf, 0xd0, (unsigned long long)v, 1);
+    } else if (v >= -32768) {
+        put_be(buf, 0xd1, (unsigned long long)v, 2);
+    } else if (v >= -2147483648LL) {
+        put_be(buf, 0xd2, (unsigned long long)v, 4);
+    } else {
+        put_be(buf, 0xd3, (unsigned long long)v, 8);
+    }
+}
+
+static void put_str(wire_buf_t *buf, const char *s) {
+    size_t n = strlen(s);
+
+    if (n < 32) {
+        put_be(buf, (unsigned char)(0xa0 | n), 0, 0);
+    } else if (n <= 0xff) {
+        put_be(buf, 0xd9, n, 1);
+    } else if (n <= 0xffff) {
+        put_be(buf, 0xda, n, 2);
+    } else {
+        put_be(buf, 0xdb, n, 4);
+    }
+
+    unsigned char *p = buf_reserve(buf, n);
+    if (p != NULL) {
+        memcpy(p, s, n);
+    }
+}
+
+// Función para escribir la cabecera de un mapa (map) o arreglo (array) de n elementos
+static void put_container(wire_buf_t *buf, int map, size_t n) {
+    if (n < 16) {
+        put_be(buf, (unsigned char)((map ? 0x80 : 0x90) | n), 0, 0);
+    } else if (n <= 0xffff) {
+        put_be(buf, map ? 0xde : 0xdc, n, 2);
+    } else {
+        put_be(buf, map ? 0xdf : 0xdd, n, 4);
+    }
+}
+
+// Función para codificar un valor; key es la clave que lo contiene (NULL en arreglos)
+static void put_value(wire_buf_t *buf, const cJSON *item, const char *key) {
+    if (cJSON_IsString(item)) {
+        int verb = is_verb_key(key) ? wire_verb_lookup(item->valuestring) : -1;
+        if (verb >= 0) {
+            put_uint(buf, (unsigned long long)verb);
+        } else {
+            put_str(buf, item->valuestring);
+        }
+    } else if (cJSON_IsNumber(item)) {
+        double d = item->valuedouble;
+        if (d >= -9.2e18 && d <= 9.2e18 && (double)(long long)d == d) {
+            put_int(buf, (long long)d);
+        } else {
+            unsigned long long bits;
+            memcpy(&bits, &d, sizeof(bits));
+            put_be(buf, 0xcb, bits, 8);
+        }
+    } else if (cJSON_IsBool(item)) {
+        put_be(buf, cJSON_IsTrue(item) ? 0xc3 : 0xc2, 0, 0);
+    } else if (cJSON_IsArray(item) || cJSON_IsObject(item)) {
+        int map = cJSON_IsObject(item);
+        put_container(buf, map, (size_t)cJSON_GetArraySize(item));
+
+        for (const cJSON *child = item->child; child != NULL; child = child->next) {
+            if (map) {
+                int k = lookup(wire_keys, N_KEYS, child->string);
+                if (k >= 0) {
+                    put_uint(buf, (unsigned long long)k);
+                } else {
+                    put_str(buf, child->string);
+                }
+            }
+            put_value(buf, child, map ? child->string : NULL);
+        }
+    } else {
+        put_be(buf, 0xc0, 0, 0);    // null
+    }
+}
+
+// Función para escribir la cabecera de longitud reservada al inicio del buffer
+static int put_header(wire_buf_t *buf) {
+    size_t payload = buf->len - WIRE_HEADER_SIZE;
+    if (buf->failed || payload > WIRE_MAX_PAYLOAD) {
+        return -1;
+    }
+    buf->data[0] = (unsigned char)(payload >> 24);
+    buf->data[1] = (unsigned char)(payload >> 16);
+    buf->data[2] = (unsigned char)(payload >> 8);
+    buf->data[3] = (unsigned char)payload;
+    return 0;
+}
+
+// Función para serializar un objeto como JSON legible o como trama binaria
+char *wire_print(const cJSON *json, wire_encoding_t encoding, size_t *len) {
+    if (encoding == WIRE_JSON) {
+        char *str = cJSON_Print(json);
+        if (str != NULL) {
+            *len = strlen(str);
+        }
+        return str;
+    }
+
+    wire_buf_t buf = {NULL, 0, 0, 0};
+    buf_reserve(&buf, WIRE_HEADER_SIZE);
+    put_value(&buf, json, NULL);
+
+    if (put_header(&buf) < 0) {
+        free(buf.data);
+        return NULL;
+    }
+    *len = buf.len;
+    return (char *)buf.data;
+}
+
+// Función para leer un entero big-endian de size bytes; -1 si la trama se acaba
+static int get_be(wire_reader_t *r, int size, unsigned long long *v) {
+    if (r->end - r->p < size) {
+        return -1;
+    }
+    *v = 0;
+    for (int i = 0; i < size; i++) {
+        *v = (*v << 8) | *r->p++;
+    }
+    return 0;
+}
+
+// Función para crear una cadena cJSON a partir de bytes sin terminador
+static cJSON *create_string(const unsigned char *s, size_t n) {
+    char stack[256];
+    char *tmp = n < sizeof(stack) ? stack : malloc(n + 1);
+    if (tmp == NULL) {
+        return NULL;
+    }
+    memcpy(tmp, s, n);
+    tmp[n] = '\0';
+
+    cJSON *item = cJSON_CreateString(tmp);
+    if (tmp != stack) {
+        free(tmp);
+    }
+    return item;
+}
+
+// Función para leer la longitud de una cadena; -1 si el byte no es una cadena
+static int get_str_len(wire_reader_t *r, unsigned char type, size_t *n) {
+    unsigned long long v;
+
+    if ((type & 0xe0) == 0xa0) {
+        *n = type & 0x1f;
+    } else if (type >= 0xd9 && type <= 0xdb) {
+        if (get_be(r, 1 << (type - 0xd9), &v) < 0) {
+            return -1;
+        }
+        *n = (size_t)v;
+    } else {
+        return -1;
+    }
+    return (size_t)(r->end - r->p) >= *n ? 0 : -1;
+}
+
+static cJSON *read_value(wire_reader_t *r, const char *key);
+
+// Función para leer un mapa o arreglo de n elementos
+static cJSON *read_container(wire_reader_t *r, int map, unsigned long long n) {
+    if (++r->depth > WIRE_MAX_DEPTH || n > (unsigned long long)(r->end - r->p)) {
+        return NULL;    // Cada elemento ocupa al menos un byte
+    }
+
+    cJSON *item = map ? cJSON_CreateObject() : cJSON_CreateArray();
+    for (unsigned long long i = 0; item != NULL && i < n; i++) {
+        if (!map) {
+            cJSON *child = read_value(r, NULL);
+            if (child == NULL) {
+                cJSON_Delete(item);
+                return NULL;
+            }
+            cJSON_AddItemToArray(item, child);
+            continue;
+        }
+
+        // Clave: índice de la tabla o cadena
+        if (r->p >= r->end) {
+            cJSON_Delete(item);
+            return NULL;
+        }
+        unsigned char type = *r->p++;
+        char name[256];
+        size_t len;
+        if (type < 0x80) {
+            if (type >= N_KEYS) {
+                cJSON_Delete(item);
+                return NULL;
+            }
+            strcpy(name, wire_keys[type]);
+        } else if (get_str_len(r, type, &len) == 0 && len < sizeof(name)) {
+            memcpy(name, r->p, len);
+            name[len] = '\0';
+            r->p += len;
+        } else {
+            cJSON_Delete(item);
+            return NULL;
+        }
+
+        cJSON *child = read_value(r, name);
+        if (child == NULL) {
+            cJSON_Delete(item);
+            return NULL;
+        }
+        cJSON_AddItemToObject(item, name, child);
+    }
+
+    r->depth--;
+    return item;
+}
+
+// Función para leer un valor; key es la clave que lo contiene (NULL en arreglos)
+static cJSON *read_value(wire_reader_t *r, const char *key) {
+    unsigned long long v;
+    size_t len;
+
+    if (r->p >= r->end) {
+        return NULL;
+    }
+    unsigned char type = *r->p++;
+
+    if (type < 0x80) {
+        // Entero pequeño: en tipo/accion es un verbo de la tabla
+        if (is_verb_key(key)) {
+            return type < N_VERBS ? cJSON_CreateString(wire_verbs[type]) : NULL;
+        }
+        return cJSON_CreateNumber(type);
+    }
+    if (type >= 0xe0) {
+        return cJSON_CreateNumber((signed char)type);
+    }
+    if ((type & 0xf0) == 0x80) {
+        return read_container(r, 1, type & 0x0f);
+    }
+    if ((type & 0xf0) == 0x90) {
+        return read_container(r, 0, type & 0x0f);
+    }
+    if (get_str_len(r, type, &len) == 0) {
+        cJSON *item = create_string(r->p, len);
+        r->p += len;
+        return item;
+    }
+
+    switch (type) {
+        case 0xc0:
+            return cJSON_CreateNull();
+        case 0xc2:
+            return cJSON_CreateFalse();
+        case 0xc3:
+            return cJSON_CreateTrue();
+        case 0xcb: {
+            double d;
+            if (get_be(r, 8, &v) < 0) {
+                return NULL;
+            }
+            memcpy(&d, &v, sizeof(d));
+            return cJSON_CreateNumber(d);
+        }
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            if (get_be(r, 1 << (type - 0xcc), &v) < 0) {
+                return NULL;
+            }
+            return cJSON_CreateNumber((double)v);
+        case 0xd0:
+            return get_be(r, 1, &v) < 0 ? NULL : cJSON_CreateNumber((signed char)v);
+        case 0xd1:
+            return get_be(r, 2, &v) < 0 ? NULL : cJSON_CreateNumber((short)v);
+        case 0xd2:
+            return get_be(r, 4, &v) < 0 ? NULL : cJSON_CreateNumber((int)v);
+        case 0xd3:
+            return get_be(r, 8, &v) < 0 ? NULL : cJSON_CreateNumber((double)(long long)v);
+        case 0xdc:
+        case 0xdd:
+            if (get_be(r, type == 0xdc ? 2 : 4, &v) < 0) {
+                return NULL;
+            }
+            return read_container(r, 0, v);
+        case 0xde:
+        case 0xdf:
+            if (get_be(r, type == 0xde ? 2 : 4, &v) < 0) {
+                return NULL;
+            }
+            return read_container(r, 1, v);
+        default:
+            return NULL;    // Tipos no usados por el protocolo (bin, ext, float32)
+    }
+}
+
+// Función para decodificar una trama binaria; la carga debe ser exactamente un mapa
+cJSON *wire_decode(const char *frame, size_t len) {
+    if (len < WIRE_HEADER_SIZE || wire_payload_len(frame) != len - WIRE_HEADER_SIZE) {
+        return NULL;
+    }
+
+    wire_reader_t r;
+    r.p = (const unsigned char *)frame + WIRE_HEADER_SIZE;
+    r.end = (const unsigned char *)frame + len;
+    r.depth = 0;
+
+    cJSON *json = read_value(&r, NULL);
+    if (json == NULL || !cJSON_IsObject(json) || r.p != r.end) {
+        cJSON_Delete(json);
+        return NULL;
+    }
+    return json;
+}
+
+// Función para escribir un byte suelto (separadores JSON y cabeceras por completar)
+static void put_byte(wire_buf_t *buf, unsigned char c) {
+    unsigned char *p = buf_reserve(buf, 1);
+    if (p != NULL) {
+        *p = c;
+    }
+}
+
+// Función para escribir una cadena JSON entre comillas con los mismos escapes que cJSON
+static void put_json_str(wire_buf_t *buf, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p;
+    size_t n = 2;
+
+    // Primera pasada: medir, para reservar una sola vez
+    for (p = (const unsigned char *)s; *p != '\0'; p++) {
+        if (*p >= 0x20 && *p != '"' && *p != '\\') {
+            n += 1;
+        } else if (*p == '"' || *p == '\\' || *p == '\b' || *p == '\f' ||
+                   *p == '\n' || *p == '\r' || *p == '\t') {
+            n += 2;
+        } else {
+            n += 6;     // \u00XX
+        }
+    }
+
+    unsigned char *out = buf_reserve(buf, n);
+    if (out == NULL) {
+        return;
+    }
+
+    *out++ = '"';
+    for (p = (const unsigned char *)s; *p != '\0'; p++) {
+        if (*p >= 0x20 && *p != '"' && *p != '\\') {
+            *out++ = *p;
+            continue;
+        }
+        *out++ = '\\';
+        switch (*p) {
+            case '"':  *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '\b': *out++ = 'b'; break;
+            case '\f': *out++ = 'f'; break;
+            case '\n': *out++ = 'n'; break;
+            case '\r': *out++ = 'r'; break;
+            case '\t': *out++ = 't'; break;
+            default:
+                *out++ = 'u';
+                *out++ = '0';
+                *out++ = '0';
+                *out++ = (unsigned char)hex[*p >> 4];
+                *out++ = (unsigned char)hex[*p & 0x0f];
+                break;
+        }
+    }
+    *out = '"';
+}
+
+void wire_writer_begin(wire_writer_t *w, wire_encoding_t encoding) {
+    w->buf.len = 0;
+    w->buf.failed = 0;
+    w->encoding = encoding;
+    w->depth = 0;
+    if (encoding == WIRE_MSGPACK) {
+        buf_reserve(&w->buf, WIRE_HEADER_SIZE);     // Se completa en wire_writer_end
+    }
+}
+
+void wire_writer_free(wire_writer_t *w) {
+    free(w->buf.data);
+    memset(w, 0, sizeof(*w));
+}
+
+// Función para abrir un elemento del contenedor actual: separador y clave
+static void put_element(wire_writer_t *w, int key) {
+    if (key != WIRE_NO_KEY && (key < 0 || key >= N_KEYS)) {
+        w->buf.failed = 1;
+        return;
+    }
+    if (w->depth > 0) {
+        w->count[w->depth - 1]++;
+    }
+
+    if (w->encoding == WIRE_JSON) {
+        if (w->depth > 0 && w->count[w->depth - 1] > 1) {
+            put_byte(&w->buf, ',');
+        }
+        if (key != WIRE_NO_KEY) {
+            put_json_str(&w->buf, wire_keys[key]);
+            put_byte(&w->buf, ':');
+        }
+    } else if (key != WIRE_NO_KEY) {
+        put_uint(&w->buf, (unsigned long long)key);
+    }
+}
+
+// Función para abrir un mapa o arreglo; en binario su cabecera se completa al cerrarlo
+static void begin_container(wire_writer_t *w, int key, int map) {
+    put_element(w, key);
+    if (w->depth == WIRE_MAX_DEPTH) {
+        w->buf.failed = 1;
+        return;
+    }
+    w->start[w->depth] = w->buf.len;
+    w->count[w->depth] = 0;
+    w->depth++;
+    put_byte(&w->buf, w->encoding == WIRE_JSON ? (map ? '{' : '[') : 0);
+}
+
+static void end_container(wire_writer_t *w, int map) {
+    if (w->depth == 0) {
+        w->buf.failed = 1;
+        return;
+    }
+    w->depth--;
+    if (w->buf.failed) {
+        return;
+    }
+
+    if (w->encoding == WIRE_JSON) {
+        put_byte(&w->buf, map ? '}' : ']');
+        return;
+    }
+
+    unsigned n = w->count[w->depth];
+    size_t at = w->start[w->depth];
+    if (n < 16) {
+        w->buf.data[at] = (unsigned char)((map ? 0x80 : 0x90) | n);
+        return;
+    }
+
+    // Cabecera ancha (listas largas): desplazar lo ya escrito para hacerle sitio
+    int size = n <= 0xffff ? 2 : 4;
+    if (buf_reserve(&w->buf, (size_t)size) == NULL) {
+        return;
+    }
+    unsigned char *p = w->buf.data + at;
+    memmove(p + 1 + size, p + 1, w->buf.len - at - 1 - (size_t)size);
+    p[0] = size == 2 ? (map ? 0xde : 0xdc) : (map ? 0xdf : 0xdd);
+    for (int i = size; i > 0; i--) {
+        p[i] = (unsigned char)(n & 0xff);
+        n >>= 8;
+    }
+}
+
+void wire_begin_object(wire_writer_t *w, int key) {
+    begin_container(w, key, 1);
+}
+
+void wire_end_object(wire_writer_t *w) {
+    end_container(w, 1);
+}
+
+void wire_begin_array(wire_writer_t *w, int key) {
+    begin_container(w, key, 0);
+}
+
+void wire_end_array(wire_writer_t *w) {
+    end_container(w, 0);
+}
+
+void wire_add_string(wire_writer_t *w, int key, const char *value) {
+    put_element(w, key);
+    if (w->encoding == WIRE_JSON) {
+        put_json_str(&w->buf, value);
+    } else {
+        put_str(&w->buf, value);
+    }
+}
+
+void wire_add_verb(wire_writer_t *w, int key, wire_verb_t verb) {
+    if ((int)verb < 0 || verb >= WIRE_VERBS) {
+        w->buf.failed = 1;
+        return;
+    }
+    put_element(w, key);
+    if (w->encoding == WIRE_JSON) {
+        put_json_str(&w->buf, wire_verbs[verb]);
+    } else {
+        put_uint(&w->buf, (unsigned long long)verb);
+    }
+}
+
+void wire_add_int(wire_writer_t *w, int key, long long value) {
+    put_element(w, key);
+    if (w->encoding == WIRE_JSON) {
+        char digits[24];
+        int n = snprintf(digits, sizeof(digits), "%lld", value);
+        unsigned char *p = buf_reserve(&w->buf, (size_t)n);
+        if (p != NULL) {
+            memcpy(p, digits, (size_t)n);
+        }
+    } else {
+        put_int(&w->buf, value);
+    }
+}
+
+// Función para cerrar la trama: en binario se completa la cabecera de longitud
+const char *wire_writer_end(wire_writer_t *w, size_t *len) {
+    if (w->buf.failed || w->depth != 0) {
+        return NULL;
+    }
+    if (w->encoding == WIRE_MSGPACK && put_header(&w->buf) < 0) {
+        return NULL;
+    }
+    *len = w->buf.len;
+    return (const char *)w->buf.data;
+}
+
+// Estado del extractor: entrada por recorrer y almacén de las cadenas copiadas
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    char *out;              // Siguiente byte libre del almacén (reservado de antemano)
+    int depth;
+} json_scan_t;
+
+// Función para saltar espacios; como en cJSON, cualquier byte de control cuenta
+static void skip_ws(json_scan_t *s) {
+    while (s->p < s->end && *s->p <= ' ') {
+        s->p++;
+    }
+}
+
+// Función para leer 4 dígitos hexadecimales de un escape \uXXXX
+static int get_hex4(json_scan_t *s, unsigned *v) {
+    if (s->end - s->p < 4) {
+        return -1;
+    }
+    *v = 0;
+    for (int i = 0; i < 4; i++) {
+        unsigned char c = *s->p++;
+        *v <<= 4;
+        if (c >= '0' && c <= '9') {
+            *v |= (unsigned)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            *v |= (unsigned)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            *v |= (unsigned)(c - 'A' + 10);
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Función para escribir un punto de código en UTF-8; retorna los bytes usados
+static size_t put_utf8(char *dst, unsigned cp) {
+    if (cp < 0x80) {
+        dst[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = (char)(0xc0 | (cp >> 6));
+        dst[1] = (char)(0x80 | (cp & 0x3f));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = (char)(0xe0 | (cp >> 12));
+        dst[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        dst[2] = (char)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    dst[0] = (char)(0xf0 | (cp >> 18));
+    dst[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+    dst[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    dst[3] = (char)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+// Función para leer una cadena JSON (s->p en la comilla inicial). Con dst, la
+// decodifica allí mientras quepa en cap; *n recibe su longitud decodificada.
+// El resultado nunca es más largo que el texto original
+static int json_string(json_scan_t *s, char *dst, size_t cap, size_t *n) {
+    char tmp[4];
+    *n = 0;
+    s->p++;
+
+    while (s->p < s->end && *s->p != '"') {
+        const unsigned char *run = s->p;
+        while (s->p < s->end && *s->p != '"' && *s->p != '\\') {
+            s->p++;
+        }
+        size_t plain = (size_t)(s->p - run);
+        if (dst != NULL && *n + plain <= cap) {
+            memcpy(dst + *n, run, plain);
+        }
+        *n += plain;
+
+        if (s->p >= s->end || *s->p == '"') {
+            break;
+        }
+
+        // Escape
+        if (s->end - s->p < 2) {
+            return -1;
+        }
+        s->p++;
+        unsigned char e = *s->p++;
+        size_t w = 1;
+        switch (e) {
+            case '"': case '\\': case '/': tmp[0] = (char)e; break;
+            case 'b': tmp[0] = '\b'; break;
+            case 'f': tmp[0] = '\f'; break;
+            case 'n': tmp[0] = '\n'; break;
+            case 'r': tmp[0] = '\r'; break;
+            case 't': tmp[0] = '\t'; break;
+            case 'u': {
+                unsigned cp, low;
+                if (get_hex4(s, &cp) < 0 || (cp >= 0xdc00 && cp <= 0xdfff)) {
+                    return -1;
+                }
+                // Par sustituto: la segunda mitad debe seguir de inmediato
+                if (cp >= 0xd800 && cp <= 0xdbff) {
+                    if (s->end - s->p < 2 || s->p[0] != '\\' || s->p[1] != 'u') {
+                        return -1;
+                    }
+                    s->p += 2;
+                    if (get_hex4(s, &low) < 0 || low < 0xdc00 || low > 0xdfff) {
+                        return -1;
+                    }
+                    cp = 0x10000 + (((cp & 0x3ff) << 10) | (low & 0x3ff));
+                }
+                w = put_utf8(tmp, cp);
+                break;
+            }
+            default:
+                return -1;
+        }
+        if (dst != NULL && *n + w <= cap) {
+            memcpy(dst + *n, tmp, w);
+        }
+        *n += w;
+    }
+
+    if (s->p >= s->end) {
+        return -1;
+    }
+    s->p++;
+    return 0;
+}
+
+// Función para saltar un número: lo mismo que strtod consumiría en cJSON (un '-' o
+// un dígito al inicio, parte entera y/o fraccionaria, exponente solo si trae dígitos)
+static int json_number(json_scan_t *s) {
+    int digits = 0;
+
+    if (*s->p != '-' && (*s->p < '0' || *s->p > '9')) {
+        return -1;
+    }
+    if (*s->p == '-') {
+        s->p++;
+    }
+    while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+        s->p++;
+        digits = 1;
+    }
+    if (s->p < s->end && *s->p == '.') {
+        s->p++;
+        while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+            s->p++;
+            digits = 1;
+        }
+    }
+    if (!digits) {
+        return -1;
+    }
+
+    if (s->p < s->end && (*s->p == 'e' || *s->p == 'E')) {
+        const unsigned char *exp = s->p++;
+        if (s->p < s->end && (*s->p == '+' || *s->p == '-')) {
+            s->p++;
+        }
+        if (s->p >= s->end || *s->p < '0' || *s->p > '9') {
+            s->p = exp;     // Sin dígitos no es exponente
+            return 0;
+        }
+        while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+            s->p++;
+        }
+    }
+    return 0;
+}
+
+static int json_skip(json_scan_t *s);
+
+// Función para saltar los elementos de un objeto u arreglo (s->p tras la apertura)
+static int json_skip_container(json_scan_t *s, int map) {
+    size_t n;
+    if (++s->depth > WIRE_JSON_MAX_DEPTH) {
+        return -1;
+    }
+
+    skip_ws(s);
+    if (s->p < s->end && *s->p == (map ? '}' : ']')) {
+        s->p++;
+        s->depth--;
+        return 0;
+    }
+    while (1) {
+        skip_ws(s);
+        if (map) {
+            if (s->p >= s->end || *s->p != '"' || json_string(s, NULL, 0, &n) < 0) {
+                return -1;
+            }
+            skip_ws(s);
+            if (s->p >= s->end || *s->p++ != ':') {
+                return -1;
+            }
+            skip_ws(s);
+        }
+        if (json_skip(s) < 0) {
+            return -1;
+        }
+        skip_ws(s);
+        if (s->p >= s->end) {
+            return -1;
+        }
+        unsigned char c = *s->p++;
+        if (c == (map ? '}' : ']')) {
+            break;
+        }
+        if (c != ',') {
+            return -1;
+        }
+    }
+    s->depth--;
+    return 0;
+}
+
+// Función para validar y saltar un valor JSON sin reservar memoria
+static int json_skip(json_scan_t *s) {
+    size_t n;
+    if (s->p >= s->end) {
+        return -1;
+    }
+
+    switch (*s->p) {
+        case '"':
+            return json_string(s, NULL, 0, &n);
+        case '{':
+        case '[': {
+            int map = *s->p++ == '{';
+            return json_skip_container(s, map);
+        }
+        case 't':
+        case 'f':
+        case 'n': {
+            const char *word = *s->p == 't' ? "true" : *s->p == 'f' ? "false" : "null";
+            size_t len = strlen(word);
+            if ((size_t)(s->end - s->p) < len || memcmp(s->p, word, len) != 0) {
+                return -1;
+            }
+            s->p += len;
+            return 0;
+        }
+        default:
+            return json_number(s);
+    }
+}
+
+// Función para extraer los campos pedidos de un objeto JSON
+static int extract_json(wire_request_t *req, json_scan_t *s, unsigned wanted) {
+    unsigned seen = 0;
+
+    skip_ws(s);
+    if (s->p >= s->end || *s->p++ != '{') {
+        return -1;
+    }
+    skip_ws(s);
+    if (s->p < s->end && *s->p == '}') {
+        s->p++;
+        return 0;
+    }
+
+    while (1) {
+        // Clave: solo se decodifica si puede ser una de la tabla
+        char name[32];
+        size_t n;
+        skip_ws(s);
+        if (s->p >= s->end || *s->p != '"' || json_string(s, name, sizeof(name), &n) < 0) {
+            return -1;
+        }
+        // Como cJSON, la clave termina en el primer NUL que contenga
+        int key = n <= sizeof(name) ? lookup_n(wire_keys, N_KEYS, name, strnlen(name, n)) : -1;
+
+        skip_ws(s);
+        if (s->p >= s->end || *s->p++ != ':') {
+            return -1;
+        }
+        skip_ws(s);
+
+        int take = key >= 0 && !(seen & WIRE_FIELD(key)) && (wanted & WIRE_FIELD(key));
+        if (take && s->p < s->end && *s->p == '"') {
+            // Cadena pedida: se decodifica directamente en el almacén
+            if (json_string(s, s->out, (size_t)-1, &n) < 0) {
+                return -1;
+            }
+            s->out[n] = '\0';
+            req->fields[key] = s->out;
+            s->out += n + 1;
+        } else if (take && s->p < s->end && *s->p == '[') {
+            // Arreglo pedido: se valida ahora y se recorre después con wire_items_*
+            const unsigned char *start = s->p;
+            if (json_skip(s) < 0) {
+                return -1;
+            }
+            req->lists[key].data = (const char *)start;
+            req->lists[key].len = (size_t)(s->p - start);
+        } else if (json_skip(s) < 0) {
+            return -1;
+        }
+        if (key >= 0) {
+            seen |= WIRE_FIELD(key);
+        }
+
+        skip_ws(s);
+        if (s->p >= s->end) {
+            return -1;
+        }
+        unsigned char c = *s->p++;
+        if (c == '}') {
+            return 0;
+        }
+        if (c != ',') {
+            return -1;
+        }
+    }
+}
+
+static int msgpack_skip(wire_reader_t *r);
+
+// Función para saltar un mapa o arreglo de n elementos; las claves de los mapas
+// se validan igual que en wire_decode
+static int msgpack_skip_n(wire_reader_t *r, int map, unsigned long long n) {
+    if (++r->depth > WIRE_MAX_DEPTH || n > (unsigned long long)(r->end - r->p)) {
+        return -1;  // Cada elemento ocupa al menos un byte
+    }
+    for (unsigned long long i = 0; i < n; i++) {
+        if (map) {
+            size_t len;
+            if (r->p >= r->end) {
+                return -1;
+            }
+            unsigned char type = *r->p++;
+            if (type < 0x80) {
+                if (type >= N_KEYS) {
+                    return -1;
+                }
+            } else if (get_str_len(r, type, &len) == 0 && len < 256) {
+                r->p += len;
+            } else {
+                return -1;
+            }
+        }
+        if (msgpack_skip(r) < 0) {
+            return -1;
+        }
+    }
+    r->depth--;
+    return 0;
+}
+
+// Función para validar y saltar un valor binario sin reservar memoria
+static int msgpack_skip(wire_reader_t *r) {
+    unsigned long long v;
+    size_t len;
+
+    if (r->p >= r->end) {
+        return -1;
+    }
+    unsigned char type = *r->p++;
+
+    if (type < 0x80 || type >= 0xe0 || type == 0xc0 || type == 0xc2 || type == 0xc3) {
+        return 0;
+    }
+    if ((type & 0xf0) == 0x80) {
+        return msgpack_skip_n(r, 1, type & 0x0f);
+    }
+    if ((type & 0xf0) == 0x90) {
+        return msgpack_skip_n(r, 0, type & 0x0f);
+    }
+    if (get_str_len(r, type, &len) == 0) {
+        r->p += len;
+        return 0;
+    }
+
+    switch (type) {
+        case 0xcb:
+            return get_be(r, 8, &v);
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+            return get_be(r, 1 << (type - 0xcc), &v);
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+            return get_be(r, 1 << (type - 0xd0), &v);
+        case 0xdc:
+        case 0xdd:
+            if (get_be(r, type == 0xdc ? 2 : 4, &v) < 0) {
+                return -1;
+            }
+            return msgpack_skip_n(r, 0, v);
+        case 0xde:
+        case 0xdf:
+            if (get_be(r, type == 0xde ? 2 : 4, &v) < 0) {
+                return -1;
+            }
+            return msgpack_skip_n(r, 1, v);
+        default:
+            return -1;
+    }
+}
+
+// Función para extraer los campos pedidos del mapa de una trama binaria
+static int extract_msgpack(wire_request_t *req, wire_reader_t *r, char *out, unsigned wanted) {
+    unsigned long long n;
+    unsigned seen = 0;
+    size_t len;
+
+    if (r->p >= r->end) {
+        return -1;
+    }
+    unsigned char type = *r->p++;
+    if ((type & 0xf0) == 0x80) {
+        n = type & 0x0f;
+    } else if (type == 0xde || type == 0xdf) {
+        if (get_be(r, type == 0xde ? 2 : 4, &n) < 0) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    if (n > (unsigned long long)(r->end - r->p)) {
+        return -1;
+    }
+
+    for (unsigned long long i = 0; i < n; i++) {
+        // Clave: índice de la tabla o cadena
+        if (r->p >= r->end) {
+            return -1;
+        }
+        type = *r->p++;
+        int key;
+        if (type < 0x80) {
+            if (type >= N_KEYS) {
+                return -1;
+            }
+            key = type;
+        } else if (get_str_len(r, type, &len) == 0 && len < 256) {
+            key = lookup_n(wire_keys, N_KEYS, (const char *)r->p, len);
+            r->p += len;
+        } else {
+            return -1;
+        }
+
+        int take = key >= 0 && !(seen & WIRE_FIELD(key)) && (wanted & WIRE_FIELD(key));
+        if (key >= 0) {
+            seen |= WIRE_FIELD(key);
+        }
+        if (r->p >= r->end) {
+            return -1;
+        }
+        type = *r->p;
+
+        if (type < 0x80 && (key == WIRE_KEY_TIPO || key == WIRE_KEY_ACCION)) {
+            // Verbo como entero: apunta al nombre de la tabla, sin copiar
+            if (type >= N_VERBS) {
+                return -1;
+            }
+            r->p++;
+            if (take) {
+                req->fields[key] = wire_verbs[type];
+            }
+        } else if (take && ((type & 0xe0) == 0xa0 || (type >= 0xd9 && type <= 0xdb))) {
+            // Cadena pedida: se copia al almacén con su terminador
+            r->p++;
+            if (get_str_len(r, type, &len) < 0) {
+                return -1;
+            }
+            memcpy(out, r->p, len);
+            out[len] = '\0';
+            req->fields[key] = out;
+            out += len + 1;
+            r->p += len;
+        } else if (take && ((type & 0xf0) == 0x90 || type == 0xdc || type == 0xdd)) {
+            // Arreglo pedido: se valida ahora y se recorre después con wire_items_*
+            const unsigned char *start = r->p;
+            if (msgpack_skip(r) < 0) {
+                return -1;
+            }
+            req->lists[key].data = (const char *)start;
+            req->lists[key].len = (size_t)(r->p - start);
+        } else if (msgpack_skip(r) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Función para dejar una solicitud vacía con almacén para len bytes de cadenas.
+// Las cadenas decodificadas nunca ocupan más que su trama: se reserva todo de una
+// vez para que los punteros de fields no se muevan (y sin crecer después)
+static char *reset_request(wire_request_t *req, size_t len, wire_encoding_t encoding) {
+    memset(req->fields, 0, sizeof(req->fields));
+    memset(req->lists, 0, sizeof(req->lists));
+    req->encoding = encoding;
+    req->strings.len = 0;
+    req->strings.failed = 0;
+    return (char *)buf_reserve(&req->strings, len + WIRE_KEYS);
+}
+
+// Función para extraer los campos de una solicitud en una sola pasada
+int wire_extract(wire_request_t *req, const char *data, size_t len, unsigned wanted) {
+    int binary = len > 0 && (unsigned char)data[0] == WIRE_MARK;
+    char *out = reset_request(req, len, binary ? WIRE_MSGPACK : WIRE_JSON);
+    if (out == NULL) {
+        return -1;
+    }
+
+    if (binary) {
+        if (len < WIRE_HEADER_SIZE || wire_payload_len(data) != len - WIRE_HEADER_SIZE) {
+            return -1;
+        }
+        wire_reader_t r;
+        r.p = (const unsigned char *)data + WIRE_HEADER_SIZE;
+        r.end = (const unsigned char *)data + len;
+        r.depth = 0;
+        if (extract_msgpack(req, &r, out, wanted) < 0) {
+            return -1;
+        }
+        return r.p == r.end ? 0 : -1;
+    }
+
+    json_scan_t s;
+    s.p = (const unsigned char *)data;
+    s.end = (const unsigned char *)data + len;
+    s.out = out;
+    s.depth = 0;
+    if (extract_json(req, &s, wanted) < 0) {
+        return -1;
+    }
+    skip_ws(&s);
+    return s.p == s.end ? 0 : -1;
+}
+
+int wire_items_begin(wire_items_t *it, const wire_request_t *req, wire_key_t key) {
+    const wire_slice_t *list = &req->lists[key];
+    if (list->data == NULL) {
+        return -1;
+    }
+
+    it->p = (const unsigned char *)list->data;
+    it->end = it->p + list->len;
+    it->encoding = req->encoding;
+    it->left = 0;
+
+    // El arreglo ya se validó al extraerlo: basta con saltar su apertura
+    unsigned char type = *it->p++;
+    if (it->encoding == WIRE_JSON) {
+        return 0;
+    }
+    if ((type & 0xf0) == 0x90) {
+        it->left = type & 0x0f;
+    } else {
+        wire_reader_t r = {it->p, it->end, 0};
+        if (get_be(&r, type == 0xdc ? 2 : 4, &it->left) < 0) {
+            return -1;
+        }
+        it->p = r.p;
+    }
+    return 0;
+}
+
+// Función para extraer el siguiente objeto del arreglo; lo que no sea un objeto se salta
+int wire_items_next(wire_items_t *it, wire_request_t *item, unsigned wanted) {
+    char *out = reset_request(item, (size_t)(it->end - it->p), it->encoding);
+    if (out == NULL) {
+        return 0;
+    }
+
+    if (it->encoding == WIRE_MSGPACK) {
+        if (it->left == 0) {
+            return 0;
+        }
+        it->left--;
+
+        wire_reader_t r = {it->p, it->end, 0};
+        unsigned char type = *r.p;
+        int rc = (type & 0xf0) == 0x80 || type == 0xde || type == 0xdf
+                 ? extract_msgpack(item, &r, out, wanted) : (msgpack_skip(&r), -2);
+        it->p = r.p;
+        return rc == 0 ? 1 : rc == -2 ? -1 : 0;
+    }
+
+    json_scan_t s = {it->p, it->end, out, 0};
+    skip_ws(&s);
+    if (s.p >= s.end || *s.p == ']') {
+        return 0;
+    }
+    int rc = *s.p == '{' ? extract_json(item, &s, wanted) : (json_skip(&s), -2);
+    skip_ws(&s);
+    if (s.p < s.end && *s.p == ',') {
+        s.p++;
+    }
+    it->p = s.p;
+    return rc == 0 ? 1 : rc == -2 ? -1 : 0;
+}
+
+void wire_request_free(wire_request_t *req) {
+    free(req->strings.data);
+    memset(req, 0, sizeof(*req));
+}
@@ -0,0 +1,160 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include "cJSON.h"
+
+// Codificación binaria negociada en el REGISTRO con "codificacion": "msgpack".
+// Cada trama binaria es una longitud de 4 bytes (big-endian) seguida de un mapa
+// MessagePack cuyas claves y verbos (tipo/accion) conocidos viajan como enteros
+// pequeños. La carga nunca pasa de 16 MiB, así que el primer byte de la trama es
+// siempre WIRE_MARK y no se confunde con el '{' de un documento JSON
+#define WIRE_HEADER_SIZE 4
+#define WIRE_MAX_PAYLOAD 0xffffff
+#define WIRE_MARK 0x00
+#define WIRE_MSGPACK_NAME "msgpack"
+#define WIRE_MAX_DEPTH 16           // Anidación máxima al escribir y al decodificar
+#define WIRE_NO_KEY -1              // Elementos de arreglos y objeto raíz
+
+typedef enum {
+    WIRE_JSON = 0,
+    WIRE_MSGPACK,
+    WIRE_ENCODINGS
+} wire_encoding_t;
+
+// Claves conocidas, en el orden en que viajan como enteros
+typedef enum {
+    WIRE_KEY_TIPO = 0,
+    WIRE_KEY_ACCION,
+    WIRE_KEY_USUARIO,
+    WIRE_KEY_DIRECCION_IP,
+    WIRE_KEY_ESTADO,
+    WIRE_KEY_NOMBRE_EMISOR,
+    WIRE_KEY_NOMBRE_DESTINATARIO,
+    WIRE_KEY_MENSAJE,
+    WIRE_KEY_RESPUESTA,
+    WIRE_KEY_RAZON,
+    WIRE_KEY_USUARIOS,
+    WIRE_KEY_CODIFICACION,
+    WIRE_KEY_NOMBRE_USUARIO,
+    WIRE_KEY_OPERACIONES,
+    WIRE_KEY_PROCESADAS,
+    WIRE_KEY_RECHAZADAS,
+    WIRE_KEY_COMPRESION,
+    WIRE_KEY_ANTES,
+    WIRE_KEY_DESDE,
+    WIRE_KEY_HASTA,
+    WIRE_KEYS
+} wire_key_t;
+
+// Verbos de tipo/accion, en el orden en que viajan como enteros
+typedef enum {
+    WIRE_VERB_REGISTRO = 0,
+    WIRE_VERB_EXIT,
+    WIRE_VERB_ESTADO,
+    WIRE_VERB_MOSTRAR,
+    WIRE_VERB_BROADCAST,
+    WIRE_VERB_DM,
+    WIRE_VERB_LISTA,
+    WIRE_VERB_SERVER_SHUTDOWN,
+    WIRE_VERB_LOTE,
+    WIRE_VERB_HISTORIA,
+    WIRE_VERBS
+} wire_verb_t;
+
+// Buffer de salida que crece según haga falta
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} wire_buf_t;
+
+// Escritor incremental: agrega claves y valores directamente al buffer, sin armar
+// un árbol cJSON. El buffer pertenece a quien declara el escritor y se reutiliza
+// de una trama a la siguiente, así que tras las primeras tramas ya no reserva memoria
+typedef struct {
+    wire_buf_t buf;
+    wire_encoding_t encoding;
+    int depth;
+    size_t start[WIRE_MAX_DEPTH];       // Posición de la cabecera de cada contenedor abierto
+    unsigned count[WIRE_MAX_DEPTH];     // Elementos escritos en cada contenedor abierto
+} wire_writer_t;
+
+// Verbo (wire_verb_t) con ese nombre, o -1 si no es uno de la tabla
+int wire_verb_lookup(const char *s);
+
+// Bytes de un valor dentro de la trama, sin decodificar
+typedef struct {
+    const char *data;
+    size_t len;
+} wire_slice_t;
+
+// Campos de primer nivel de una solicitud: solo las cadenas de las claves pedidas
+typedef struct {
+    const char *fields[WIRE_KEYS];  // Terminadas en NUL; NULL si falta o no es una cadena
+    wire_slice_t lists[WIRE_KEYS];  // Arreglos pedidos, ya validados (data NULL si falta)
+    wire_encoding_t encoding;       // Codificación de la trama analizada
+    wire_buf_t strings;             // Copias decodificadas; se reutiliza entre solicitudes
+} wire_request_t;
+
+// Recorrido de los objetos de un arreglo extraído (por ejemplo, las operaciones de un LOTE)
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    wire_encoding_t encoding;
+    unsigned long long left;        // Binario: elementos por leer
+} wire_items_t;
+
+#define WIRE_FIELD(key) (1u << (key))
+#define WIRE_JSON_MAX_DEPTH 1000    // Anidación aceptada en JSON (la misma que cJSON)
+
+// Longitud de la carga indicada por la cabecera de una trama binaria
+size_t wire_payload_len(const char *header);
+
+// Serializa un objeto con la codificación indicada; el resultado (malloc) incluye
+// la cabecera si es binario. Retorna NULL sin memoria
+char *wire_print(const cJSON *json, wire_encoding_t encoding, size_t *len);
+
+// Convierte una trama binaria completa (con cabecera) en un objeto cJSON; NULL si es inválida
+cJSON *wire_decode(const char *frame, size_t len);
+
+// Recorre una trama (JSON o binaria) una sola vez y copia en req las cadenas de las
+// claves de wanted (máscara de WIRE_FIELD); el resto se valida y se salta sin
+// reservar memoria. Como en cJSON, cuenta la primera aparición de cada clave.
+// Retorna -1 si la trama no es exactamente un objeto válido
+int wire_extract(wire_request_t *req, const char *data, size_t len, unsigned wanted);
+
+// Empieza a recorrer el arreglo de la clave key; -1 si la solicitud no lo trae.
+// El recorrido apunta a la trama: debe seguir viva mientras dure
+int wire_items_begin(wire_items_t *it, const wire_request_t *req, wire_key_t key);
+
+// Extrae el siguiente elemento en item (como wire_extract). Retorna 1 si era un
+// objeto, -1 si era otra cosa (se salta) y 0 al terminar el arreglo
+int wire_items_next(wire_items_t *it, wire_request_t *item, unsigned wanted);
+
+// Libera el almacén de cadenas de una solicitud
+void wire_request_free(wire_request_t *req);
+
+// Empieza una trama nueva en el buffer del escritor (se descarta la anterior)
+void wire_writer_begin(wire_writer_t *w, wire_encoding_t encoding);
+
+// Libera el buffer del escritor
+void wire_writer_free(wire_writer_t *w);
+
+// Abren y cierran mapas y arreglos; key es WIRE_NO_KEY para la raíz y dentro de arreglos
+void wire_begin_object(wire_writer_t *w, int key);
+void wire_end_object(wire_writer_t *w);
+void wire_begin_array(wire_writer_t *w, int key);
+void wire_end_array(wire_writer_t *w);
+
+// Agrega una cadena (escapada en JSON), un verbo (entero en binario) o un número
+void wire_add_string(wire_writer_t *w, int key, const char *value);
+void wire_add_verb(wire_writer_t *w, int key, wire_verb_t verb);
+void wire_add_int(wire_writer_t *w, int key, long long value);
+
+// Termina la trama; retorna los bytes (válidos hasta la siguiente trama) o NULL
+// si faltó memoria, quedó algo abierto o la carga excede el máximo
+const char *wire_writer_end(wire_writer_t *w, size_t *len);
+
+#endif